@@ -0,0 +1,403 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameProfiler.cpp
+// =================
+// Per-frame CPU/GPU timing collector for the render loop.
+// - CPU time of named phases are measured with beginPhase()/endPhase()
+// - GPU time of a frame is measured with GL_TIME_ELAPSED timer queries. The
+//   result is read back asynchronously at the beginning of a later frame, so
+//   it never stalls the pipeline.
+// - the last N frames are kept in a rolling history for FPS, percentiles and
+//   histogram, and all frames can be logged and saved as a CSV file.
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-20
+// UPDATED: 2023-03-20
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameProfiler.h"
+#include "glExtension.h"
+#include "Timer.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+FrameProfiler::FrameProfiler(int count) : historyCount(count), frameCount(0),
+                                          frameStart(0), prevFrameStart(0),
+                                          gpuTimerEnabled(false), gpuQueryActive(false),
+                                          gpuTime(-1), gpuTimeFrame(0), logEnabled(false)
+{
+    if(historyCount < 1)
+        historyCount = 1;
+
+    intervals.resize(historyCount, 0);
+    frameTimes.resize(historyCount, 0);
+    gpuTimes.resize(historyCount, -1);
+
+    for(int i = 0; i < QUERY_COUNT; ++i)
+    {
+        queryIds[i] = 0;
+        queryFrames[i] = 0;
+        queryPending[i] = false;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add a named phase to measure, and return the id of the phase
+///////////////////////////////////////////////////////////////////////////////
+int FrameProfiler::addPhase(const std::string& name)
+{
+    phaseNames.push_back(name);
+    phaseStarts.push_back(0);
+    currentPhaseTimes.push_back(0);
+    phaseTimes.push_back(std::vector<float>(historyCount, 0));
+    return (int)phaseNames.size() - 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create timer query objects
+// It returns false if the OpenGL context does not support timer query, then
+// only CPU times are measured.
+///////////////////////////////////////////////////////////////////////////////
+bool FrameProfiler::initGpuTimer()
+{
+    if(gpuTimerEnabled)
+        return true;
+
+    if(!glExtension::getInstance().hasTimerQuery())
+        return false;
+
+    pglGenQueries(QUERY_COUNT, queryIds);
+    for(int i = 0; i < QUERY_COUNT; ++i)
+        queryPending[i] = false;
+
+    gpuTimerEnabled = true;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete timer query objects
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::releaseGpuTimer()
+{
+    if(!gpuTimerEnabled)
+        return;
+
+    if(gpuQueryActive)
+        pglEndQuery(GL_TIME_ELAPSED);
+    pglDeleteQueries(QUERY_COUNT, queryIds);
+
+    gpuTimerEnabled = gpuQueryActive = false;
+    gpuTime = -1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// mark the beginning of a frame
+// It collects the finished GPU timers of the previous frames first, then
+// issues a new timer query for this frame if a free query object exists.
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::beginFrame()
+{
+    prevFrameStart = frameStart;
+    frameStart = Timer::getTimeInMicroSec();
+
+    for(size_t i = 0; i < currentPhaseTimes.size(); ++i)
+        currentPhaseTimes[i] = 0;
+
+    if(gpuTimerEnabled)
+    {
+        readGpuTimers();
+
+        // skip GPU timing of this frame if GPU is behind by QUERY_COUNT frames
+        int index = frameCount % QUERY_COUNT;
+        if(!queryPending[index])
+        {
+            pglBeginQuery(GL_TIME_ELAPSED, queryIds[index]);
+            queryFrames[index] = frameCount;
+            gpuQueryActive = true;
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// mark the end of a frame, and store the measured times into the history
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::endFrame()
+{
+    if(gpuQueryActive)
+    {
+        pglEndQuery(GL_TIME_ELAPSED);
+        queryPending[frameCount % QUERY_COUNT] = true;
+        gpuQueryActive = false;
+    }
+
+    float frameTime = (float)((Timer::getTimeInMicroSec() - frameStart) * 0.001);
+    float interval = 0;
+    if(frameCount > 0)
+        interval = (float)((frameStart - prevFrameStart) * 0.001);
+
+    int index = frameCount % historyCount;
+    intervals[index] = interval;
+    frameTimes[index] = frameTime;
+    gpuTimes[index] = -1;   // will be filled later
+    for(size_t i = 0; i < phaseTimes.size(); ++i)
+        phaseTimes[i][index] = currentPhaseTimes[i];
+
+    if(logEnabled)
+    {
+        LogRow row;
+        row.interval = interval;
+        row.frameTime = frameTime;
+        row.gpuTime = -1;
+        row.phaseTimes = currentPhaseTimes;
+        logRows.push_back(row);
+    }
+
+    ++frameCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// measure CPU time of a phase, a phase can be measured multiple times per frame
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::beginPhase(int id)
+{
+    if(id < 0 || id >= (int)phaseStarts.size())
+        return;
+    phaseStarts[id] = Timer::getTimeInMicroSec();
+}
+
+void FrameProfiler::endPhase(int id)
+{
+    if(id < 0 || id >= (int)phaseStarts.size())
+        return;
+    currentPhaseTimes[id] += (float)((Timer::getTimeInMicroSec() - phaseStarts[id]) * 0.001);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read the results of the timer queries if they are available (non-blocking)
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::readGpuTimers()
+{
+    for(int i = 0; i < QUERY_COUNT; ++i)
+    {
+        if(!queryPending[i])
+            continue;
+
+        GLint available = 0;
+        pglGetQueryObjectiv(queryIds[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+            continue;
+
+        unsigned long long elapsed = 0;    // in nano-second
+        pglGetQueryObjectui64v(queryIds[i], GL_QUERY_RESULT, &elapsed);
+        queryPending[i] = false;
+
+        float ms = (float)(elapsed * 0.000001);
+        unsigned int frame = queryFrames[i];
+        if(frameCount - frame < (unsigned int)historyCount)
+            gpuTimes[frame % historyCount] = ms;
+
+        // keep the latest GPU time
+        if(gpuTime < 0 || frame >= gpuTimeFrame)
+        {
+            gpuTime = ms;
+            gpuTimeFrame = frame;
+        }
+
+        // fill the logged row, it is one of the last QUERY_COUNT rows
+        if(logEnabled && frameCount - frame <= logRows.size())
+            logRows[logRows.size() - (frameCount - frame)].gpuTime = ms;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the number of valid samples in the rolling history
+///////////////////////////////////////////////////////////////////////////////
+int FrameProfiler::getSampleCount() const
+{
+    return frameCount < (unsigned int)historyCount ? (int)frameCount : historyCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compute frames per second from the intervals in the history
+///////////////////////////////////////////////////////////////////////////////
+float FrameProfiler::getFps() const
+{
+    int count = getSampleCount();
+    float sum = 0;
+    int n = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        if(intervals[i] > 0)
+        {
+            sum += intervals[i];
+            ++n;
+        }
+    }
+    return (sum > 0) ? n * 1000.0f / sum : 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the percentile (0 ~ 100) of CPU frame times in the history
+///////////////////////////////////////////////////////////////////////////////
+float FrameProfiler::getFrameTimePercentile(float percent) const
+{
+    int count = getSampleCount();
+    if(count == 0)
+        return 0;
+
+    std::vector<float> times(frameTimes.begin(), frameTimes.begin() + count);
+    int index = (int)(percent * 0.01f * (count - 1) + 0.5f);
+    if(index < 0) index = 0;
+    if(index >= count) index = count - 1;
+    std::nth_element(times.begin(), times.begin() + index, times.end());
+    return times[index];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the average CPU time of a phase in the history
+///////////////////////////////////////////////////////////////////////////////
+float FrameProfiler::getAveragePhaseTime(int id) const
+{
+    int count = getSampleCount();
+    if(id < 0 || id >= (int)phaseTimes.size() || count == 0)
+        return 0;
+
+    float sum = 0;
+    for(int i = 0; i < count; ++i)
+        sum += phaseTimes[id][i];
+    return sum / count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the average GPU time in the history, -1 if not available
+///////////////////////////////////////////////////////////////////////////////
+float FrameProfiler::getAverageGpuTime() const
+{
+    int count = getSampleCount();
+    float sum = 0;
+    int n = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        if(gpuTimes[i] >= 0)
+        {
+            sum += gpuTimes[i];
+            ++n;
+        }
+    }
+    return (n > 0) ? sum / n : -1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// count the CPU frame times in the history into equal-size buckets from 0 to
+// maxTime. The times greater than maxTime are counted in the last bucket.
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::getHistogram(std::vector<int>& counts, float maxTime) const
+{
+    int bucketCount = (int)counts.size();
+    std::fill(counts.begin(), counts.end(), 0);
+    if(bucketCount == 0 || maxTime <= 0)
+        return;
+
+    int count = getSampleCount();
+    for(int i = 0; i < count; ++i)
+    {
+        int bucket = (int)(frameTimes[i] / maxTime * bucketCount);
+        if(bucket >= bucketCount)
+            bucket = bucketCount - 1;
+        ++counts[bucket];
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// save the logged frames as CSV, the GPU time is empty if not available
+///////////////////////////////////////////////////////////////////////////////
+bool FrameProfiler::saveCsv(const char* fileName) const
+{
+    if(!fileName)
+        return false;
+
+    std::ofstream file(fileName);
+    if(!file.is_open())
+    {
+        std::cout << "[ERROR] Failed to open " << fileName << std::endl;
+        return false;
+    }
+
+    file << "frame,interval_ms,cpu_ms";
+    for(size_t i = 0; i < phaseNames.size(); ++i)
+        file << "," << phaseNames[i] << "_ms";
+    file << ",gpu_ms\n";
+
+    file << std::fixed << std::setprecision(4);
+    for(size_t i = 0; i < logRows.size(); ++i)
+    {
+        const LogRow& row = logRows[i];
+        file << i << "," << row.interval << "," << row.frameTime;
+        for(size_t j = 0; j < row.phaseTimes.size(); ++j)
+            file << "," << row.phaseTimes[j];
+        file << ",";
+        if(row.gpuTime >= 0)
+            file << row.gpuTime;
+        file << "\n";
+    }
+
+    std::cout << "Saved " << logRows.size() << " frames to " << fileName << std::endl;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print itself for debug
+///////////////////////////////////////////////////////////////////////////////
+void FrameProfiler::printSelf() const
+{
+    std::cout << "===== FrameProfiler =====\n"
+              << std::fixed << std::setprecision(3)
+              << "Frame Count: " << frameCount << "\n"
+              << "FPS: " << getFps() << "\n"
+              << "Frame Time p50/p95/p99: " << getFrameTimePercentile(50) << " / "
+              << getFrameTimePercentile(95) << " / " << getFrameTimePercentile(99) << " ms\n";
+    for(size_t i = 0; i < phaseNames.size(); ++i)
+        std::cout << phaseNames[i] << ": " << getAveragePhaseTime((int)i) << " ms\n";
+    std::cout << "GPU Time: ";
+    if(gpuTimerEnabled)
+        std::cout << getAverageGpuTime() << " ms\n";
+    else
+        std::cout << "N/A\n";
+    std::cout << std::resetiosflags(std::ios_base::fixed | std::ios_base::floatfield) << std::endl;
+}
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameProfiler.h
+// ===============
+// Per-frame CPU/GPU timing collector for the render loop.
+// - CPU time of named phases are measured with beginPhase()/endPhase()
+// - GPU time of a frame is measured with GL_TIME_ELAPSED timer queries. The
+//   result is read back asynchronously at the beginning of a later frame, so
+//   it never stalls the pipeline.
+// - the last N frames are kept in a rolling history for FPS, percentiles and
+//   histogram, and all frames can be logged and saved as a CSV file.
+//
+// usage:
+//  int id = profiler.addPhase("scene");
+//  profiler.initGpuTimer();        // after OpenGL context is created
+//  ...
+//  profiler.beginFrame();
+//  profiler.beginPhase(id); draw(); profiler.endPhase(id);
+//  glutSwapBuffers();
+//  profiler.endFrame();
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-20
+// UPDATED: 2023-03-20
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <string>
+#include <vector>
+
+class FrameProfiler
+{
+public:
+    // ctor/dtor
+    FrameProfiler(int historyCount=256);
+    ~FrameProfiler() {}
+
+    // setup
+    int addPhase(const std::string& name);          // add a named phase and return its id
+    bool initGpuTimer();                            // create timer queries, it needs OpenGL context
+    void releaseGpuTimer();                         // delete timer queries
+    void setLogEnabled(bool flag)                   { logEnabled = flag; }
+
+    // measure
+    void beginFrame();
+    void endFrame();
+    void beginPhase(int id);
+    void endPhase(int id);
+
+    // stats from the rolling history (times are in milli-second)
+    int getPhaseCount() const                       { return (int)phaseNames.size(); }
+    const std::string& getPhaseName(int id) const   { return phaseNames[id]; }
+    unsigned int getFrameCount() const              { return frameCount; }
+    float getFps() const;
+    float getFrameTimePercentile(float percent) const;  // CPU time of frames
+    float getAveragePhaseTime(int id) const;
+    float getGpuTime() const                        { return gpuTime; } // the latest one, -1 if N/A
+    float getAverageGpuTime() const;
+    bool isGpuTimerEnabled() const                  { return gpuTimerEnabled; }
+    void getHistogram(std::vector<int>& counts, float maxTime) const;   // frame time distribution
+
+    // save the logged frames as CSV format
+    bool saveCsv(const char* fileName) const;
+
+    // debug
+    void printSelf() const;
+
+protected:
+
+private:
+    static const int QUERY_COUNT = 4;               // max # of frames in flight for GPU timer
+
+    struct LogRow
+    {
+        float interval;                             // time between 2 consecutive frames
+        float frameTime;                            // CPU time from beginFrame() to endFrame()
+        float gpuTime;                              // -1 if not available
+        std::vector<float> phaseTimes;
+    };
+
+    // member functions
+    int getSampleCount() const;
+    void readGpuTimers();
+
+    // member vars
+    int historyCount;                               // size of rolling history
+    unsigned int frameCount;                        // # of frames ended
+    double frameStart;                              // beginning of current frame in usec
+    double prevFrameStart;
+    std::vector<std::string> phaseNames;
+    std::vector<double> phaseStarts;                // begin time of each phase in usec
+    std::vector<float> currentPhaseTimes;           // accumulated phase times of current frame
+
+    // rolling history, index = frame % historyCount
+    std::vector<float> intervals;
+    std::vector<float> frameTimes;
+    std::vector<float> gpuTimes;
+    std::vector<std::vector<float> > phaseTimes;    // [phase][frame]
+
+    // GPU timer queries
+    bool gpuTimerEnabled;
+    bool gpuQueryActive;                            // a query is issued for the current frame
+    unsigned int queryIds[QUERY_COUNT];
+    unsigned int queryFrames[QUERY_COUNT];          // frame # measured by the query
+    bool queryPending[QUERY_COUNT];
+    float gpuTime;
+    unsigned int gpuTimeFrame;                      // frame # of gpuTime
+
+    // CSV logging
+    bool logEnabled;
+    std::vector<LogRow> logRows;
+};
+
+#endif
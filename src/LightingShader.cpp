@@ -0,0 +1,421 @@
+///////////////////////////////////////////////////////////////////////////////
+// LightingShader.cpp
+// ==================
+// GLSL pipeline to draw Torus objects with per-pixel Blinn-Phong lighting
+// - lighting and material parameters are stored in a uniform buffer, and it is
+//   uploaded only when any of the values is changed
+// - per-object data (model matrix, diffuse color, texture weight) are stored
+//   in a second buffer as instanced vertex attributes, so all objects sharing
+//   the same mesh and texture are drawn with a single instanced draw call
+// - the mesh of each Torus is uploaded to VBO/IBO, and re-uploaded only if the
+//   revision of the Torus is changed
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-22
+// UPDATED: 2023-03-22
+///////////////////////////////////////////////////////////////////////////////
+
+#include "glExtension.h"
+#include "LightingShader.h"
+#include "Torus.h"
+#include <iostream>
+#include <cstring>
+
+// vertex attribute locations
+const unsigned int ATTRIB_POSITION  = 0;
+const unsigned int ATTRIB_NORMAL    = 1;
+const unsigned int ATTRIB_TEXCOORD  = 2;
+const unsigned int ATTRIB_MATRIX    = 3;    // mat4 uses 3, 4, 5 and 6
+const unsigned int ATTRIB_DIFFUSE   = 7;
+const unsigned int ATTRIB_TEXWEIGHT = 8;
+
+// binding point of the uniform block
+const unsigned int LIGHTING_BINDING = 0;
+
+// GLSL 1.40 with uniform block, all lighting is computed in eye space
+const char* VERTEX_SHADER_SOURCE =
+"#version 140\n"
+"uniform mat4 projectionMatrix;\n"
+"uniform mat4 viewMatrix;\n"
+"in vec3 vertexPosition;\n"
+"in vec3 vertexNormal;\n"
+"in vec2 vertexTexCoord;\n"
+"in mat4 modelMatrix;\n"           // per-object
+"in vec4 objectDiffuse;\n"         // per-object
+"in float objectTexWeight;\n"      // per-object
+"out vec3 esVertex;\n"
+"out vec3 esNormal;\n"
+"out vec2 texCoord0;\n"
+"out vec4 diffuse;\n"
+"out float texWeight;\n"
+"void main()\n"
+"{\n"
+"    mat4 modelViewMatrix = viewMatrix * modelMatrix;\n"
+"    vec4 position = modelViewMatrix * vec4(vertexPosition, 1.0);\n"
+"    esVertex = position.xyz;\n"
+"    esNormal = mat3(modelViewMatrix) * vertexNormal;\n"   // no scale in model matrix
+"    texCoord0 = vertexTexCoord;\n"
+"    diffuse = objectDiffuse;\n"
+"    texWeight = objectTexWeight;\n"
+"    gl_Position = projectionMatrix * position;\n"
+"}\n";
+
+const char* FRAGMENT_SHADER_SOURCE =
+"#version 140\n"
+"layout(std140) uniform Lighting\n"
+"{\n"
+"    vec4 lightPosition;\n"
+"    vec4 lightAmbient;\n"
+"    vec4 lightDiffuse;\n"
+"    vec4 lightSpecular;\n"
+"    vec4 materialAmbient;\n"
+"    vec4 materialSpecular;\n"
+"    vec4 globalAmbient;\n"
+"    float materialShininess;\n"
+"};\n"
+"uniform sampler2D map0;\n"
+"in vec3 esVertex;\n"
+"in vec3 esNormal;\n"
+"in vec2 texCoord0;\n"
+"in vec4 diffuse;\n"
+"in float texWeight;\n"
+"out vec4 fragColor;\n"
+"void main()\n"
+"{\n"
+"    vec3 normal = normalize(esNormal);\n"
+"    vec3 light;\n"
+"    if(lightPosition.w == 0.0)\n"
+"        light = normalize(lightPosition.xyz);\n"           // directional
+"    else\n"
+"        light = normalize(lightPosition.xyz - esVertex);\n" // positional
+"    vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n" // infinite viewer, same as fixed-function
+"    vec4 color = (globalAmbient + lightAmbient) * materialAmbient;\n"
+"    float dotNL = max(dot(normal, light), 0.0);\n"
+"    color += dotNL * lightDiffuse * diffuse;\n"
+"    if(dotNL > 0.0)\n"
+"        color += pow(max(dot(normal, halfway), 0.0), materialShininess) * lightSpecular * materialSpecular;\n"
+"    color *= mix(vec4(1.0), texture(map0, texCoord0), texWeight);\n"   // modulate
+"    fragColor = vec4(color.rgb, diffuse.a);\n"
+"}\n";
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+LightingShader::LightingShader() : program(0), uniformProjection(-1), uniformView(-1),
+                                   uniformMap0(-1), uboId(0), objectVboId(0),
+                                   lightingDirty(true), uniformUploadCount(0),
+                                   meshUploadCount(0)
+{
+    // same as the default values of fixed-function pipeline
+    memset(&lighting, 0, sizeof(lighting));
+    float lightPosition[] = {0, 0, 1, 0};
+    float black[] = {0, 0, 0, 1};
+    float white[] = {1, 1, 1, 1};
+    float ambient[] = {0.2f, 0.2f, 0.2f, 1};
+    setLight(lightPosition, black, white, white);
+    setMaterial(ambient, black, 0);
+    setGlobalAmbient(ambient);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compile and link GLSL program, and create buffer objects
+// It returns false if the OpenGL context does not support it.
+///////////////////////////////////////////////////////////////////////////////
+bool LightingShader::init()
+{
+    if(program)
+        return true;
+
+    if(!glExtension::getInstance().hasShaderPipeline())
+    {
+        std::cout << "[WARNING] OpenGL 3.3 is required for LightingShader." << std::endl;
+        return false;
+    }
+
+    GLuint vsId = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER_SOURCE);
+    GLuint fsId = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER_SOURCE);
+    if(!vsId || !fsId)
+    {
+        if(vsId) pglDeleteShader(vsId);
+        if(fsId) pglDeleteShader(fsId);
+        return false;
+    }
+
+    program = pglCreateProgram();
+    pglAttachShader(program, vsId);
+    pglAttachShader(program, fsId);
+    pglBindAttribLocation(program, ATTRIB_POSITION, "vertexPosition");
+    pglBindAttribLocation(program, ATTRIB_NORMAL, "vertexNormal");
+    pglBindAttribLocation(program, ATTRIB_TEXCOORD, "vertexTexCoord");
+    pglBindAttribLocation(program, ATTRIB_MATRIX, "modelMatrix");
+    pglBindAttribLocation(program, ATTRIB_DIFFUSE, "objectDiffuse");
+    pglBindAttribLocation(program, ATTRIB_TEXWEIGHT, "objectTexWeight");
+    pglLinkProgram(program);
+
+    // shaders are not needed after linking
+    pglDeleteShader(vsId);
+    pglDeleteShader(fsId);
+
+    GLint status = 0;
+    pglGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(!status)
+    {
+        GLint length = 0;
+        pglGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, 0);
+        pglGetProgramInfoLog(program, length, 0, &log[0]);
+        std::cout << "[ERROR] Failed to link GLSL program:\n" << &log[0] << std::endl;
+        pglDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    uniformProjection = pglGetUniformLocation(program, "projectionMatrix");
+    uniformView = pglGetUniformLocation(program, "viewMatrix");
+    uniformMap0 = pglGetUniformLocation(program, "map0");
+    GLuint blockIndex = pglGetUniformBlockIndex(program, "Lighting");
+    if(blockIndex != GL_INVALID_INDEX)
+        pglUniformBlockBinding(program, blockIndex, LIGHTING_BINDING);
+
+    pglUseProgram(program);
+    pglUniform1i(uniformMap0, 0);
+    pglUseProgram(0);
+
+    // buffers
+    pglGenBuffers(1, &uboId);
+    pglBindBuffer(GL_UNIFORM_BUFFER, uboId);
+    pglBufferData(GL_UNIFORM_BUFFER, sizeof(lighting), 0, GL_DYNAMIC_DRAW);
+    pglBindBuffer(GL_UNIFORM_BUFFER, 0);
+    lightingDirty = true;
+
+    pglGenBuffers(1, &objectVboId);
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete program and all buffers
+///////////////////////////////////////////////////////////////////////////////
+void LightingShader::release()
+{
+    if(!program)
+        return;
+
+    std::map<const Torus*, Mesh>::iterator it;
+    for(it = meshes.begin(); it != meshes.end(); ++it)
+    {
+        pglDeleteBuffers(1, &it->second.vboId);
+        pglDeleteBuffers(1, &it->second.iboId);
+    }
+    meshes.clear();
+
+    pglDeleteBuffers(1, &uboId);
+    pglDeleteBuffers(1, &objectVboId);
+    pglDeleteProgram(program);
+    program = uboId = objectVboId = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// setters of lighting parameters
+// The uniform buffer is marked dirty only if any value is actually changed.
+///////////////////////////////////////////////////////////////////////////////
+void LightingShader::setLight(const float position[4], const float ambient[4], const float diffuse[4], const float specular[4])
+{
+    setBlockValue(lighting.lightPosition, position, 4);
+    setBlockValue(lighting.lightAmbient, ambient, 4);
+    setBlockValue(lighting.lightDiffuse, diffuse, 4);
+    setBlockValue(lighting.lightSpecular, specular, 4);
+}
+
+void LightingShader::setMaterial(const float ambient[4], const float specular[4], float shininess)
+{
+    setBlockValue(lighting.materialAmbient, ambient, 4);
+    setBlockValue(lighting.materialSpecular, specular, 4);
+    setBlockValue(&lighting.materialShininess, &shininess, 1);
+}
+
+void LightingShader::setGlobalAmbient(const float ambient[4])
+{
+    setBlockValue(lighting.globalAmbient, ambient, 4);
+}
+
+void LightingShader::setBlockValue(float* dst, const float* src, int count)
+{
+    if(memcmp(dst, src, count * sizeof(float)) == 0)
+        return;
+    memcpy(dst, src, count * sizeof(float));
+    lightingDirty = true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add an object to be drawn by the next draw() call
+///////////////////////////////////////////////////////////////////////////////
+void LightingShader::addObject(const float matrix[16], const float diffuse[4], float textureWeight)
+{
+    ObjectData object;
+    memcpy(object.matrix, matrix, sizeof(object.matrix));
+    memcpy(object.diffuse, diffuse, sizeof(object.diffuse));
+    object.textureWeight = textureWeight;
+    object.padding[0] = object.padding[1] = object.padding[2] = 0;
+    objects.push_back(object);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// draw all added objects with a single instanced draw call
+///////////////////////////////////////////////////////////////////////////////
+void LightingShader::draw(const Torus& torus, unsigned int texture)
+{
+    if(!program || objects.empty())
+    {
+        objects.clear();
+        return;
+    }
+
+    Mesh& mesh = getMesh(torus);
+    updateLighting();
+
+    // view and projection from fixed-function matrix stacks
+    float projection[16];
+    float view[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, view);
+
+    pglUseProgram(program);
+    pglUniformMatrix4fv(uniformProjection, 1, GL_FALSE, projection);
+    pglUniformMatrix4fv(uniformView, 1, GL_FALSE, view);
+    pglBindBufferBase(GL_UNIFORM_BUFFER, LIGHTING_BINDING, uboId);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // per-vertex attributes, interleaved V/N/T
+    int stride = torus.getInterleavedStride();
+    pglBindBuffer(GL_ARRAY_BUFFER, mesh.vboId);
+    pglEnableVertexAttribArray(ATTRIB_POSITION);
+    pglEnableVertexAttribArray(ATTRIB_NORMAL);
+    pglEnableVertexAttribArray(ATTRIB_TEXCOORD);
+    pglVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    pglVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    pglVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+
+    // per-object attributes, orphan the previous buffer to avoid sync
+    int objectStride = sizeof(ObjectData);
+    pglBindBuffer(GL_ARRAY_BUFFER, objectVboId);
+    pglBufferData(GL_ARRAY_BUFFER, objects.size() * sizeof(ObjectData), 0, GL_STREAM_DRAW);
+    pglBufferSubData(GL_ARRAY_BUFFER, 0, objects.size() * sizeof(ObjectData), &objects[0]);
+    for(unsigned int i = 0; i < 4; ++i)
+    {
+        pglEnableVertexAttribArray(ATTRIB_MATRIX + i);
+        pglVertexAttribPointer(ATTRIB_MATRIX + i, 4, GL_FLOAT, GL_FALSE, objectStride, (void*)(i * 4 * sizeof(float)));
+        pglVertexAttribDivisor(ATTRIB_MATRIX + i, 1);
+    }
+    pglEnableVertexAttribArray(ATTRIB_DIFFUSE);
+    pglVertexAttribPointer(ATTRIB_DIFFUSE, 4, GL_FLOAT, GL_FALSE, objectStride, (void*)(16 * sizeof(float)));
+    pglVertexAttribDivisor(ATTRIB_DIFFUSE, 1);
+    pglEnableVertexAttribArray(ATTRIB_TEXWEIGHT);
+    pglVertexAttribPointer(ATTRIB_TEXWEIGHT, 1, GL_FLOAT, GL_FALSE, objectStride, (void*)(20 * sizeof(float)));
+    pglVertexAttribDivisor(ATTRIB_TEXWEIGHT, 1);
+
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.iboId);
+    pglDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0, (GLsizei)objects.size());
+
+    // restore states, fixed-function client arrays must not use buffer objects
+    for(unsigned int i = ATTRIB_POSITION; i <= ATTRIB_TEXWEIGHT; ++i)
+    {
+        pglVertexAttribDivisor(i, 0);
+        pglDisableVertexAttribArray(i);
+    }
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    pglUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    objects.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compile a shader, return 0 if failed
+///////////////////////////////////////////////////////////////////////////////
+unsigned int LightingShader::compileShader(unsigned int type, const char* source)
+{
+    GLuint id = pglCreateShader(type);
+    pglShaderSource(id, 1, &source, 0);
+    pglCompileShader(id);
+
+    GLint status = 0;
+    pglGetShaderiv(id, GL_COMPILE_STATUS, &status);
+    if(!status)
+    {
+        GLint length = 0;
+        pglGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, 0);
+        pglGetShaderInfoLog(id, length, 0, &log[0]);
+        std::cout << "[ERROR] Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
+                  << " shader:\n" << &log[0] << std::endl;
+        pglDeleteShader(id);
+        return 0;
+    }
+    return id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// upload the lighting block only if it is changed
+///////////////////////////////////////////////////////////////////////////////
+void LightingShader::updateLighting()
+{
+    if(!lightingDirty)
+        return;
+
+    pglBindBuffer(GL_UNIFORM_BUFFER, uboId);
+    pglBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lighting), &lighting);
+    pglBindBuffer(GL_UNIFORM_BUFFER, 0);
+    lightingDirty = false;
+    ++uniformUploadCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the VBO/IBO of the torus, (re)upload if it is new or modified
+///////////////////////////////////////////////////////////////////////////////
+LightingShader::Mesh& LightingShader::getMesh(const Torus& torus)
+{
+    std::map<const Torus*, Mesh>::iterator it = meshes.find(&torus);
+    if(it != meshes.end() && it->second.revision == torus.getRevision())
+        return it->second;
+
+    if(it == meshes.end())
+    {
+        Mesh mesh;
+        pglGenBuffers(1, &mesh.vboId);
+        pglGenBuffers(1, &mesh.iboId);
+        it = meshes.insert(std::make_pair(&torus, mesh)).first;
+    }
+
+    Mesh& mesh = it->second;
+    pglBindBuffer(GL_ARRAY_BUFFER, mesh.vboId);
+    pglBufferData(GL_ARRAY_BUFFER, torus.getInterleavedVertexSize(), torus.getInterleavedVertices(), GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.iboId);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, torus.getIndexSize(), torus.getIndices(), GL_STATIC_DRAW);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    mesh.revision = torus.getRevision();
+    mesh.indexCount = torus.getIndexCount();
+    ++meshUploadCount;
+
+    return mesh;
+}
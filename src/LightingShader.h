@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+// LightingShader.h
+// ================
+// GLSL pipeline to draw Torus objects with per-pixel Blinn-Phong lighting
+// - lighting and material parameters are stored in a uniform buffer, and it is
+//   uploaded only when any of the values is changed
+// - per-object data (model matrix, diffuse color, texture weight) are stored
+//   in a second buffer as instanced vertex attributes, so all objects sharing
+//   the same mesh and texture are drawn with a single instanced draw call
+// - the mesh of each Torus is uploaded to VBO/IBO, and re-uploaded only if the
+//   revision of the Torus is changed
+// It requires OpenGL 3.3 (or compatibility profile), see isReady().
+//
+// usage:
+//  shader.init();                              // after OpenGL context is created
+//  shader.setLight(...); shader.setMaterial(...);
+//  shader.addObject(matrix, diffuse, 1.0f);    // repeat for all instances
+//  shader.draw(torus, textureId);              // draw and clear added objects
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-22
+// UPDATED: 2023-03-22
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LIGHTING_SHADER_H
+#define LIGHTING_SHADER_H
+
+#include <vector>
+#include <map>
+
+class Torus;
+
+class LightingShader
+{
+public:
+    // ctor/dtor
+    LightingShader();
+    ~LightingShader() {}
+
+    bool init();                                    // compile program and create buffers
+    void release();                                 // delete program and buffers
+    bool isReady() const                            { return program != 0; }
+
+    // lighting/material parameters, the light position is in eye space
+    void setLight(const float position[4], const float ambient[4], const float diffuse[4], const float specular[4]);
+    void setMaterial(const float ambient[4], const float specular[4], float shininess);
+    void setGlobalAmbient(const float ambient[4]);
+
+    // per-object data, textureWeight is 0 for no texture, 1 for full texture
+    void addObject(const float matrix[16], const float diffuse[4], float textureWeight);
+    void clearObjects()                             { objects.clear(); }
+    int getObjectCount() const                      { return (int)objects.size(); }
+
+    // draw all added objects with the mesh of the torus, then clear the objects
+    // The projection and view matrices are taken from the current GL matrices.
+    void draw(const Torus& torus, unsigned int texture);
+
+    // stats
+    unsigned int getUniformUploadCount() const      { return uniformUploadCount; }
+    unsigned int getMeshUploadCount() const         { return meshUploadCount; }
+
+protected:
+
+private:
+    // std140 layout of the uniform block "Lighting"
+    struct LightingBlock
+    {
+        float lightPosition[4];
+        float lightAmbient[4];
+        float lightDiffuse[4];
+        float lightSpecular[4];
+        float materialAmbient[4];
+        float materialSpecular[4];
+        float globalAmbient[4];
+        float materialShininess;
+        float padding[3];
+    };
+
+    // per-instance attributes
+    struct ObjectData
+    {
+        float matrix[16];
+        float diffuse[4];
+        float textureWeight;
+        float padding[3];
+    };
+
+    // VBO/IBO of a torus
+    struct Mesh
+    {
+        unsigned int vboId;
+        unsigned int iboId;
+        unsigned int revision;
+        unsigned int indexCount;
+    };
+
+    // member functions
+    unsigned int compileShader(unsigned int type, const char* source);
+    void updateLighting();
+    void setBlockValue(float* dst, const float* src, int count);
+    Mesh& getMesh(const Torus& torus);
+
+    // member vars
+    unsigned int program;
+    int uniformProjection;                          // uniform locations
+    int uniformView;
+    int uniformMap0;
+    unsigned int uboId;                             // lighting parameters
+    unsigned int objectVboId;                       // per-object data
+    LightingBlock lighting;
+    bool lightingDirty;                             // need to upload lighting block
+    std::vector<ObjectData> objects;
+    std::map<const Torus*, Mesh> meshes;
+    unsigned int uniformUploadCount;
+    unsigned int meshUploadCount;
+};
+
+#endif
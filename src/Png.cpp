@@ -6,29 +6,169 @@
 //
 // Dependency: This class requires lodepng.h/.cpp
 //
+// 2023-03-31: save() encodes and writes the file band by band.
+// 2023-03-30: read() decodes straight into the data without a copy.
+// 2023-03-29: Added probe() to read only the header.
+// 2023-03-28: Added native color types of the file with setNativeColor().
+// 2023-03-27: Added readHeader() and decodeInto() to decode into a given buffer.
+// 2023-03-26: Memory-mapped file input in read().
+// 2023-03-25: Added readRows() to decode row by row with bounded memory.
+// 2023-03-23: Added compression level and threads to save().
 // 2018-08-10: Replaced &data[0] to .data() function.
 // 2013-01-23: Changed data size to side_t for 64bit.
 // 2009-09-17: Currently support only 32-bit RGBA read/save.
 //
 //  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
 // CREATED: 2009-09-17
-// UPDATED: 2018-08-10
+// UPDATED: 2023-03-31
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstring>                      // for memcpy()
+#include <new>                          // for std::bad_alloc
+#ifdef _WIN32
+#include <windows.h>                    // for MapViewOfFile()
+#else
+#include <sys/mman.h>                   // for mmap()
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "lodepng.h"
 #include "Png.h"
 using namespace Image;
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// map a whole file read-only into memory, and return NULL if the file cannot be
+// mapped, e.g. it is empty, not a regular file or the file system has no mmap
+///////////////////////////////////////////////////////////////////////////////
+static const unsigned char* mapFile(const char* fileName, std::size_t& size)
+{
+    const unsigned char* data = 0;
+    size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if(file == INVALID_HANDLE_VALUE)
+        return 0;
+    LARGE_INTEGER fileSize;
+    if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if(mapping)
+        {
+            data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);   // the view keeps the mapping
+        }
+        if(data)
+            size = (std::size_t)fileSize.QuadPart;
+    }
+    CloseHandle(file);
+#else
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0)
+        return 0;
+    struct stat info;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void* p = mmap(0, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED)
+        {
+            data = (const unsigned char*)p;
+            size = (std::size_t)info.st_size;
+        }
+    }
+    close(fd);              // the mapping stays valid
+#endif
+    return data;
+}
+
+static void unmapFile(const unsigned char* data, std::size_t size)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// resize the data to the given rows without throwing
+// The size comes from the header of the file, so it can be too large to
+// allocate, or even overflow a size_t. Returns false then.
+///////////////////////////////////////////////////////////////////////////////
+static bool resizeData(std::vector<unsigned char>& data, std::size_t rowSize, std::size_t rows)
+{
+    if(rows && rowSize > data.max_size() / rows)
+        return false;
+    try
+    {
+        data.resize(rowSize * rows);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return false;
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// set the color type of the decoded image and return its bits per pixel
+// RGBA by default, otherwise the color type of the file with 8 bits per
+// channel. The tRNS chunk comes before IDAT, so the chunks are scanned up to
+// the first IDAT to find a color key, which needs the alpha channel.
+// Returns 0 if the header is broken.
+///////////////////////////////////////////////////////////////////////////////
+static int setDecoderColor(LodePNG::Decoder& decoder, const unsigned char* file, std::size_t size, bool native)
+{
+    decoder.inspect(file, size);
+    if(decoder.hasError())
+        return 0;
+
+    LodePNG_InfoColor& color = decoder.getInfoRaw().color;
+    color.colorType = 6;
+    color.bitDepth = 8;
+    if(native)
+    {
+        bool colorKey = false;
+        const unsigned char* chunk = file + 33;     // after signature and IHDR
+        while(!colorKey && (std::size_t)(chunk - file) + 12 <= size)
+        {
+            if(LodePNG_chunk_type_equals(chunk, "IDAT"))
+                break;
+            colorKey = LodePNG_chunk_type_equals(chunk, "tRNS") != 0;
+            if(LodePNG_chunk_length(chunk) > size - (std::size_t)(chunk - file) - 12)
+                break;              // broken chunk, the decoder reports it
+            chunk = LodePNG_chunk_next_const(chunk);
+        }
+
+        switch(decoder.getInfoPng().color.colorType)
+        {
+        case 0: color.colorType = colorKey ? 4 : 0; break;  // grey
+        case 2: color.colorType = colorKey ? 6 : 2; break;  // RGB
+        case 3: color.colorType = 3;                break;  // palette indices
+        case 4: color.colorType = 4;                break;  // grey+alpha
+        default: break;                                     // RGBA
+        }
+    }
+    return (int)LodePNG_InfoColor_getBpp(&color);
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // default constructor
 ///////////////////////////////////////////////////////////////////////////////
-Png::Png() : width(0), height(0), bitCount(0), dataSize(0), errorMessage("No error.")
+Png::Png() : width(0), height(0), bitCount(0), colorType(0), bitDepth(0), interlaced(false),
+             dataSize(0), nativeColor(false),
+             errorMessage("No error."), fileData(0), fileSize(0)
 {
 }
 
@@ -39,6 +179,7 @@ Png::Png() : width(0), height(0), bitCount(0), dataSize(0), errorMessage("No err
 ///////////////////////////////////////////////////////////////////////////////
 Png::~Png()
 {
+    closeFile();
 }
 
 
@@ -49,9 +190,27 @@ Png::~Png()
 void Png::init()
 {
     width = height = bitCount = 0;
+    colorType = bitDepth = 0;
+    interlaced = false;
     dataSize = 0;
     std::vector<unsigned char>().swap(data);
+    std::vector<unsigned char>().swap(palette);
     errorMessage = "No error.";
+    closeFile();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// unmap or free the file kept by readHeader()
+///////////////////////////////////////////////////////////////////////////////
+void Png::closeFile()
+{
+    if(fileData && fileBuffer.empty())
+        unmapFile(fileData, fileSize);
+    std::vector<unsigned char>().swap(fileBuffer);
+    fileData = 0;
+    fileSize = 0;
 }
 
 
@@ -65,17 +224,72 @@ void Png::printSelf() const
               << "Width: " << width << " pixels\n"
               << "Height: " << height << " pixels\n"
               << "Bit Count: " << bitCount << " bits\n"
+              << "Color Type: " << colorType << " (" << bitDepth << "-bit"
+              << (interlaced ? ", interlaced" : "") << ")\n"
+              << "Palette Size: " << palette.size() / 4 << "\n"
               << "Data Size: " << dataSize  << " bytes\n"
               << std::endl;
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// read only the header of a PNG file: the 8-byte signature and the IHDR chunk,
+// which must be the first chunk. The file is neither mapped nor read further,
+// so probing many files costs about one small read each.
+///////////////////////////////////////////////////////////////////////////////
+bool Png::probe(const char* fileName)
+{
+    this->init();   // clear out all values
+
+    // check NULL pointer
+    if(!fileName)
+    {
+        errorMessage = "File name is not defined (NULL pointer).";
+        return false;
+    }
+
+    std::ifstream file(fileName, std::ios::binary);
+    if(!file.is_open())
+    {
+        errorMessage = "Failed to open the PNG file to read.";
+        return false;
+    }
+
+    unsigned char header[33];       // signature, length, type, 13 bytes of IHDR and CRC
+    file.read((char*)header, sizeof(header));
+    if(file.gcount() != (std::streamsize)sizeof(header))
+    {
+        errorMessage = "The file is too small to be a PNG file.";
+        return false;
+    }
+
+    LodePNG::Decoder decoder;
+    decoder.inspect(header, sizeof(header));
+    if(decoder.hasError())
+    {
+        std::stringstream ss;
+        ss << "Failed to decode PNG header [code:" << decoder.getError() << "]." << std::ends;
+        errorMessage = ss.str();
+        return false;
+    }
+
+    width = decoder.getWidth();
+    height = decoder.getHeight();
+    colorType = decoder.getInfoPng().color.colorType;
+    bitDepth = decoder.getInfoPng().color.bitDepth;
+    interlaced = decoder.getInfoPng().interlaceMethod != 0;
+    return true;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // read a PNG image header infos and datafile and load
-// It uses LogePNG lib.
+// It uses LogePNG lib. The file is memory-mapped, so the decoder inflates the
+// IDAT chunks straight from the mapped pages without copying the file.
 ///////////////////////////////////////////////////////////////////////////////
-bool Png::read(const char* fileName)
+bool Png::read(const char* fileName, bool mapped)
 {
     this->init();   // clear out all values
 
@@ -86,29 +300,219 @@ bool Png::read(const char* fileName)
         return false;
     }
 
+    std::size_t fileSize = 0;
+    const unsigned char* fileData = mapped ? mapFile(fileName, fileSize) : 0;
     std::vector<unsigned char> buffer;
-    LodePNG::loadFile(buffer, fileName);    // load file to memory
+    if(!fileData)
+    {
+        LodePNG::loadFile(buffer, fileName);    // load file to memory
+        if(buffer.empty())
+        {
+            errorMessage = "Failed to open the PNG file to read.";
+            return false;
+        }
+        fileData = &buffer[0];
+        fileSize = buffer.size();
+    }
+
+    // decode PNG file straight into the data, the rows are unfiltered and
+    // converted as soon as they are inflated, so the image is not copied
+    LodePNG::Decoder decoder;
+    bool allocated = true;
+    bitCount = setDecoderColor(decoder, fileData, fileSize, nativeColor);
+    if(bitCount)
+    {
+        std::size_t rowSize = (std::size_t)decoder.getWidth() * bitCount / 8;
+        allocated = resizeData(data, rowSize, decoder.getHeight());
+        if(allocated)
+            decoder.decodeInto(data.data(), rowSize, fileData, fileSize);
+    }
     if(buffer.empty())
+        unmapFile(fileData, fileSize);
+    if(!allocated)
     {
-        errorMessage = "Failed to open the PNG file to read.";
+        std::stringstream ss;
+        ss << "Not enough memory for the " << decoder.getWidth() << "x" << decoder.getHeight()
+           << " PNG image." << std::ends;
+        errorMessage = ss.str();
+        data.clear();
+        bitCount = 0;
+        return false;
+    }
+    if(decoder.hasError())
+    {
+        std::stringstream ss;
+        ss << "Failed to decode PNG file [code:" << decoder.getError() << "]." << std::ends;
+        errorMessage = ss.str();
+        data.clear();
+        bitCount = 0;
+        return false;
+    }
+
+    width = decoder.getWidth();
+    height = decoder.getHeight();
+    colorType = decoder.getInfoPng().color.colorType;
+    bitDepth = decoder.getInfoPng().color.bitDepth;
+    interlaced = decoder.getInfoPng().interlaceMethod != 0;
+    dataSize = data.size();
+    if(decoder.getInfoRaw().color.colorType == 3)
+    {
+        const LodePNG_InfoColor& color = decoder.getInfoPng().color;
+        palette.assign(color.palette, color.palette + color.palettesize * 4);
+    }
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode a PNG file row by row with the streaming decoder of LodePNG
+// Only a few rows and the window of the decompression are in memory, so the
+// callback can upload or scale a large image in strips. The data is not kept.
+///////////////////////////////////////////////////////////////////////////////
+struct PngRowContext
+{
+    Png* png;
+    int* width;
+    int* height;
+    Png::RowCallback callback;
+    void* userData;
+};
+
+static unsigned pngRowFunc(void* data, const LodePNG_Decoder* decoder, unsigned y, const unsigned char* row, size_t)
+{
+    PngRowContext* context = (PngRowContext*)data;
+    *context->width = decoder->infoPng.width;
+    *context->height = decoder->infoPng.height;
+    return context->callback(*context->png, (int)y, row, context->userData) ? 0 : 1;
+}
+
+bool Png::readRows(const char* fileName, RowCallback callback, void* userData)
+{
+    this->init();   // clear out all values
+
+    // check NULL pointer
+    if(!fileName || !callback)
+    {
+        errorMessage = "File name or callback is not defined (NULL pointer).";
+        return false;
+    }
+
+    bitCount = 32;                  // always 32 bit
+    PngRowContext context = { this, &width, &height, callback, userData };
+
+    // decode PNG file, the rows go to the callback
+    LodePNG::Decoder decoder;
+    decoder.decodeStream(fileName, pngRowFunc, &context);
+    if(decoder.hasError())
+    {
+        std::stringstream ss;
+        if(decoder.getError() == 78)
+            ss << "Failed to open the PNG file to read." << std::ends;
+        else
+            ss << "Failed to decode PNG file [code:" << decoder.getError() << "]." << std::ends;
+        errorMessage = ss.str();
+        return false;
+    }
+
+    width = decoder.getWidth();
+    height = decoder.getHeight();
+    colorType = decoder.getInfoPng().color.colorType;
+    bitDepth = decoder.getInfoPng().color.bitDepth;
+    interlaced = decoder.getInfoPng().interlaceMethod != 0;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read only the header of a PNG file, to size the destination of decodeInto()
+// The file is mapped (or read if it cannot be mapped) and kept until
+// decodeInto() or the next read.
+///////////////////////////////////////////////////////////////////////////////
+bool Png::readHeader(const char* fileName)
+{
+    this->init();   // clear out all values
+
+    // check NULL pointer
+    if(!fileName)
+    {
+        errorMessage = "File name is not defined (NULL pointer).";
         return false;
     }
 
-    // decode PNG file
+    fileData = mapFile(fileName, fileSize);
+    if(!fileData)
+    {
+        LodePNG::loadFile(fileBuffer, fileName);    // load file to memory
+        if(fileBuffer.empty())
+        {
+            errorMessage = "Failed to open the PNG file to read.";
+            return false;
+        }
+        fileData = &fileBuffer[0];
+        fileSize = fileBuffer.size();
+    }
+
     LodePNG::Decoder decoder;
-    decoder.decode(data, &buffer[0], (unsigned)buffer.size());
+    bitCount = setDecoderColor(decoder, fileData, fileSize, nativeColor);
     if(decoder.hasError())
     {
         std::stringstream ss;
         ss << "Failed to decode PNG file [code:" << decoder.getError() << "]." << std::ends;
         errorMessage = ss.str();
+        closeFile();
         return false;
     }
 
     width = decoder.getWidth();
     height = decoder.getHeight();
-    bitCount = 32;                  // always 32 bit
-    dataSize = data.size();
+    colorType = decoder.getInfoPng().color.colorType;
+    bitDepth = decoder.getInfoPng().color.bitDepth;
+    interlaced = decoder.getInfoPng().interlaceMethod != 0;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode the file of readHeader() into dst, row y at dst + y * rowStride
+// The rows are unfiltered and converted straight into dst, the decoded image
+// is never in memory of Png. The file is released afterwards.
+///////////////////////////////////////////////////////////////////////////////
+bool Png::decodeInto(void* dst, std::size_t rowStride)
+{
+    if(!fileData)
+    {
+        errorMessage = "No PNG file to decode, call readHeader() first.";
+        return false;
+    }
+
+    if(!dst || rowStride < ((std::size_t)width * bitCount + 7) / 8)
+    {
+        errorMessage = "Destination is NULL or the row stride is smaller than a row.";
+        closeFile();
+        return false;
+    }
+
+    LodePNG::Decoder decoder;
+    setDecoderColor(decoder, fileData, fileSize, nativeColor);
+    decoder.decodeInto((unsigned char*)dst, rowStride, fileData, fileSize);
+    closeFile();
+    if(decoder.hasError())
+    {
+        std::stringstream ss;
+        ss << "Failed to decode PNG file [code:" << decoder.getError() << "]." << std::ends;
+        errorMessage = ss.str();
+        return false;
+    }
+
+    if(decoder.getInfoRaw().color.colorType == 3)
+    {
+        const LodePNG_InfoColor& color = decoder.getInfoPng().color;
+        palette.assign(color.palette, color.palette + color.palettesize * 4);
+    }
 
     return true;
 }
@@ -117,9 +521,12 @@ bool Png::read(const char* fileName)
 
 ///////////////////////////////////////////////////////////////////////////////
 // save an image as a PNG format
+// The compression level is from 0 (no compression), 1 (fastest) to 9 (smallest).
+// The scanlines are filtered and compressed in bands and written as they are
+// done, so neither the whole PNG nor the filtered image is in memory.
 // NOTE: support only 32-bit RGBA data
 ///////////////////////////////////////////////////////////////////////////////
-bool Png::save(const char* fileName, int w, int h, int channelCount, const unsigned char* data)
+bool Png::save(const char* fileName, int w, int h, int channelCount, const unsigned char* data, int level)
 {
     // reset error message
     errorMessage = "No error.";
@@ -144,12 +551,18 @@ bool Png::save(const char* fileName, int w, int h, int channelCount, const unsig
 
     // create encoder and set settings
     LodePNG::Encoder encoder;
-    encoder.getSettings().zlibsettings.windowSize = 2048;
+    LodeZlib_DeflateSettings_setLevel(&encoder.getSettings().zlibsettings, level < 0 ? 0 : level);
+    encoder.getSettings().numThreads = 0;   // filter scanlines on all CPUs
 
-    // encode and save
-    std::vector<unsigned char> buffer;
-    encoder.encode(buffer, data, w, h);
-    LodePNG::saveFile(buffer, fileName);
+    // encode and write to the file band by band
+    encoder.encodeStream(fileName, data, w, h);
+    if(encoder.hasError())
+    {
+        std::stringstream ss;
+        ss << "Failed to save " << fileName << " (LodePNG error " << encoder.getError() << ").";
+        errorMessage = ss.str();
+        return false;
+    }
 
     return true;
 }
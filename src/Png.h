@@ -6,13 +6,20 @@
 //
 // Dependency: This class requires lodepng.h/.cpp
 //
+// 2023-03-31: save() encodes and writes the file band by band.
+// 2023-03-29: Added probe() to read only the header.
+// 2023-03-28: Added native color types of the file with setNativeColor().
+// 2023-03-27: Added readHeader() and decodeInto() to decode into a given buffer.
+// 2023-03-26: Memory-mapped file input in read().
+// 2023-03-25: Added readRows() to decode row by row with bounded memory.
+// 2023-03-23: Added compression level and threads to save().
 // 2018-08-10: Replaced &data[0] to .data() function.
 // 2013-01-23: Changed data size to side_t for 64bit.
 // 2009-09-17: Currently support only 32-bit RGBA read/save.
 //
 //  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
 // CREATED: 2009-09-17
-// UPDATED: 2018-08-10
+// UPDATED: 2023-03-31
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef IMAGE_PNG_H
@@ -30,18 +37,53 @@ namespace Image
         Png();
         ~Png();
 
-        // load image header and data from a png file
-        bool read(const char* fileName);
+        // decode to the color type of the file instead of 32-bit RGBA, with 8 bits
+        // per channel: grey (8), grey+alpha (16), RGB (24), RGBA (32) or palette
+        // indices (8) with getPalette(). A color key (tRNS) adds the alpha channel.
+        // It applies to read() and readHeader()/decodeInto(), not to readRows().
+        void setNativeColor(bool flag);
+        bool isNativeColor() const;
+
+        // read only the signature and IHDR chunk (33 bytes) of a png file
+        // The size, color type, bit depth and interlace are set, the image data
+        // is not read. getBitCount() is 0 because it depends on the decoding.
+        bool probe(const char* fileName);
 
-        // save an image as PNG format
-        bool save(const char* fileName, int width, int height, int channelCount, const unsigned char* data);
+        // load image header and data from a png file
+        // The file is memory-mapped and decoded in place, or read into memory if
+        // mapped is false or the file cannot be mapped (e.g. a pipe).
+        bool read(const char* fileName, bool mapped=true);
+
+        // decode a png file row by row, without the file or the image in memory
+        // The callback gets each 32-bit RGBA row as soon as it is decoded, and
+        // returns false to stop. The width and height are set before the first row.
+        typedef bool (*RowCallback)(const Png& png, int y, const unsigned char* row, void* userData);
+        bool readRows(const char* fileName, RowCallback callback, void* userData=0);
+
+        // decode in 2 phases into memory of the caller, e.g. a mapped pixel buffer
+        // readHeader() maps the file and reads only the size, so the destination
+        // can be allocated, then decodeInto() writes the rows at
+        // dst + y * rowStride (rowStride >= width * bitCount / 8) and releases
+        // the file.
+        // getData() stays empty.
+        bool readHeader(const char* fileName);
+        bool decodeInto(void* dst, std::size_t rowStride);
+
+        // save an image as PNG format, encoded and written band by band
+        // level: 0 = no compression, 1 = fastest, ..., 9 = smallest file
+        bool save(const char* fileName, int width, int height, int channelCount, const unsigned char* data, int level=6);
 
         // getters
         int getWidth() const;                       // return width of image in pixel
         int getHeight() const;                      // return height of image in pixel
-        int getBitCount() const;                    // return the number of bits per pixel (8, 24, or 32)
+        int getBitCount() const;                    // return the number of bits per pixel (8, 16, 24, or 32)
+        int getColorType() const;                   // PNG color type of the file (0, 2, 3, 4 or 6)
+        int getBitDepth() const;                    // bits per channel of the file (1, 2, 4, 8 or 16)
+        bool isInterlaced() const;                  // Adam7 interlaced file
         std::size_t getDataSize() const;            // return data size in bytes
         const unsigned char* getData() const;       // return the pointer to image data
+        int getPaletteSize() const;                 // # of palette colors, 0 if not indexed
+        const unsigned char* getPalette() const;    // RGBA of each palette color
 
         void printSelf() const;                     // print itself for debug purpose
         const char* getError() const;               // return last error message
@@ -52,14 +94,25 @@ namespace Image
     private:
         // member functions
         void init();                                // clear the existing values
+        void closeFile();                           // release the file of readHeader()
+        Png(const Png&);                            // not copyable, it owns the mapped file
+        Png& operator=(const Png&);
 
         // member variables
         int width;
         int height;
         int bitCount;
+        int colorType;                              // from IHDR of the file
+        int bitDepth;
+        bool interlaced;
         std::size_t dataSize;
         std::vector<unsigned char> data;            // data with default BGR order
+        std::vector<unsigned char> palette;         // RGBA palette of indexed data
+        bool nativeColor;                           // keep the color type of the file
         std::string errorMessage;
+        const unsigned char* fileData;              // file between readHeader() and decodeInto()
+        std::size_t fileSize;
+        std::vector<unsigned char> fileBuffer;      // file copy if it cannot be mapped
     };
 
 
@@ -69,12 +122,22 @@ namespace Image
     inline int Png::getWidth() const { return width; }
     inline int Png::getHeight() const { return height; }
 
-    // return bits per pixel, 8 means grayscale, 24 means RGB color, 32 means RGBA
+    // return bits per pixel, 8 means grayscale (or palette indices), 16 means
+    // grayscale with alpha, 24 means RGB color, 32 means RGBA
     inline int Png::getBitCount() const { return bitCount; }
 
+    inline int Png::getColorType() const { return colorType; }
+    inline int Png::getBitDepth() const { return bitDepth; }
+    inline bool Png::isInterlaced() const { return interlaced; }
+
     inline std::size_t Png::getDataSize() const { return dataSize; }
     inline const unsigned char* Png::getData() const { return data.data(); }
 
+    inline void Png::setNativeColor(bool flag) { nativeColor = flag; }
+    inline bool Png::isNativeColor() const { return nativeColor; }
+    inline int Png::getPaletteSize() const { return (int)palette.size() / 4; }
+    inline const unsigned char* Png::getPalette() const { return palette.data(); }
+
     inline const char* Png::getError() const { return errorMessage.c_str(); }
 }
 
@@ -0,0 +1,817 @@
+///////////////////////////////////////////////////////////////////////////////
+// PngBenchmark.cpp
+// ================
+// Decode and encode throughput benchmark of LodePNG with a PNG file
+// - the file is loaded into memory once, and each case decodes it repeatedly
+// - throughput is the decompressed (raw scanline) bytes per second, except the
+//   chunk case, which is the PNG file bytes per second
+// - the unfilter case runs only for non-interlaced images without padding bits
+//   at the end of each scanline
+// - the streaming case reads the file in 4KB blocks and gets the image row by row
+// - the decode-into case writes the rows into a buffer allocated once, with the
+//   row pitch aligned to 256 bytes like a pixel buffer of a GPU
+// - the load table has the time and peak RSS of Image::Png::read() with the
+//   file memory-mapped and read into memory, and of Image::Png::probe(), which
+//   reads only the header (peak RSS on Linux only)
+// - the allocation table has the time and allocations per image of decoding
+//   into a buffer and encoding, with malloc and with an arena reset after each
+//   image (the PNG output of the encoder is always allocated with malloc)
+// - the output of every case is compared with the default decoder
+// - the encode table has the size, ratio and throughput of each compression
+//   level (0~9), filter strategy and thread count for the decoded RGBA image,
+//   or any RGBA image (e.g. a 4K frame dump) with runEncode()
+// - the stream case encodes band by band with the streaming encoder, which
+//   gives the PNG chunk by chunk to a write function instead of in one buffer
+// - the thread cases filter and deflate on 1~8 threads, and print the speedup
+//   over 1 thread
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-23
+// UPDATED: 2023-03-31
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#ifdef __GLIBC__
+#include <malloc.h>                     // for malloc_trim()
+#endif
+#include "PngBenchmark.h"
+#include "Png.h"
+#include "Timer.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+PngBenchmark::PngBenchmark(int iterations) : width(0), height(0), bpp(0), interlaced(false),
+                                              iterations(1)
+{
+    setIterations(iterations);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load PNG file into memory, concatenate the zlib stream of IDAT chunks and
+// decode it once with the default settings as the reference
+///////////////////////////////////////////////////////////////////////////////
+bool PngBenchmark::load(const char* fileName)
+{
+    this->fileName = fileName ? fileName : "";
+    file.clear();
+    idat.clear();
+    scanlines.clear();
+    pixels.clear();
+    rawPixels.clear();
+    results.clear();
+    width = height = bpp = 0;
+    interlaced = false;
+
+    LodePNG::loadFile(file, this->fileName);
+    if(file.size() < 33)
+    {
+        std::cout << "[ERROR] Failed to load PNG file: " << this->fileName << std::endl;
+        return false;
+    }
+
+    // skip 8-byte signature, then walk through chunks
+    const unsigned char* chunk = &file[8];
+    const unsigned char* end = &file[0] + file.size();
+    while(end - chunk >= 12)
+    {
+        size_t length = LodePNG_chunk_length(chunk);
+        if((size_t)(end - chunk) - 12 < length)
+            break;  // broken chunk
+
+        if(LodePNG_chunk_type_equals(chunk, "IDAT"))
+            idat.insert(idat.end(), chunk + 8, chunk + 8 + length);
+        else if(LodePNG_chunk_type_equals(chunk, "IEND"))
+            break;
+        chunk = LodePNG_chunk_next_const(chunk);
+    }
+
+    unsigned error = LodeZlib::decompress(scanlines, idat);
+    if(!error)
+    {
+        LodePNG::Decoder decoder;
+        decoder.decode(pixels, file);
+        error = decoder.getError();
+        width = decoder.getWidth();
+        height = decoder.getHeight();
+        bpp = decoder.getBpp();
+        interlaced = decoder.getInfoPng().interlaceMethod != 0;
+    }
+    if(!error)
+    {
+        // unfiltered scanlines without color conversion, the reference of unfilter
+        LodePNG::Decoder decoder;
+        LodePNG_DecodeSettings settings;
+        LodePNG_DecodeSettings_init(&settings);
+        settings.color_convert = 0;
+        decoder.setSettings(settings);
+        decoder.decode(rawPixels, file);
+        error = decoder.getError();
+    }
+    if(error)
+    {
+        std::cout << "[ERROR] Failed to decode PNG file [code:" << error << "]: " << this->fileName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// run all cases, then print the results
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::run()
+{
+    results.clear();
+    if(scanlines.empty())
+        return;
+
+    // inflate only, with tree walking and lookup table Huffman decoding
+    LodeZlib_DecompressSettings zlibSettings;
+    LodeZlib_DecompressSettings_init(&zlibSettings);
+    zlibSettings.huffmanTable = 0;
+    runInflate("inflate, Huffman tree walk", zlibSettings);
+    zlibSettings.huffmanTable = 1;
+    runInflate("inflate, Huffman lookup table", zlibSettings);
+    zlibSettings.ignoreAdler32 = 1;
+    runInflate("inflate, ignoreAdler32", zlibSettings);
+    zlibSettings.ignoreAdler32 = 0;
+    runInflate("inflate, pre-sized output", zlibSettings, true);
+
+    // chunk handling only: CRC check of all chunks and IDAT concatenation
+    runChunks("chunks, CRC check + IDAT copy");
+
+    // undo the filters of the inflated scanlines only
+    if(!interlaced && (width * bpp) % 8 == 0)
+        runUnfilter("unfilter");
+
+    // convert the unfiltered image from the color type of the file to RGBA only
+    runConvert("convert to RGBA");
+
+    // full decode to RGBA
+    LodePNG_DecodeSettings settings;
+    LodePNG_DecodeSettings_init(&settings);
+    runDecode("decode, default", settings);
+    settings.ignoreCrc = 1;
+    runDecode("decode, ignoreCrc", settings);
+    settings.zlibsettings.ignoreAdler32 = 1;
+    runDecode("decode, ignoreCrc + ignoreAdler32", settings);
+
+    // decode row by row from a read function, with bounded memory
+    runDecodeStream("decode, streaming rows");
+
+    // decode into a buffer of the caller with a row pitch, no allocation of the image
+    runDecodeInto("decode, into buffer (pitch 256)");
+
+    printSelf();
+
+    // load the file with Image::Png, memory-mapped and copied
+    runLoad();
+
+    // allocations of the decoder and encoder with malloc and with an arena
+    runAllocations();
+
+    // re-encode the decoded image with all compression levels
+    if(!pixels.empty())
+        runEncode(&pixels[0], width, height, fileName.c_str());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read the value of a line in /proc/self/status in KB, e.g. "VmHWM:" (peak RSS)
+// Returns -1 if it is not available (not Linux).
+///////////////////////////////////////////////////////////////////////////////
+static long readStatusKb(const char* key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+    {
+        if(line.compare(0, strlen(key), key) == 0)
+            return atol(line.c_str() + strlen(key));
+    }
+    return -1;
+}
+
+// reset the peak RSS to the current RSS (Linux 4.0 or later)
+// The free memory of the heap is returned first, otherwise the next load
+// reuses it without growing the RSS.
+static bool resetPeakRss()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load a file with Image::Png, mode 0: mmap, 1: read into memory, 2: header only
+///////////////////////////////////////////////////////////////////////////////
+static bool loadPng(Image::Png& png, const char* fileName, int mode)
+{
+    if(mode == 2)
+        return png.probe(fileName);
+    return png.read(fileName, mode == 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load the file with Image::Png repeatedly, memory-mapped, read into memory and
+// header only, and print the time and how much the peak RSS grows while
+// loading once
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runLoad()
+{
+    std::cout << "===== PngBenchmark: load =====\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(40) << "Case" << std::right
+              << std::setw(12) << "Time (ms)" << std::setw(16) << "Peak RSS (KB)" << "\n";
+
+    const char* names[] = { "Png::read, mmap", "Png::read, file copy", "Png::probe, header only" };
+    for(int mode = 0; mode < 3; ++mode)
+    {
+        Image::Png png;
+        bool loaded = loadPng(png, fileName.c_str(), mode);     // warm up the file cache
+
+        Timer timer;
+        timer.start();
+        for(int i = 0; i < iterations && loaded; ++i)
+        {
+            Image::Png png2;
+            loaded = loadPng(png2, fileName.c_str(), mode);
+        }
+        timer.stop();
+
+        // peak RSS while loading once, from the RSS before
+        long peak = -1;
+        if(resetPeakRss())
+        {
+            long before = readStatusKb("VmRSS:");
+            {
+                Image::Png png2;
+                loadPng(png2, fileName.c_str(), mode);
+                peak = readStatusKb("VmHWM:");
+            }
+            if(before >= 0 && peak >= 0)
+                peak -= before;
+        }
+
+        bool matched = loaded && (unsigned)png.getWidth() == width && (unsigned)png.getHeight() == height;
+        if(mode < 2)
+            matched = matched && png.getDataSize() == pixels.size() && std::equal(pixels.begin(), pixels.end(), png.getData());
+        std::cout << std::left << std::setw(40) << names[mode] << std::right
+                  << std::setw(12) << timer.getElapsedTimeInMilliSec() / iterations;
+        if(peak >= 0)
+            std::cout << std::setw(16) << peak;
+        else
+            std::cout << std::setw(16) << "n/a";
+        std::cout << (matched ? "" : "  [MISMATCH]") << "\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << std::resetiosflags(std::ios_base::fixed | std::ios_base::floatfield);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// allocator that counts the calls of malloc and realloc
+///////////////////////////////////////////////////////////////////////////////
+static void* countAllocate(void* data, size_t size)
+{
+    ++*(size_t*)data;
+    return malloc(size);
+}
+
+static void* countReallocate(void* data, void* ptr, size_t size)
+{
+    ++*(size_t*)data;
+    return realloc(ptr, size);
+}
+
+static void countDeallocate(void*, void* ptr)
+{
+    free(ptr);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode into a buffer and encode repeatedly, with malloc and with an arena
+// that is reset after each image like in a batch, and print the time and the
+// allocations per image. The mallocs of the arena are its blocks.
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runAllocations()
+{
+    if(pixels.empty())
+        return;
+
+    std::cout << "===== PngBenchmark: allocations =====\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(40) << "Case" << std::right << std::setw(12) << "Time (ms)"
+              << std::setw(12) << "Allocs" << std::setw(12) << "Mallocs" << "\n";
+
+    size_t mallocCount = 0;
+    LodePNG_Allocator counter = { countAllocate, countReallocate, countDeallocate, &mallocCount };
+    LodePNG_Arena arena;
+    LodePNG_Arena_init(&arena, 0);
+
+    const char* names[] = { "decode into buffer, malloc", "decode into buffer, arena",
+                            "encode, malloc", "encode, arena" };
+    std::vector<unsigned char> out(pixels.size());
+    for(int mode = 0; mode < 4; ++mode)
+    {
+        bool useArena = (mode % 2) == 1;
+        const LodePNG_Allocator* allocator = useArena ? &arena.allocator : &counter;
+        LodePNG::Decoder decoder;
+        LodePNG::Encoder encoder;
+        decoder.getSettings().allocator = allocator;
+        encoder.getSettings().allocator = allocator;
+        std::vector<unsigned char> png;
+
+        // the first image is the warm up, the arena keeps one block for the next ones
+        size_t allocCount = 0, blockCount = 0;
+        Timer timer;
+        for(int i = -1; i < iterations; ++i)
+        {
+            if(i == 0)
+            {
+                mallocCount = 0;
+                allocCount = arena.allocations;
+                blockCount = arena.blockAllocations;
+                timer.start();
+            }
+            if(mode < 2)
+            {
+                decoder.decodeInto(&out[0], (size_t)width * 4, &file[0], file.size());
+            }
+            else
+            {
+                png.clear();
+                encoder.encode(png, &pixels[0], width, height);
+            }
+            LodePNG_Arena_reset(&arena);
+        }
+        timer.stop();
+
+        if(useArena)
+        {
+            allocCount = arena.allocations - allocCount;
+            blockCount = arena.blockAllocations - blockCount;
+        }
+        else
+        {
+            allocCount = blockCount = mallocCount;
+        }
+
+        bool matched;
+        if(mode < 2)
+        {
+            matched = !decoder.hasError() && out == pixels;
+        }
+        else
+        {
+            std::vector<unsigned char> decoded;
+            LodePNG::Decoder check;
+            check.decode(decoded, png);
+            matched = !encoder.hasError() && !check.hasError() && decoded == pixels;
+        }
+        std::cout << std::left << std::setw(40) << names[mode] << std::right
+                  << std::setw(12) << timer.getElapsedTimeInMilliSec() / iterations
+                  << std::setw(12) << (double)allocCount / iterations
+                  << std::setw(12) << (double)blockCount / iterations
+                  << (matched ? "" : "  [MISMATCH]") << "\n";
+    }
+    LodePNG_Arena_cleanup(&arena);
+
+    std::cout << std::endl;
+    std::cout << std::resetiosflags(std::ios_base::fixed | std::ios_base::floatfield);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// encode RGBA image repeatedly with each compression level, then with the
+// filter strategies and threads of the encoder at the default level, and print
+// the table of compressed size, ratio (raw RGBA / PNG size) and throughput
+// (MB/s of RGBA bytes). Each case runs up to the iterations or about a second.
+// The PNG of each case is decoded once to check it.
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runEncode(const unsigned char* rgba, unsigned w, unsigned h, const char* name)
+{
+    if(!rgba || w == 0 || h == 0)
+        return;
+
+    std::cout << "===== PngBenchmark: encode =====\n"
+              << "Image: " << (name ? name : "") << " (" << w << "x" << h << ", " << (size_t)w * h * 4 << " bytes RGBA)\n"
+              << "Iterations: " << iterations << "\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(32) << "Case" << std::right << std::setw(12) << "Size"
+              << std::setw(10) << "Ratio" << std::setw(12) << "Time (ms)" << std::setw(12) << "MB/s" << "\n";
+
+    LodePNG_EncodeSettings settings;
+    for(unsigned level = 0; level <= 9; ++level)
+    {
+        LodePNG_EncodeSettings_init(&settings);
+        LodeZlib_DeflateSettings_setLevel(&settings.zlibsettings, level);
+        std::stringstream ss;
+        ss << "level " << level;
+        runEncodeCase(ss.str().c_str(), settings, rgba, w, h);
+    }
+
+    // filter selection at the default level
+    LodePNG_EncodeSettings_init(&settings);
+    settings.filterStrategy = 1;
+    runEncodeCase("level 6, entropy filter", settings, rgba, w, h);
+    settings.filterStrategy = 0;
+
+    // streaming encoder, band by band to a write function
+    runEncodeCase("level 6, stream", settings, rgba, w, h, 0, true);
+
+    // filtering and deflate segments on multiple threads, with the speedup
+    double baseTime = 0;
+    for(unsigned threads = 1; threads <= 8; threads *= 2)
+    {
+        settings.numThreads = threads;
+        std::stringstream ss;
+        ss << "level 6, " << threads << (threads == 1 ? " thread" : " threads");
+        double time = runEncodeCase(ss.str().c_str(), settings, rgba, w, h, baseTime);
+        if(threads == 1)
+            baseTime = time;
+    }
+
+    std::cout << std::endl;
+    std::cout << std::resetiosflags(std::ios_base::fixed | std::ios_base::floatfield);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// write function of the streaming encoder, appends the chunks to a vector
+///////////////////////////////////////////////////////////////////////////////
+static size_t appendChunks(void* data, const unsigned char* buffer, size_t size)
+{
+    std::vector<unsigned char>* png = (std::vector<unsigned char>*)data;
+    png->insert(png->end(), buffer, buffer + size);
+    return size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// encode RGBA image repeatedly with the settings and print a row of the table
+// If baseTime is given, the speedup over it is appended. Returns the time (ms).
+// If stream is true, it encodes with the streaming encoder.
+///////////////////////////////////////////////////////////////////////////////
+double PngBenchmark::runEncodeCase(const char* name, const LodePNG_EncodeSettings& settings,
+                                   const unsigned char* rgba, unsigned w, unsigned h, double baseTime,
+                                   bool stream)
+{
+    size_t rawSize = (size_t)w * h * 4;
+    LodePNG::Encoder encoder;
+    encoder.setSettings(settings);
+    std::vector<unsigned char> png;
+    if(stream)
+        encoder.encodeStream(appendChunks, &png, rgba, w, h);  // warm up
+    else
+        encoder.encode(png, rgba, w, h);                // warm up
+
+    // stop after about a second, the best levels of a 4K frame take long
+    Timer timer;
+    timer.start();
+    int count = 0;
+    while(count < iterations && !encoder.hasError() && (count == 0 || timer.getElapsedTimeInMilliSec() < 1000))
+    {
+        png.clear();
+        if(stream)
+            encoder.encodeStream(appendChunks, &png, rgba, w, h);
+        else
+            encoder.encode(png, rgba, w, h);
+        ++count;
+    }
+    timer.stop();
+    double time = timer.getElapsedTimeInMilliSec() / count;
+
+    // decode it back to compare with the input
+    std::vector<unsigned char> out;
+    LodePNG::Decoder decoder;
+    if(!encoder.hasError())
+        decoder.decode(out, png);
+    bool matched = !encoder.hasError() && !decoder.hasError() && out.size() == rawSize &&
+                   std::equal(out.begin(), out.end(), rgba);
+
+    std::cout << std::left << std::setw(32) << name << std::right << std::setw(12) << png.size()
+              << std::setw(10) << (png.empty() ? 0.0 : (double)rawSize / png.size())
+              << std::setw(12) << time
+              << std::setw(12) << ((time > 0) ? (rawSize / (1024.0 * 1024.0)) / (time * 0.001) : 0);
+    if(baseTime > 0 && time > 0)
+        std::cout << std::setprecision(2) << "  x" << baseTime / time << std::setprecision(3);
+    std::cout << (matched ? "" : "  [MISMATCH]") << "\n";
+    return time;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print the results
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::printSelf() const
+{
+    std::cout << "===== PngBenchmark =====\n"
+              << "File: " << fileName << " (" << width << "x" << height << ", "
+              << file.size() << " bytes, " << scanlines.size() << " raw bytes)\n"
+              << "Iterations: " << iterations << "\n";
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(40) << "Case" << std::right
+              << std::setw(12) << "Time (ms)" << std::setw(12) << "MB/s" << "\n";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        std::cout << std::left << std::setw(40) << r.name << std::right
+                  << std::setw(12) << r.time << std::setw(12) << r.mbps
+                  << (r.matched ? "" : "  [MISMATCH]") << "\n";
+    }
+    std::cout << std::endl;
+    std::cout << std::resetiosflags(std::ios_base::fixed | std::ios_base::floatfield);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// inflate the IDAT data repeatedly with the given settings
+// If presized is true, it inflates into a buffer of the size of the result,
+// like the decoder does, instead of a buffer that grows while inflating.
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runInflate(const char* name, const LodeZlib_DecompressSettings& settings, bool presized)
+{
+    if(presized)
+    {
+        size_t size = scanlines.size();
+        unsigned char* buffer = (unsigned char*)malloc(size);
+        unsigned error = buffer ? 0 : 1;
+
+        Timer timer;
+        timer.start();
+        for(int i = 0; i < iterations && !error; ++i)
+        {
+            size = scanlines.size();
+            error = LodeZlib_decompress(&buffer, &size, &idat[0], idat.size(), &settings);
+        }
+        timer.stop();
+
+        bool matched = !error && size == scanlines.size() && std::equal(scanlines.begin(), scanlines.end(), buffer);
+        free(buffer);
+        addResult(name, timer.getElapsedTimeInMilliSec() / iterations, scanlines.size(), matched);
+        return;
+    }
+
+    std::vector<unsigned char> out;
+    unsigned error = LodeZlib::decompress(out, idat, settings);    // warm up
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations && !error; ++i)
+    {
+        out.clear();
+        error = LodeZlib::decompress(out, idat, settings);
+    }
+    timer.stop();
+
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, scanlines.size(), !error && out == scanlines);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// undo the filters of the inflated scanlines repeatedly
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runUnfilter(const char* name)
+{
+    std::vector<unsigned char> out(rawPixels.size());
+    unsigned error = out.empty() ? 0 : LodePNG_unfilter(&out[0], &scanlines[0], width, height, bpp);   // warm up
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations && !error && !out.empty(); ++i)
+        error = LodePNG_unfilter(&out[0], &scanlines[0], width, height, bpp);
+    timer.stop();
+
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, scanlines.size(), !error && out == rawPixels);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// convert the image in the color type of the file to RGBA repeatedly, the
+// throughput is of the RGBA bytes
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runConvert(const char* name)
+{
+    // the color of the file, with its palette and color key
+    std::vector<unsigned char> raw;
+    LodePNG::Decoder decoder;
+    LodePNG_DecodeSettings settings;
+    LodePNG_DecodeSettings_init(&settings);
+    settings.color_convert = 0;
+    decoder.setSettings(settings);
+    decoder.decode(raw, file);
+
+    std::vector<unsigned char> out(pixels.size());
+    LodePNG_InfoColor& rawColor = decoder.getInfoPng().color;
+    LodePNG_InfoColor rgbaColor;
+    LodePNG_InfoColor_init(&rgbaColor);                             // RGBA with 8 bits
+    unsigned error = decoder.getError();
+    if(!error && !out.empty())
+        error = LodePNG_convert(&out[0], &rawPixels[0], &rgbaColor, &rawColor, width, height);  // warm up
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations && !error && !out.empty(); ++i)
+        error = LodePNG_convert(&out[0], &rawPixels[0], &rgbaColor, &rawColor, width, height);
+    timer.stop();
+    LodePNG_InfoColor_cleanup(&rgbaColor);
+
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, pixels.size(), !error && out == pixels);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode the PNG file repeatedly with the given settings
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runDecode(const char* name, const LodePNG_DecodeSettings& settings)
+{
+    std::vector<unsigned char> out;
+    LodePNG::Decoder decoder;
+    decoder.setSettings(settings);
+    decoder.decode(out, file);                      // warm up
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations && !decoder.hasError(); ++i)
+    {
+        out.clear();
+        decoder.decode(out, file);
+    }
+    timer.stop();
+
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, scanlines.size(), !decoder.hasError() && out == pixels);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode with the streaming decoder repeatedly. The file is read from memory
+// in blocks of 4KB like fread(), and each row is compared with the reference.
+///////////////////////////////////////////////////////////////////////////////
+struct StreamContext
+{
+    const std::vector<unsigned char>* file;
+    size_t pos;                                     // read position in file
+    const std::vector<unsigned char>* pixels;       // reference RGBA image
+    bool matched;
+    unsigned rowCount;
+};
+
+static size_t streamRead(void* data, unsigned char* buffer, size_t size)
+{
+    StreamContext* context = (StreamContext*)data;
+    size_t count = std::min(std::min(size, (size_t)4096), context->file->size() - context->pos);
+    if(count > 0)
+        memcpy(buffer, &(*context->file)[context->pos], count);
+    context->pos += count;
+    return count;
+}
+
+static unsigned streamRow(void* data, const LodePNG_Decoder*, unsigned y, const unsigned char* row, size_t rowSize)
+{
+    StreamContext* context = (StreamContext*)data;
+    size_t offset = (size_t)y * rowSize;
+    if(offset + rowSize > context->pixels->size() || memcmp(&(*context->pixels)[offset], row, rowSize) != 0)
+        context->matched = false;
+    ++context->rowCount;
+    return 0;
+}
+
+void PngBenchmark::runDecodeStream(const char* name)
+{
+    StreamContext context = { &file, 0, &pixels, true, 0 };
+    LodePNG::Decoder decoder;
+    decoder.decodeStream(streamRead, &context, streamRow, &context);    // warm up
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations && !decoder.hasError(); ++i)
+    {
+        context.pos = 0;
+        context.rowCount = 0;
+        decoder.decodeStream(streamRead, &context, streamRow, &context);
+    }
+    timer.stop();
+
+    bool matched = !decoder.hasError() && context.matched && context.rowCount == height;
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, scanlines.size(), matched);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode into the same buffer repeatedly, the row pitch is a multiple of 256
+// bytes and the padding between rows must stay untouched
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runDecodeInto(const char* name)
+{
+    size_t rowSize = (size_t)width * 4;
+    size_t pitch = (rowSize + 255) & ~(size_t)255;
+    std::vector<unsigned char> out(pitch * height, 0xcd);
+    LodePNG::Decoder decoder;
+    decoder.decodeInto(&out[0], pitch, &file[0], file.size());  // warm up
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations && !decoder.hasError(); ++i)
+        decoder.decodeInto(&out[0], pitch, &file[0], file.size());
+    timer.stop();
+
+    bool matched = !decoder.hasError();
+    for(unsigned y = 0; y < height && matched; ++y)
+    {
+        const unsigned char* row = &out[y * pitch];
+        matched = memcmp(row, &pixels[y * rowSize], rowSize) == 0;
+        for(size_t x = rowSize; x < pitch && matched; ++x)
+            matched = row[x] == 0xcd;
+    }
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, scanlines.size(), matched);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// walk through the chunks repeatedly, check the CRC of each chunk and
+// concatenate IDAT data, which is what the decoder did before it inflated the
+// IDAT chunks in place
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::runChunks(const char* name)
+{
+    std::vector<unsigned char> out;
+    bool crcOk = true;
+
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < iterations; ++i)
+    {
+        out.clear();
+        const unsigned char* chunk = &file[8];
+        const unsigned char* end = &file[0] + file.size();
+        while(end - chunk >= 12)
+        {
+            size_t length = LodePNG_chunk_length(chunk);
+            if((size_t)(end - chunk) - 12 < length)
+                break;
+
+            if(LodePNG_chunk_check_crc(chunk))
+                crcOk = false;
+            if(LodePNG_chunk_type_equals(chunk, "IDAT"))
+                out.insert(out.end(), chunk + 8, chunk + 8 + length);
+            else if(LodePNG_chunk_type_equals(chunk, "IEND"))
+                break;
+            chunk = LodePNG_chunk_next_const(chunk);
+        }
+    }
+    timer.stop();
+
+    addResult(name, timer.getElapsedTimeInMilliSec() / iterations, file.size(), crcOk && out == idat);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add a result, throughput is computed from the given bytes per decode
+///////////////////////////////////////////////////////////////////////////////
+void PngBenchmark::addResult(const char* name, double time, size_t byteCount, bool matched)
+{
+    Result result;
+    result.name = name;
+    result.time = time;
+    result.mbps = (time > 0) ? (byteCount / (1024.0 * 1024.0)) / (time * 0.001) : 0;
+    result.matched = matched;
+    results.push_back(result);
+}
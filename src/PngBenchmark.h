@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// PngBenchmark.h
+// ==============
+// Decode and encode throughput benchmark of LodePNG with a PNG file
+// - the file is loaded into memory once, and each case decodes it repeatedly
+// - throughput is the decompressed (raw scanline) bytes per second, except the
+//   chunk case, which is the PNG file bytes per second, and the convert case,
+//   which is the RGBA bytes per second
+// - the pre-sized inflate case inflates into a buffer of the size of the
+//   result, like the decoder, the others into a buffer that grows
+// - the unfilter case runs only for non-interlaced images without padding bits
+//   at the end of each scanline
+// - the convert case converts the unfiltered image from the color type of the
+//   file to RGBA, like the decoder does for each row
+// - the streaming case reads the file in 4KB blocks and gets the image row by row
+// - the decode-into case writes the rows into a buffer allocated once, with the
+//   row pitch aligned to 256 bytes like a pixel buffer of a GPU
+// - the load table has the time and peak RSS of Image::Png::read() with the
+//   file memory-mapped and read into memory, and of Image::Png::probe(), which
+//   reads only the header (peak RSS on Linux only)
+// - the allocation table has the time and allocations per image of decoding
+//   and encoding with malloc, and with an arena reset after each image
+// - the output of every case is compared with the default decoder
+// - the encode table has the size, ratio and throughput of each compression
+//   level (0~9), filter strategy and thread count for the decoded RGBA image,
+//   or any RGBA image (e.g. a 4K frame dump) with runEncode()
+// - the stream case encodes band by band with the streaming encoder, which
+//   gives the PNG chunk by chunk to a write function instead of in one buffer
+//
+// usage:
+//  PngBenchmark bench;
+//  if(bench.load("grid512.png"))
+//      bench.run();                // run all cases and print the results
+//  bench.runEncode(frame, w, h, "frame"); // encode table of an RGBA image
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-23
+// UPDATED: 2023-03-31
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PNG_BENCHMARK_H
+#define PNG_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include "lodepng.h"
+
+class PngBenchmark
+{
+public:
+    // ctor/dtor
+    PngBenchmark(int iterations=20);
+    ~PngBenchmark() {}
+
+    bool load(const char* fileName);                // load PNG file and extract IDAT data
+    void setIterations(int count)                   { iterations = (count > 0) ? count : 1; }
+
+    void run();                                     // run all cases and print the results
+    void printSelf() const;                         // print the results
+
+    // encode RGBA image with all compression levels and print the table
+    void runEncode(const unsigned char* rgba, unsigned w, unsigned h, const char* name);
+
+protected:
+
+private:
+    struct Result
+    {
+        std::string name;
+        double time;                                // average time per decode in ms
+        double mbps;                                // MB/s of raw scanline (or file) bytes
+        bool matched;                               // same output as the reference
+    };
+
+    // member functions
+    void runInflate(const char* name, const LodeZlib_DecompressSettings& settings, bool presized=false);
+    void runDecode(const char* name, const LodePNG_DecodeSettings& settings);
+    void runDecodeStream(const char* name);
+    void runDecodeInto(const char* name);
+    void runLoad();
+    void runAllocations();
+    void runChunks(const char* name);
+    double runEncodeCase(const char* name, const LodePNG_EncodeSettings& settings,
+                         const unsigned char* rgba, unsigned w, unsigned h, double baseTime=0,
+                         bool stream=false);
+    void runUnfilter(const char* name);
+    void runConvert(const char* name);
+    void addResult(const char* name, double time, size_t byteCount, bool matched);
+
+    // member vars
+    std::string fileName;
+    std::vector<unsigned char> file;                // entire PNG file
+    std::vector<unsigned char> idat;                // concatenated zlib stream of IDAT chunks
+    std::vector<unsigned char> scanlines;           // reference output of inflate
+    std::vector<unsigned char> pixels;              // reference output of decoder (RGBA)
+    std::vector<unsigned char> rawPixels;           // reference output of decoder without color conversion
+    unsigned width;
+    unsigned height;
+    unsigned bpp;                                   // bits per pixel of the PNG color type
+    bool interlaced;
+    int iterations;
+    std::vector<Result> results;
+};
+
+#endif
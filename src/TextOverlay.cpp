@@ -0,0 +1,296 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextOverlay.cpp
+// ===============
+// 2D text lines drawn with a glyph atlas texture instead of glutBitmapCharacter
+// - the GLUT bitmap font is rasterized once into an alpha texture by init()
+// - each line keeps its own vertex quads, which are rebuilt only if the text,
+//   position or color of the line is changed
+// - all lines are drawn with a single glDrawArrays() call
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-21
+// UPDATED: 2023-03-21
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <windows.h>    // include windows.h to avoid thousands of compile errors even though this class is not depending on Windows
+#endif
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include <iostream>
+#include <cstring>
+#include "TextOverlay.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+TextOverlay::TextOverlay() : texId(0), cellWidth(0), cellHeight(0), descent(0),
+                             columns(0), dirty(false), rebuildCount(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// rasterize the printable ASCII glyphs into an alpha texture
+// Each glyph is drawn with glutBitmapCharacter() to the back buffer at the
+// bottom-left corner of the window, then the pixels are copied to the texture.
+// Since the relative position of the glyph pixels from the raster position is
+// preserved, the textured quads are pixel-identical to glutBitmapCharacter().
+///////////////////////////////////////////////////////////////////////////////
+bool TextOverlay::init(void* font, int fontHeight)
+{
+    release();
+
+    // glyph cell with some space below baseline for descenders
+    descent = fontHeight / 4 + 1;
+    cellHeight = fontHeight + descent;
+    cellWidth = 1;
+    advances.clear();
+    for(int c = FIRST_CHAR; c <= LAST_CHAR; ++c)
+    {
+        int width = glutBitmapWidth(font, c);
+        advances.push_back(width);
+        if(cellWidth < width)
+            cellWidth = width;
+    }
+    columns = ATLAS_SIZE / cellWidth;
+    int rows = (LAST_CHAR - FIRST_CHAR + columns) / columns;
+    if(rows * cellHeight > ATLAS_SIZE)
+    {
+        std::cout << "[ERROR] The font is too large for the glyph atlas." << std::endl;
+        return false;
+    }
+
+    if(glutGet(GLUT_WINDOW_WIDTH) < ATLAS_SIZE || glutGet(GLUT_WINDOW_HEIGHT) < ATLAS_SIZE)
+    {
+        std::cout << "[ERROR] The window is too small to rasterize the glyph atlas." << std::endl;
+        return false;
+    }
+
+    // draw glyphs with pixel-exact orthogonal projection
+    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glViewport(0, 0, ATLAS_SIZE, ATLAS_SIZE);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, ATLAS_SIZE, 0, ATLAS_SIZE, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDrawBuffer(GL_BACK);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glColor4f(1, 1, 1, 1);
+
+    for(int c = FIRST_CHAR; c <= LAST_CHAR; ++c)
+    {
+        int index = c - FIRST_CHAR;
+        glRasterPos2i((index % columns) * cellWidth, (index / columns) * cellHeight + descent);
+        glutBitmapCharacter(font, c);
+    }
+
+    // copy the red channel of the glyphs to alpha texture
+    std::vector<unsigned char> pixels(ATLAS_SIZE * ATLAS_SIZE);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, ATLAS_SIZE, ATLAS_SIZE, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+
+    glGenTextures(1, &texId);
+    glBindTexture(GL_TEXTURE_2D, texId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_SIZE, ATLAS_SIZE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &pixels[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopClientAttrib();
+
+    // the quads of existing lines refer to the old atlas layout
+    for(size_t i = 0; i < lines.size(); ++i)
+        buildLine(lines[i]);
+    dirty = true;
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete the atlas texture
+///////////////////////////////////////////////////////////////////////////////
+void TextOverlay::release()
+{
+    if(texId)
+        glDeleteTextures(1, &texId);
+    texId = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// set the text, position and color of a line
+// The vertex quads of the line are rebuilt only if any of them is changed.
+///////////////////////////////////////////////////////////////////////////////
+void TextOverlay::setLine(int index, const char* text, int x, int y, const float color[4])
+{
+    if(index < 0 || !text)
+        return;
+
+    if(index >= (int)lines.size())
+    {
+        Line line;
+        line.x = line.y = 0;
+        memset(line.color, 0, sizeof(line.color));
+        lines.resize(index + 1, line);
+    }
+
+    Line& line = lines[index];
+    if(line.text == text && line.x == x && line.y == y &&
+       memcmp(line.color, color, sizeof(line.color)) == 0)
+        return;     // nothing changed
+
+    line.text = text;
+    line.x = x;
+    line.y = y;
+    memcpy(line.color, color, sizeof(line.color));
+    buildLine(line);
+    dirty = true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// remove the lines after the given count
+///////////////////////////////////////////////////////////////////////////////
+void TextOverlay::setLineCount(int count)
+{
+    if(count < 0)
+        count = 0;
+
+    if(count < (int)lines.size())
+    {
+        lines.resize(count);
+        dirty = true;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// draw all lines with a single draw call
+// The quads are modulated by the vertex colors and blended by the glyph alpha.
+///////////////////////////////////////////////////////////////////////////////
+void TextOverlay::draw()
+{
+    if(!texId)
+        return;
+
+    if(dirty)
+        buildBatch();
+
+    if(vertices.empty())
+        return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT | GL_POLYGON_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texId);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    int stride = 8 * sizeof(float);
+    glVertexPointer(2, GL_FLOAT, stride, &vertices[0]);
+    glTexCoordPointer(2, GL_FLOAT, stride, &vertices[2]);
+    glColorPointer(4, GL_FLOAT, stride, &vertices[4]);
+    glDrawArrays(GL_QUADS, 0, (GLsizei)getVertexCount());
+
+    glPopClientAttrib();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopAttrib();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// build the vertex quads of a line, 4 vertices per visible glyph
+///////////////////////////////////////////////////////////////////////////////
+void TextOverlay::buildLine(Line& line)
+{
+    line.vertices.clear();
+    ++rebuildCount;
+    if(columns == 0)
+        return;
+
+    const float invSize = 1.0f / ATLAS_SIZE;
+    const float* c = line.color;
+    float x = (float)line.x;
+    float y = (float)(line.y - descent);
+    for(size_t i = 0; i < line.text.size(); ++i)
+    {
+        int ch = (unsigned char)line.text[i];
+        if(ch < FIRST_CHAR || ch > LAST_CHAR)
+            continue;
+
+        int index = ch - FIRST_CHAR;
+        if(ch != ' ')
+        {
+            float s0 = (index % columns) * cellWidth * invSize;
+            float t0 = (index / columns) * cellHeight * invSize;
+            float s1 = s0 + cellWidth * invSize;
+            float t1 = t0 + cellHeight * invSize;
+            float x1 = x + cellWidth;
+            float y1 = y + cellHeight;
+            float quad[32] = {x,  y,  s0, t0, c[0], c[1], c[2], c[3],
+                              x1, y,  s1, t0, c[0], c[1], c[2], c[3],
+                              x1, y1, s1, t1, c[0], c[1], c[2], c[3],
+                              x,  y1, s0, t1, c[0], c[1], c[2], c[3]};
+            line.vertices.insert(line.vertices.end(), quad, quad + 32);
+        }
+        x += advances[index];
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// concatenate the quads of all lines into a single array
+///////////////////////////////////////////////////////////////////////////////
+void TextOverlay::buildBatch()
+{
+    vertices.clear();
+    for(size_t i = 0; i < lines.size(); ++i)
+        vertices.insert(vertices.end(), lines[i].vertices.begin(), lines[i].vertices.end());
+    dirty = false;
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextOverlay.h
+// =============
+// 2D text lines drawn with a glyph atlas texture instead of glutBitmapCharacter
+// - the GLUT bitmap font is rasterized once into an alpha texture by init()
+// - each line keeps its own vertex quads, which are rebuilt only if the text,
+//   position or color of the line is changed
+// - all lines are drawn with a single glDrawArrays() call
+//
+// usage:
+//  textOverlay.init(GLUT_BITMAP_8_BY_13, 13);  // in display callback, before glClear()
+//  ...
+//  textOverlay.setLine(0, "Hello", x, y, color);
+//  textOverlay.setLineCount(1);
+//  textOverlay.draw();                         // projection must be orthogonal
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-21
+// UPDATED: 2023-03-21
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+#include <string>
+#include <vector>
+
+class TextOverlay
+{
+public:
+    // ctor/dtor
+    TextOverlay();
+    ~TextOverlay() {}
+
+    // rasterize ASCII glyphs of a GLUT bitmap font into a texture
+    // It draws to the back buffer and reads it back, so call it before clearing
+    // the frame. The window must be at least as large as the atlas (128x128).
+    bool init(void* font, int fontHeight);
+    void release();                                 // delete the atlas texture
+    bool isReady() const                            { return texId != 0; }
+
+    // set the text of a line, the quads are rebuilt only if it is changed
+    // (x, y) is the baseline origin in window coords, same as glRasterPos2i()
+    void setLine(int index, const char* text, int x, int y, const float color[4]);
+    void setLineCount(int count);                   // remove the lines after count
+    int getLineCount() const                        { return (int)lines.size(); }
+
+    // draw all lines at once, the projection matrix must be orthogonal
+    void draw();
+
+    // stats
+    unsigned int getRebuildCount() const            { return rebuildCount; }  // # of line rebuilds
+    unsigned int getVertexCount() const             { return (unsigned int)vertices.size() / 8; }
+
+protected:
+
+private:
+    static const int FIRST_CHAR = 32;               // space
+    static const int LAST_CHAR = 126;               // ~
+    static const int ATLAS_SIZE = 128;              // width and height of atlas
+
+    struct Line
+    {
+        std::string text;
+        int x;
+        int y;
+        float color[4];
+        std::vector<float> vertices;                // interleaved x,y,s,t,r,g,b,a per vertex
+    };
+
+    // member functions
+    void buildLine(Line& line);
+    void buildBatch();
+
+    // member vars
+    unsigned int texId;                             // atlas texture
+    int cellWidth;                                  // size of a glyph cell in atlas
+    int cellHeight;
+    int descent;                                    // distance from cell bottom to baseline
+    int columns;                                    // # of glyphs per row in atlas
+    std::vector<int> advances;                      // horizontal advance of each glyph
+    std::vector<Line> lines;
+    std::vector<float> vertices;                    // all lines for a single draw call
+    bool dirty;                                     // need to rebuild the batch
+    unsigned int rebuildCount;
+};
+
+#endif
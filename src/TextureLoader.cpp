@@ -0,0 +1,474 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.cpp
+// =================
+// Asynchronous texture loader with a pool of decode threads
+// - PNG files are decoded in parallel with Image::Png on the worker threads,
+//   in the color type of the file (grey, grey+alpha, RGB, RGBA or palette), so
+//   the smallest matching GL format is uploaded
+// - the decoded images are uploaded to OpenGL textures by update(), which must
+//   be called on the render thread (the thread of the GL context)
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-24
+// UPDATED: 2023-03-28
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <windows.h>    // include windows.h to avoid thousands of compile errors even though this class is not depending on Windows
+#endif
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include <iostream>
+#include <vector>
+#include <cstring>                      // for memcpy()
+#include <new>                          // for std::bad_alloc
+#include "glExtension.h"
+#include "TextureLoader.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+// start the worker threads, they wait until a file is added
+///////////////////////////////////////////////////////////////////////////////
+TextureLoader::TextureLoader(int threadCount) : stopping(false), loadedCount(0), loadTime(0)
+{
+    if(threadCount <= 0)
+        threadCount = (int)std::thread::hardware_concurrency();
+    if(threadCount <= 0)
+        threadCount = 1;    // unknown # of CPUs
+
+    for(int i = 0; i < threadCount; ++i)
+        threads.push_back(std::thread(&TextureLoader::decodeLoop, this));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// dtor
+// the queued files are not decoded, and the images not uploaded yet are freed
+///////////////////////////////////////////////////////////////////////////////
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    queueCondition.notify_all();
+    for(size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    for(size_t i = 0; i < textures.size(); ++i)
+        delete textures[i].png;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// queue a PNG file to decode on a worker thread
+///////////////////////////////////////////////////////////////////////////////
+int TextureLoader::add(const char* fileName, bool wrap)
+{
+    if(getPendingCount() == 0)
+        timer.start();      // a new batch
+
+    Texture texture;
+    texture.fileName = fileName ? fileName : "";
+    texture.wrap = wrap;
+    texture.png = 0;
+    texture.id = 0;
+    texture.decoded = texture.loaded = texture.failed = false;
+
+    int handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handle = (int)textures.size();
+        textures.push_back(texture);
+        queue.push_back(handle);
+    }
+    queueCondition.notify_one();
+    return handle;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// upload the decoded images that are not uploaded yet
+///////////////////////////////////////////////////////////////////////////////
+int TextureLoader::update(int maxCount)
+{
+    if(getPendingCount() == 0)
+        return 0;
+
+    return uploadDecoded(maxCount);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// wait until all queued files are decoded and upload them
+///////////////////////////////////////////////////////////////////////////////
+void TextureLoader::finish()
+{
+    while(getPendingCount() > 0)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // an image decoded but not uploaded yet, or wait for next decode
+            bool ready = false;
+            for(size_t i = 0; i < textures.size() && !ready; ++i)
+                ready = textures[i].decoded && !textures[i].loaded;
+            if(!ready)
+                decodeCondition.wait(lock);
+        }
+        uploadDecoded(0);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete all textures
+///////////////////////////////////////////////////////////////////////////////
+void TextureLoader::release()
+{
+    for(size_t i = 0; i < textures.size(); ++i)
+    {
+        if(textures[i].id)
+        {
+            glDeleteTextures(1, &textures[i].id);
+            textures[i].id = 0;
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// getters of texture state
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureLoader::getTexture(int handle) const
+{
+    if(handle < 0 || handle >= (int)textures.size())
+        return 0;
+    return textures[handle].id;
+}
+
+bool TextureLoader::isLoaded(int handle) const
+{
+    if(handle < 0 || handle >= (int)textures.size())
+        return false;
+    return textures[handle].loaded;
+}
+
+bool TextureLoader::isFailed(int handle) const
+{
+    if(handle < 0 || handle >= (int)textures.size())
+        return false;
+    return textures[handle].failed;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// take the decoded images out of the list under the lock, then upload them
+// without the lock, so the workers are not blocked by glTexImage2D()
+///////////////////////////////////////////////////////////////////////////////
+int TextureLoader::uploadDecoded(int maxCount)
+{
+    std::vector<int> handles;
+    std::vector<Image::Png*> pngs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < textures.size(); ++i)
+        {
+            if(maxCount > 0 && (int)handles.size() >= maxCount)
+                break;
+            Texture& texture = textures[i];
+            if(texture.decoded && !texture.loaded)
+            {
+                handles.push_back((int)i);
+                pngs.push_back(texture.png);
+                texture.png = 0;
+                texture.loaded = true;  // only this thread reads it after decoded
+            }
+        }
+    }
+
+    for(size_t i = 0; i < handles.size(); ++i)
+    {
+        Texture& texture = textures[handles[i]];
+        if(pngs[i])
+            texture.id = createTexture(*pngs[i], texture.wrap);
+        if(!texture.id)
+        {
+            texture.failed = true;
+            std::cout << "[ERROR] Failed to load texture: " << texture.fileName << std::endl;
+        }
+        delete pngs[i];
+        ++loadedCount;
+    }
+
+    if(!handles.empty() && getPendingCount() == 0)
+        loadTime = timer.getElapsedTimeInMilliSec();
+
+    return (int)handles.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// main function of the worker threads
+// The file is decoded without the lock, so all threads decode at the same time.
+///////////////////////////////////////////////////////////////////////////////
+void TextureLoader::decodeLoop()
+{
+    while(true)
+    {
+        int handle;
+        std::string fileName;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!stopping && queue.empty())
+                queueCondition.wait(lock);
+            if(stopping)
+                return;
+            handle = queue.front();
+            queue.pop_front();
+            fileName = textures[handle].fileName;
+        }
+
+        Image::Png* png = new Image::Png();
+        png->setNativeColor(true);
+        if(!png->read(fileName.c_str()))
+        {
+            std::cout << "[ERROR] " << fileName << ": " << png->getError() << std::endl;
+            delete png;
+            png = 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            textures[handle].png = png;
+            textures[handle].decoded = true;
+        }
+        decodeCondition.notify_all();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create a texture with mipmaps from a decoded image
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureLoader::createTexture(const Image::Png& png, bool wrap)
+{
+    return createTexture(png.getWidth(), png.getHeight(), png.getBitCount(), png.getData(), wrap,
+                         png.getPalette(), png.getPaletteSize());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load a texture from a PNG file without threads
+// Image::Png reads the header first to size the destination, then decodes the
+// rows into it. With a pixel unpack buffer, the rows are written into the
+// mapped buffer, and the driver uploads from there.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureLoader::loadTexture(const char* fileName, bool wrap)
+{
+    Image::Png png;
+    png.setNativeColor(true);       // e.g. 8-bit for a greyscale file
+    if(!png.readHeader(fileName))
+    {
+        std::cout << "[ERROR] " << (fileName ? fileName : "") << ": " << png.getError() << std::endl;
+        return 0;
+    }
+
+    int width = png.getWidth();
+    int height = png.getHeight();
+    int bpp = png.getBitCount();
+    std::size_t rowSize = (std::size_t)width * bpp / 8;     // packed rows
+
+    // the size comes from the file header, so check it before allocating
+    std::vector<unsigned char> pixels;
+    if(width <= 0 || height <= 0 || rowSize > pixels.max_size() / height)
+    {
+        std::cout << "[ERROR] " << fileName << ": invalid image size "
+                  << png.getWidth() << "x" << png.getHeight() << "." << std::endl;
+        return 0;
+    }
+
+    glExtension& ext = glExtension::getInstance();
+    if(ext.hasPixelBuffer() && ext.hasMipmapGeneration())
+    {
+        GLuint pbo;
+        pglGenBuffers(1, &pbo);
+        pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        pglBufferData(GL_PIXEL_UNPACK_BUFFER, (std::ptrdiff_t)(rowSize * height), 0, GL_STREAM_DRAW);
+        void* dst = pglMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        bool decoded = dst && png.decodeInto(dst, rowSize);
+        if(dst && !pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+            decoded = false;    // the buffer was lost, e.g. by a mode switch
+
+        // the data of glTexImage2D() is the offset in the bound buffer
+        GLuint texture = 0;
+        if(decoded)
+            texture = createTexture(width, height, bpp, 0, wrap, png.getPalette(), png.getPaletteSize());
+        else
+            std::cout << "[ERROR] " << fileName << ": " << png.getError() << std::endl;
+        pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pglDeleteBuffers(1, &pbo);
+        return texture;
+    }
+
+    try
+    {
+        pixels.resize(rowSize * height);
+    }
+    catch(const std::bad_alloc&)
+    {
+        std::cout << "[ERROR] " << fileName << ": not enough memory for the image." << std::endl;
+        return 0;
+    }
+    if(!png.decodeInto(&pixels[0], rowSize))
+    {
+        std::cout << "[ERROR] " << fileName << ": " << png.getError() << std::endl;
+        return 0;
+    }
+    return createTexture(width, height, bpp, &pixels[0], wrap, png.getPalette(), png.getPaletteSize());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create a texture with mipmaps
+// The image is 8-bit (luminance or palette indices), 16-bit (luminance+alpha),
+// 24-bit (RGB) or 32-bit (RGBA), with packed rows.
+// The palette indices are looked up in the pixel maps while the GL transfers
+// them, so the texture is RGB(A) but the image in memory stays 8-bit.
+// The mipmaps are generated by the GL from the uploaded level if it supports
+// GL_GENERATE_MIPMAP, otherwise by GLU, which copies the image again.
+// Returns 0 if the format is not supported.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureLoader::createTexture(int width, int height, int bpp, const void* data, bool wrap,
+                                          const unsigned char* palette, int paletteSize)
+{
+    GLenum type = GL_UNSIGNED_BYTE;    // only allow 8-bit per channel
+    bool mipmapGeneration = glExtension::getInstance().hasMipmapGeneration();
+
+    // We assume the image is 8-bit, 16-bit, 24-bit or 32-bit
+    GLenum format;
+    GLint components;
+    GLint internalFormat;
+    std::vector<unsigned char> expanded;   // palette colors for GLU
+    if(bpp == 8 && paletteSize > 0)
+    {
+        bool opaque = true;
+        for(int i = 0; i < paletteSize; ++i)
+            opaque = opaque && palette[i * 4 + 3] == 255;
+        internalFormat = opaque ? GL_RGB : GL_RGBA;
+
+        if(mipmapGeneration)
+        {
+            // map index i to the color i, the size of the maps is a power of 2
+            GLfloat maps[4][256] = {{0}};
+            for(int i = 0; i < paletteSize && i < 256; ++i)
+            {
+                for(int c = 0; c < 4; ++c)
+                    maps[c][i] = palette[i * 4 + c] / 255.0f;
+            }
+            glPixelMapfv(GL_PIXEL_MAP_I_TO_R, 256, maps[0]);
+            glPixelMapfv(GL_PIXEL_MAP_I_TO_G, 256, maps[1]);
+            glPixelMapfv(GL_PIXEL_MAP_I_TO_B, 256, maps[2]);
+            glPixelMapfv(GL_PIXEL_MAP_I_TO_A, 256, maps[3]);
+            format = GL_COLOR_INDEX;
+            components = 1;
+        }
+        else
+        {
+            // GLU would average the indices of the mipmaps, so give it colors
+            const unsigned char* indices = (const unsigned char*)data;
+            expanded.resize((std::size_t)width * height * 4);
+            for(std::size_t i = 0; i < (std::size_t)width * height; ++i)
+            {
+                int index = indices[i] < paletteSize ? indices[i] : 0;
+                memcpy(&expanded[i * 4], &palette[index * 4], 4);
+            }
+            data = &expanded[0];
+            format = GL_RGBA;
+            components = 4;
+        }
+    }
+    else if(bpp == 8)
+    {
+        format = GL_LUMINANCE;
+        components = 1;
+    }
+    else if(bpp == 16)
+    {
+        format = GL_LUMINANCE_ALPHA;
+        components = 2;
+    }
+    else if(bpp == 24)
+    {
+        format = GL_RGB;
+        components = 3;
+    }
+    else if(bpp == 32)
+    {
+        format = GL_RGBA;
+        components = 4;
+    }
+    else
+        return 0;               // NOT supported, exit
+    if(format != GL_COLOR_INDEX && expanded.empty())
+        internalFormat = format;
+
+    // gen texture ID
+    GLuint texture;
+    glGenTextures(1, &texture);
+
+    // set active texture and configure it
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // select modulate to mix texture with color for shading
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // if wrap is true, the texture wraps over at the edges (repeat)
+    //       ... false, the texture ends at the edges (clamp)
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap ? GL_REPEAT : GL_CLAMP);
+
+    // rows of 8, 16 or 24-bit images may not be 4-byte aligned
+    bool packed = (width * components) % 4 != 0;
+    if(packed)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // copy texture data and build mipmaps
+    if(mipmapGeneration)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+        gluBuild2DMipmaps(GL_TEXTURE_2D, components, width, height, format, type, data);
+    }
+
+    if(packed)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
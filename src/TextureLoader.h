@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.h
+// ===============
+// Asynchronous texture loader with a pool of decode threads
+// - PNG files are decoded in parallel with Image::Png on the worker threads,
+//   in the color type of the file (grey, grey+alpha, RGB, RGBA or palette), so
+//   the smallest matching GL format is uploaded
+// - the decoded images are uploaded to OpenGL textures by update(), which must
+//   be called on the render thread (the thread of the GL context), e.g. at the
+//   beginning of the display callback
+// - each texture is referred by the handle returned by add(), and its texture
+//   ID is 0 until the image is uploaded
+// - the time from the first add() to the last upload is measured
+// - loadTexture() loads a texture synchronously, decoding the PNG straight into
+//   a pixel unpack buffer if the GL supports it
+//
+// usage:
+//  TextureLoader loader;           // one thread per CPU
+//  int handle = loader.add("grid512.png");
+//  ...
+//  loader.update();                // in display callback, upload decoded ones
+//  GLuint id = loader.getTexture(handle);  // 0 if not loaded yet
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-24
+// UPDATED: 2023-03-28
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Png.h"
+#include "Timer.h"
+
+class TextureLoader
+{
+public:
+    // ctor/dtor
+    TextureLoader(int threadCount=0);               // 0 means one thread per CPU
+    ~TextureLoader();                               // stop threads, textures are not deleted
+
+    // queue a PNG file to decode and return the handle of the texture
+    // if wrap is true, the texture repeats at the edges, otherwise clamps
+    int add(const char* fileName, bool wrap=true);
+
+    // upload the decoded images to textures, at most maxCount if it is > 0
+    // It must be called on the thread of the GL context. Returns # of uploads.
+    int update(int maxCount=0);
+    void finish();                                  // wait and upload all queued textures
+    void release();                                 // delete all textures
+
+    // state of a texture
+    unsigned int getTexture(int handle) const;      // texture ID, 0 if not loaded yet
+    bool isLoaded(int handle) const;                // uploaded, or failed to decode
+    bool isFailed(int handle) const;
+    const std::string& getFileName(int handle) const { return textures[handle].fileName; }
+
+    // stats
+    int getThreadCount() const                      { return (int)threads.size(); }
+    int getTextureCount() const                     { return (int)textures.size(); }
+    int getLoadedCount() const                      { return loadedCount; }
+    int getPendingCount() const                     { return (int)textures.size() - loadedCount; }
+    double getLoadTime() const                      { return loadTime; }    // ms from the first add() to the last upload
+
+    // create a texture with mipmaps from a decoded image, on the GL thread
+    static unsigned int createTexture(const Image::Png& png, bool wrap);
+
+    // load a texture synchronously without threads, on the GL thread
+    // The PNG is decoded into a mapped pixel unpack buffer (GL 2.1), or into a
+    // temporary buffer, so the image is not copied from Image::Png first.
+    static unsigned int loadTexture(const char* fileName, bool wrap);
+
+protected:
+
+private:
+    struct Texture
+    {
+        std::string fileName;
+        bool wrap;
+        Image::Png* png;                            // decoded image, deleted after upload
+        unsigned int id;                            // texture ID
+        bool decoded;
+        bool loaded;
+        bool failed;
+    };
+
+    // member functions
+    void decodeLoop();                              // main function of worker threads
+    int uploadDecoded(int maxCount);
+
+    // create a texture from 8, 16, 24 or 32-bit pixels, or 8-bit palette
+    // indices, data is the offset in the pixel unpack buffer if one is bound
+    static unsigned int createTexture(int width, int height, int bpp, const void* data, bool wrap,
+                                      const unsigned char* palette=0, int paletteSize=0);
+
+    // member vars
+    std::vector<std::thread> threads;
+    std::deque<Texture> textures;                   // deque keeps elements in place while growing
+    std::deque<int> queue;                          // handles to decode
+    std::mutex mutex;                               // guards queue, textures[].decoded and .png
+    std::condition_variable queueCondition;         // notified if queue is changed or threads stop
+    std::condition_variable decodeCondition;        // notified if a decode is done
+    bool stopping;
+    int loadedCount;
+    Timer timer;
+    double loadTime;
+};
+
+#endif
@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+// Timer.cpp
+// =========
+// High resolution timer using the monotonic clock of the C++ standard library.
+// It measures the elapsed time between start() and stop() with 1 micro-second
+// accuracy. If stop() is not called yet, it returns the elapsed time until now.
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-20
+// UPDATED: 2023-03-20
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Timer.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+Timer::Timer() : stopped(false)
+{
+    startCount = endCount = Clock::now();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// start timer.
+// startCount will be set at this point.
+///////////////////////////////////////////////////////////////////////////////
+void Timer::start()
+{
+    stopped = false; // reset stop flag
+    startCount = Clock::now();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// stop the timer.
+// endCount will be set at this point.
+///////////////////////////////////////////////////////////////////////////////
+void Timer::stop()
+{
+    stopped = true; // set timer stopped flag
+    endCount = Clock::now();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compute elapsed time in micro-second resolution.
+// other getElapsedTime will call this first, then convert to correspond resolution.
+///////////////////////////////////////////////////////////////////////////////
+double Timer::getElapsedTimeInMicroSec()
+{
+    if(!stopped)
+        endCount = Clock::now();
+
+    return std::chrono::duration<double, std::micro>(endCount - startCount).count();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// divide elapsedTimeInMicroSec by 1000
+///////////////////////////////////////////////////////////////////////////////
+double Timer::getElapsedTimeInMilliSec()
+{
+    return this->getElapsedTimeInMicroSec() * 0.001;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// divide elapsedTimeInMicroSec by 1000000
+///////////////////////////////////////////////////////////////////////////////
+double Timer::getElapsedTimeInSec()
+{
+    return this->getElapsedTimeInMicroSec() * 0.000001;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// same as getElapsedTimeInSec()
+///////////////////////////////////////////////////////////////////////////////
+double Timer::getElapsedTime()
+{
+    return this->getElapsedTimeInSec();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the current time of the monotonic clock in micro-second
+// it is useful to timestamp events without creating a Timer object
+///////////////////////////////////////////////////////////////////////////////
+double Timer::getTimeInMicroSec()
+{
+    return std::chrono::duration<double, std::micro>(Clock::now().time_since_epoch()).count();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the CPU time (user + kernel) consumed by this process in micro-second
+// CPU usage = delta of CPU time / delta of wall-clock time
+///////////////////////////////////////////////////////////////////////////////
+double Timer::getCpuTimeInMicroSec()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if(!::GetProcessTimes(::GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+
+    // FILETIME is in 100 nano-second unit
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (kernel.QuadPart + user.QuadPart) * 0.1;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+#endif
+}
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+// Timer.h
+// =======
+// High resolution timer using the monotonic clock of the C++ standard library.
+// It measures the elapsed time between start() and stop() with 1 micro-second
+// accuracy. If stop() is not called yet, it returns the elapsed time until now.
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-20
+// UPDATED: 2023-03-20
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+class Timer
+{
+public:
+    Timer();                                    // default constructor
+    ~Timer() {}                                 // default destructor
+
+    void   start();                             // start timer
+    void   stop();                              // stop the timer
+    double getElapsedTime();                    // get elapsed time in second
+    double getElapsedTimeInSec();               // get elapsed time in second (same as getElapsedTime)
+    double getElapsedTimeInMilliSec();          // get elapsed time in milli-second
+    double getElapsedTimeInMicroSec();          // get elapsed time in micro-second
+
+    static double getTimeInMicroSec();          // current time from an arbitrary epoch
+    static double getCpuTimeInMicroSec();       // user + system CPU time used by this process
+
+
+protected:
+
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point startCount;               // start time point
+    Clock::time_point endCount;                 // end time point
+    bool stopped;                               // stop flag
+};
+
+#endif // TIMER_H
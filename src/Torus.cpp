@@ -41,7 +41,7 @@ const int MIN_SIDE_COUNT  = 3;
 ///////////////////////////////////////////////////////////////////////////////
 // ctor
 ///////////////////////////////////////////////////////////////////////////////
-Torus::Torus(float majorR, float minorR, int sectors, int sides, bool smooth, int up) : interleavedStride(32)
+Torus::Torus(float majorR, float minorR, int sectors, int sides, bool smooth, int up) : revision(0), interleavedStride(32)
 {
     set(majorR, minorR, sectors, sides, smooth, up);
 }
@@ -72,6 +72,7 @@ void Torus::set(float majorR, float minorR, int sectors, int sides, bool smooth,
         buildVerticesSmooth();
     else
         buildVerticesFlat();
+    ++revision;
 }
 
 void Torus::setMajorRadius(float majorRadius)
@@ -108,6 +109,7 @@ void Torus::setSmooth(bool smooth)
         buildVerticesSmooth();
     else
         buildVerticesFlat();
+    ++revision;
 }
 
 void Torus::setUpAxis(int up)
@@ -117,6 +119,7 @@ void Torus::setUpAxis(int up)
 
     changeUpAxis(this->upAxis, up);
     this->upAxis = up;
+    ++revision;
 }
 
 
@@ -149,6 +152,7 @@ void Torus::reverseNormals()
         indices[i]   = indices[i+2];
         indices[i+2] = tmp;
     }
+    ++revision;
 }
 
 
@@ -33,6 +33,7 @@ public:
     int getSectorCount() const              { return sectorCount; }
     int getSideCount() const                { return sideCount; }
     int getUpAxis() const                   { return upAxis; }
+    unsigned int getRevision() const        { return revision; }    // increased whenever geometry is modified
     void set(float majorRadius, float minorRadius, int sectorCount, int sideCount, bool smooth=true, int up=3);
     void setMajorRadius(float radius);
     void setMinorRadius(float radius);
@@ -98,6 +99,7 @@ private:
     int sideCount;                          // # of sides
     bool smooth;
     int upAxis;                             // +X=1, +Y=2, +z=3 (default)
+    unsigned int revision;                  // modification counter for cached draw commands
     std::vector<float> vertices;
     std::vector<float> normals;
     std::vector<float> texCoords;
@@ -0,0 +1,315 @@
+///////////////////////////////////////////////////////////////////////////////
+// glExtension.cpp
+// ===============
+// OpenGL extension and core function loader for the functions not exported
+// by the OpenGL 1.1 header. Call glExtension::getInstance() after an OpenGL
+// rendering context is created, then check the feature flags before using
+// the function pointers (prefixed with "p", e.g. pglGenQueries).
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-20
+// UPDATED: 2023-03-27
+///////////////////////////////////////////////////////////////////////////////
+
+#include "glExtension.h"
+
+#ifdef __APPLE__
+#include <dlfcn.h>
+#include <OpenGL/OpenGL.h>  // for CGLSetParameter()
+#else
+#include <GL/freeglut.h>    // for glutGetProcAddress()
+#endif
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <GL/glx.h>         // for glXGetCurrentDisplay()
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+
+
+// function pointers
+glGenQueriesProc            pglGenQueries = 0;
+glDeleteQueriesProc         pglDeleteQueries = 0;
+glBeginQueryProc            pglBeginQuery = 0;
+glEndQueryProc              pglEndQuery = 0;
+glGetQueryObjectivProc      pglGetQueryObjectiv = 0;
+glGetQueryObjectui64vProc   pglGetQueryObjectui64v = 0;
+glGenBuffersProc                pglGenBuffers = 0;
+glDeleteBuffersProc             pglDeleteBuffers = 0;
+glBindBufferProc                pglBindBuffer = 0;
+glBufferDataProc                pglBufferData = 0;
+glBufferSubDataProc             pglBufferSubData = 0;
+glBindBufferBaseProc            pglBindBufferBase = 0;
+glMapBufferProc                 pglMapBuffer = 0;
+glUnmapBufferProc               pglUnmapBuffer = 0;
+glCreateShaderProc              pglCreateShader = 0;
+glDeleteShaderProc              pglDeleteShader = 0;
+glShaderSourceProc              pglShaderSource = 0;
+glCompileShaderProc             pglCompileShader = 0;
+glGetShaderivProc               pglGetShaderiv = 0;
+glGetShaderInfoLogProc          pglGetShaderInfoLog = 0;
+glCreateProgramProc             pglCreateProgram = 0;
+glDeleteProgramProc             pglDeleteProgram = 0;
+glAttachShaderProc              pglAttachShader = 0;
+glBindAttribLocationProc        pglBindAttribLocation = 0;
+glLinkProgramProc               pglLinkProgram = 0;
+glGetProgramivProc              pglGetProgramiv = 0;
+glGetProgramInfoLogProc         pglGetProgramInfoLog = 0;
+glUseProgramProc                pglUseProgram = 0;
+glGetUniformLocationProc        pglGetUniformLocation = 0;
+glUniform1iProc                 pglUniform1i = 0;
+glUniformMatrix4fvProc          pglUniformMatrix4fv = 0;
+glGetUniformBlockIndexProc      pglGetUniformBlockIndex = 0;
+glUniformBlockBindingProc       pglUniformBlockBinding = 0;
+glEnableVertexAttribArrayProc   pglEnableVertexAttribArray = 0;
+glDisableVertexAttribArrayProc  pglDisableVertexAttribArray = 0;
+glVertexAttribPointerProc       pglVertexAttribPointer = 0;
+glVertexAttribDivisorProc       pglVertexAttribDivisor = 0;
+glDrawElementsInstancedProc     pglDrawElementsInstanced = 0;
+
+// swap interval functions of window systems, only one of them is used
+#ifdef _WIN32
+typedef BOOL (APIENTRY * wglSwapIntervalEXTProc)(int interval);
+static wglSwapIntervalEXTProc pwglSwapIntervalEXT = 0;
+#elif !defined(__APPLE__)
+typedef void (* glXSwapIntervalEXTProc)(Display* dpy, GLXDrawable drawable, int interval);
+typedef int (* glXSwapIntervalMESAProc)(unsigned int interval);
+static glXSwapIntervalEXTProc pglXSwapIntervalEXT = 0;
+static glXSwapIntervalMESAProc pglXSwapIntervalMESA = 0;
+#endif
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// get the address of an OpenGL function with the platform specific way
+///////////////////////////////////////////////////////////////////////////////
+static void* getProcAddress(const char* name)
+{
+#ifdef __APPLE__
+    return dlsym(RTLD_DEFAULT, name);
+#else
+    return (void*)glutGetProcAddress(name);
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the singleton instance
+///////////////////////////////////////////////////////////////////////////////
+glExtension& glExtension::getInstance()
+{
+    static glExtension self;
+    return self;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+glExtension::glExtension() : majorVersion(1), minorVersion(0), timerQuery(false),
+                             swapControl(false), shaderPipeline(false), pixelBuffer(false),
+                             mipmapGeneration(false)
+{
+    getExtensionStrings();
+    getFunctionPointers();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// check if the extension is supported
+///////////////////////////////////////////////////////////////////////////////
+bool glExtension::isSupported(const std::string& ext) const
+{
+    return std::binary_search(extensions.begin(), extensions.end(), ext);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compare the version of current OpenGL context
+///////////////////////////////////////////////////////////////////////////////
+bool glExtension::isVersionAtLeast(int major, int minor) const
+{
+    return (majorVersion > major) || (majorVersion == major && minorVersion >= minor);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print itself for debug
+///////////////////////////////////////////////////////////////////////////////
+void glExtension::printSelf() const
+{
+    std::cout << "===== glExtension =====\n"
+              << "OpenGL Version: " << majorVersion << "." << minorVersion << "\n"
+              << "Extension Count: " << extensions.size() << "\n"
+              << "Timer Query: " << (timerQuery ? "yes" : "no") << "\n"
+              << "Swap Control: " << (swapControl ? "yes" : "no") << "\n"
+              << "Shader Pipeline: " << (shaderPipeline ? "yes" : "no") << "\n"
+              << "Pixel Buffer: " << (pixelBuffer ? "yes" : "no") << "\n"
+              << "Mipmap Generation: " << (mipmapGeneration ? "yes" : "no") << "\n"
+              << std::endl;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// get the version and the list of extensions from the current context
+///////////////////////////////////////////////////////////////////////////////
+void glExtension::getExtensionStrings()
+{
+    const char* str = (const char*)glGetString(GL_VERSION);
+    if(str)
+        sscanf(str, "%d.%d", &majorVersion, &minorVersion);
+
+    str = (const char*)glGetString(GL_EXTENSIONS);
+    if(!str)
+        return;
+
+    // split the string by white spaces, then sort it for binary search
+    std::stringstream ss(str);
+    std::string ext;
+    while(ss >> ext)
+        extensions.push_back(ext);
+    std::sort(extensions.begin(), extensions.end());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// get the function pointers and set the feature flags
+///////////////////////////////////////////////////////////////////////////////
+void glExtension::getFunctionPointers()
+{
+    // timer query
+    if(isVersionAtLeast(3, 3) || isSupported("GL_ARB_timer_query"))
+    {
+        pglGenQueries = (glGenQueriesProc)getProcAddress("glGenQueries");
+        pglDeleteQueries = (glDeleteQueriesProc)getProcAddress("glDeleteQueries");
+        pglBeginQuery = (glBeginQueryProc)getProcAddress("glBeginQuery");
+        pglEndQuery = (glEndQueryProc)getProcAddress("glEndQuery");
+        pglGetQueryObjectiv = (glGetQueryObjectivProc)getProcAddress("glGetQueryObjectiv");
+        pglGetQueryObjectui64v = (glGetQueryObjectui64vProc)getProcAddress("glGetQueryObjectui64v");
+    }
+    else if(isSupported("GL_EXT_timer_query"))
+    {
+        pglGenQueries = (glGenQueriesProc)getProcAddress("glGenQueries");
+        pglDeleteQueries = (glDeleteQueriesProc)getProcAddress("glDeleteQueries");
+        pglBeginQuery = (glBeginQueryProc)getProcAddress("glBeginQuery");
+        pglEndQuery = (glEndQueryProc)getProcAddress("glEndQuery");
+        pglGetQueryObjectiv = (glGetQueryObjectivProc)getProcAddress("glGetQueryObjectiv");
+        pglGetQueryObjectui64v = (glGetQueryObjectui64vProc)getProcAddress("glGetQueryObjectui64vEXT");
+    }
+    timerQuery = pglGenQueries && pglDeleteQueries && pglBeginQuery && pglEndQuery &&
+                 pglGetQueryObjectiv && pglGetQueryObjectui64v;
+
+    // GLSL with uniform buffer and instanced arrays (GL 3.3)
+    if(isVersionAtLeast(3, 3))
+    {
+        pglGenBuffers = (glGenBuffersProc)getProcAddress("glGenBuffers");
+        pglDeleteBuffers = (glDeleteBuffersProc)getProcAddress("glDeleteBuffers");
+        pglBindBuffer = (glBindBufferProc)getProcAddress("glBindBuffer");
+        pglBufferData = (glBufferDataProc)getProcAddress("glBufferData");
+        pglBufferSubData = (glBufferSubDataProc)getProcAddress("glBufferSubData");
+        pglBindBufferBase = (glBindBufferBaseProc)getProcAddress("glBindBufferBase");
+        pglCreateShader = (glCreateShaderProc)getProcAddress("glCreateShader");
+        pglDeleteShader = (glDeleteShaderProc)getProcAddress("glDeleteShader");
+        pglShaderSource = (glShaderSourceProc)getProcAddress("glShaderSource");
+        pglCompileShader = (glCompileShaderProc)getProcAddress("glCompileShader");
+        pglGetShaderiv = (glGetShaderivProc)getProcAddress("glGetShaderiv");
+        pglGetShaderInfoLog = (glGetShaderInfoLogProc)getProcAddress("glGetShaderInfoLog");
+        pglCreateProgram = (glCreateProgramProc)getProcAddress("glCreateProgram");
+        pglDeleteProgram = (glDeleteProgramProc)getProcAddress("glDeleteProgram");
+        pglAttachShader = (glAttachShaderProc)getProcAddress("glAttachShader");
+        pglBindAttribLocation = (glBindAttribLocationProc)getProcAddress("glBindAttribLocation");
+        pglLinkProgram = (glLinkProgramProc)getProcAddress("glLinkProgram");
+        pglGetProgramiv = (glGetProgramivProc)getProcAddress("glGetProgramiv");
+        pglGetProgramInfoLog = (glGetProgramInfoLogProc)getProcAddress("glGetProgramInfoLog");
+        pglUseProgram = (glUseProgramProc)getProcAddress("glUseProgram");
+        pglGetUniformLocation = (glGetUniformLocationProc)getProcAddress("glGetUniformLocation");
+        pglUniform1i = (glUniform1iProc)getProcAddress("glUniform1i");
+        pglUniformMatrix4fv = (glUniformMatrix4fvProc)getProcAddress("glUniformMatrix4fv");
+        pglGetUniformBlockIndex = (glGetUniformBlockIndexProc)getProcAddress("glGetUniformBlockIndex");
+        pglUniformBlockBinding = (glUniformBlockBindingProc)getProcAddress("glUniformBlockBinding");
+        pglEnableVertexAttribArray = (glEnableVertexAttribArrayProc)getProcAddress("glEnableVertexAttribArray");
+        pglDisableVertexAttribArray = (glDisableVertexAttribArrayProc)getProcAddress("glDisableVertexAttribArray");
+        pglVertexAttribPointer = (glVertexAttribPointerProc)getProcAddress("glVertexAttribPointer");
+        pglVertexAttribDivisor = (glVertexAttribDivisorProc)getProcAddress("glVertexAttribDivisor");
+        pglDrawElementsInstanced = (glDrawElementsInstancedProc)getProcAddress("glDrawElementsInstanced");
+        shaderPipeline = pglGenBuffers && pglDeleteBuffers && pglBindBuffer && pglBufferData &&
+                         pglBufferSubData && pglBindBufferBase && pglCreateShader && pglDeleteShader &&
+                         pglShaderSource && pglCompileShader && pglGetShaderiv && pglGetShaderInfoLog &&
+                         pglCreateProgram && pglDeleteProgram && pglAttachShader && pglBindAttribLocation &&
+                         pglLinkProgram && pglGetProgramiv && pglGetProgramInfoLog && pglUseProgram &&
+                         pglGetUniformLocation && pglUniform1i && pglUniformMatrix4fv && pglGetUniformBlockIndex &&
+                         pglUniformBlockBinding && pglEnableVertexAttribArray && pglDisableVertexAttribArray && pglVertexAttribPointer &&
+                         pglVertexAttribDivisor && pglDrawElementsInstanced;
+    }
+
+    // pixel unpack buffer (GL 2.1, GL_ARB_pixel_buffer_object) to decode images into mapped buffers
+    if(isVersionAtLeast(2, 1) || isSupported("GL_ARB_pixel_buffer_object"))
+    {
+        pglGenBuffers = (glGenBuffersProc)getProcAddress("glGenBuffers");
+        pglDeleteBuffers = (glDeleteBuffersProc)getProcAddress("glDeleteBuffers");
+        pglBindBuffer = (glBindBufferProc)getProcAddress("glBindBuffer");
+        pglBufferData = (glBufferDataProc)getProcAddress("glBufferData");
+        pglMapBuffer = (glMapBufferProc)getProcAddress("glMapBuffer");
+        pglUnmapBuffer = (glUnmapBufferProc)getProcAddress("glUnmapBuffer");
+        pixelBuffer = pglGenBuffers && pglDeleteBuffers && pglBindBuffer && pglBufferData &&
+                      pglMapBuffer && pglUnmapBuffer;
+    }
+
+    // automatic mipmaps of texture uploads (GL 1.4, GL_SGIS_generate_mipmap), no function
+    mipmapGeneration = isVersionAtLeast(1, 4) || isSupported("GL_SGIS_generate_mipmap");
+
+    // swap control (vsync on/off)
+#ifdef _WIN32
+    pwglSwapIntervalEXT = (wglSwapIntervalEXTProc)getProcAddress("wglSwapIntervalEXT");
+    swapControl = (pwglSwapIntervalEXT != 0);
+#elif defined(__APPLE__)
+    swapControl = true;     // CGL is always available
+#else
+    pglXSwapIntervalEXT = (glXSwapIntervalEXTProc)getProcAddress("glXSwapIntervalEXT");
+    pglXSwapIntervalMESA = (glXSwapIntervalMESAProc)getProcAddress("glXSwapIntervalMESA");
+    swapControl = (pglXSwapIntervalEXT != 0 || pglXSwapIntervalMESA != 0);
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// set the swap interval of the current context
+// 1 waits for vsync before swapping buffers, 0 swaps immediately (uncapped).
+///////////////////////////////////////////////////////////////////////////////
+bool glExtension::setSwapInterval(int interval)
+{
+    if(!swapControl)
+        return false;
+
+#ifdef _WIN32
+    return pwglSwapIntervalEXT(interval) == TRUE;
+#elif defined(__APPLE__)
+    GLint value = interval;
+    return CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &value) == kCGLNoError;
+#else
+    if(pglXSwapIntervalEXT)
+    {
+        Display* display = glXGetCurrentDisplay();
+        GLXDrawable drawable = glXGetCurrentDrawable();
+        if(display && drawable)
+        {
+            pglXSwapIntervalEXT(display, drawable, interval);
+            return true;
+        }
+    }
+    if(pglXSwapIntervalMESA)
+        return pglXSwapIntervalMESA((unsigned int)interval) == 0;
+    return false;
+#endif
+}
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+// glExtension.h
+// =============
+// OpenGL extension and core function loader for the functions not exported
+// by the OpenGL 1.1 header. Call glExtension::getInstance() after an OpenGL
+// rendering context is created, then check the feature flags before using
+// the function pointers (prefixed with "p", e.g. pglGenQueries).
+//
+//  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
+// CREATED: 2023-03-20
+// UPDATED: 2023-03-27
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GL_EXTENSION_H
+#define GL_EXTENSION_H
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// tokens which may not be defined in old gl.h
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT                 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE       0x8867
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED                 0x88BF
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER                 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER         0x8893
+#define GL_STREAM_DRAW                  0x88E0
+#define GL_STATIC_DRAW                  0x88E4
+#define GL_DYNAMIC_DRAW                 0x88E8
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER               0x8A11
+#define GL_INVALID_INDEX                0xFFFFFFFFu
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER          0x88EC
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY                   0x88B9
+#endif
+#ifndef GL_GENERATE_MIPMAP
+#define GL_GENERATE_MIPMAP              0x8191
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_FRAGMENT_SHADER              0x8B30
+#define GL_VERTEX_SHADER                0x8B31
+#define GL_COMPILE_STATUS               0x8B81
+#define GL_LINK_STATUS                  0x8B82
+#define GL_INFO_LOG_LENGTH              0x8B84
+#endif
+
+
+// function pointer types
+// query objects (GL 1.5) and timer query (GL 3.3, GL_ARB_timer_query, GL_EXT_timer_query)
+typedef void (APIENTRY * glGenQueriesProc)(GLsizei n, GLuint* ids);
+typedef void (APIENTRY * glDeleteQueriesProc)(GLsizei n, const GLuint* ids);
+typedef void (APIENTRY * glBeginQueryProc)(GLenum target, GLuint id);
+typedef void (APIENTRY * glEndQueryProc)(GLenum target);
+typedef void (APIENTRY * glGetQueryObjectivProc)(GLuint id, GLenum pname, GLint* params);
+typedef void (APIENTRY * glGetQueryObjectui64vProc)(GLuint id, GLenum pname, unsigned long long* params);
+// buffer objects (GL 1.5/3.1), GLSL (GL 2.0), uniform buffer (GL 3.1), instancing (GL 3.1/3.3)
+typedef void (APIENTRY * glGenBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY * glDeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+typedef void (APIENTRY * glBindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY * glBufferDataProc)(GLenum target, std::ptrdiff_t size, const void* data, GLenum usage);
+typedef void (APIENTRY * glBufferSubDataProc)(GLenum target, std::ptrdiff_t offset, std::ptrdiff_t size, const void* data);
+typedef void (APIENTRY * glBindBufferBaseProc)(GLenum target, GLuint index, GLuint buffer);
+typedef void* (APIENTRY * glMapBufferProc)(GLenum target, GLenum access);
+typedef GLboolean (APIENTRY * glUnmapBufferProc)(GLenum target);
+typedef GLuint (APIENTRY * glCreateShaderProc)(GLenum type);
+typedef void (APIENTRY * glDeleteShaderProc)(GLuint shader);
+typedef void (APIENTRY * glShaderSourceProc)(GLuint shader, GLsizei count, const char* const* strings, const GLint* lengths);
+typedef void (APIENTRY * glCompileShaderProc)(GLuint shader);
+typedef void (APIENTRY * glGetShaderivProc)(GLuint shader, GLenum pname, GLint* params);
+typedef void (APIENTRY * glGetShaderInfoLogProc)(GLuint shader, GLsizei maxLength, GLsizei* length, char* log);
+typedef GLuint (APIENTRY * glCreateProgramProc)(void);
+typedef void (APIENTRY * glDeleteProgramProc)(GLuint program);
+typedef void (APIENTRY * glAttachShaderProc)(GLuint program, GLuint shader);
+typedef void (APIENTRY * glBindAttribLocationProc)(GLuint program, GLuint index, const char* name);
+typedef void (APIENTRY * glLinkProgramProc)(GLuint program);
+typedef void (APIENTRY * glGetProgramivProc)(GLuint program, GLenum pname, GLint* params);
+typedef void (APIENTRY * glGetProgramInfoLogProc)(GLuint program, GLsizei maxLength, GLsizei* length, char* log);
+typedef void (APIENTRY * glUseProgramProc)(GLuint program);
+typedef GLint (APIENTRY * glGetUniformLocationProc)(GLuint program, const char* name);
+typedef void (APIENTRY * glUniform1iProc)(GLint location, GLint value);
+typedef void (APIENTRY * glUniformMatrix4fvProc)(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+typedef GLuint (APIENTRY * glGetUniformBlockIndexProc)(GLuint program, const char* name);
+typedef void (APIENTRY * glUniformBlockBindingProc)(GLuint program, GLuint blockIndex, GLuint binding);
+typedef void (APIENTRY * glEnableVertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY * glDisableVertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY * glVertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+typedef void (APIENTRY * glVertexAttribDivisorProc)(GLuint index, GLuint divisor);
+typedef void (APIENTRY * glDrawElementsInstancedProc)(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount);
+
+// function pointers, NULL if not available
+extern glGenQueriesProc             pglGenQueries;
+extern glDeleteQueriesProc          pglDeleteQueries;
+extern glBeginQueryProc             pglBeginQuery;
+extern glEndQueryProc               pglEndQuery;
+extern glGetQueryObjectivProc       pglGetQueryObjectiv;
+extern glGetQueryObjectui64vProc    pglGetQueryObjectui64v;
+extern glGenBuffersProc                   pglGenBuffers;
+extern glDeleteBuffersProc                pglDeleteBuffers;
+extern glBindBufferProc                   pglBindBuffer;
+extern glBufferDataProc                   pglBufferData;
+extern glBufferSubDataProc                pglBufferSubData;
+extern glBindBufferBaseProc               pglBindBufferBase;
+extern glMapBufferProc                    pglMapBuffer;
+extern glUnmapBufferProc                  pglUnmapBuffer;
+extern glCreateShaderProc                 pglCreateShader;
+extern glDeleteShaderProc                 pglDeleteShader;
+extern glShaderSourceProc                 pglShaderSource;
+extern glCompileShaderProc                pglCompileShader;
+extern glGetShaderivProc                  pglGetShaderiv;
+extern glGetShaderInfoLogProc             pglGetShaderInfoLog;
+extern glCreateProgramProc                pglCreateProgram;
+extern glDeleteProgramProc                pglDeleteProgram;
+extern glAttachShaderProc                 pglAttachShader;
+extern glBindAttribLocationProc           pglBindAttribLocation;
+extern glLinkProgramProc                  pglLinkProgram;
+extern glGetProgramivProc                 pglGetProgramiv;
+extern glGetProgramInfoLogProc            pglGetProgramInfoLog;
+extern glUseProgramProc                   pglUseProgram;
+extern glGetUniformLocationProc           pglGetUniformLocation;
+extern glUniform1iProc                    pglUniform1i;
+extern glUniformMatrix4fvProc             pglUniformMatrix4fv;
+extern glGetUniformBlockIndexProc         pglGetUniformBlockIndex;
+extern glUniformBlockBindingProc          pglUniformBlockBinding;
+extern glEnableVertexAttribArrayProc      pglEnableVertexAttribArray;
+extern glDisableVertexAttribArrayProc     pglDisableVertexAttribArray;
+extern glVertexAttribPointerProc          pglVertexAttribPointer;
+extern glVertexAttribDivisorProc          pglVertexAttribDivisor;
+extern glDrawElementsInstancedProc        pglDrawElementsInstanced;
+
+
+
+class glExtension
+{
+public:
+    // the instance is created at the first call, the OpenGL context must be ready
+    static glExtension& getInstance();
+
+    bool isSupported(const std::string& ext) const; // check if an extension is supported
+    const std::vector<std::string>& getExtensions() const { return extensions; }
+    int getMajorVersion() const                 { return majorVersion; }
+    int getMinorVersion() const                 { return minorVersion; }
+    bool isVersionAtLeast(int major, int minor) const;
+
+    // feature flags, true only if all function pointers of the feature are loaded
+    bool hasTimerQuery() const                  { return timerQuery; }
+    bool hasSwapControl() const                 { return swapControl; }
+    bool hasShaderPipeline() const              { return shaderPipeline; } // GLSL, UBO and instancing
+    bool hasPixelBuffer() const                 { return pixelBuffer; }    // pixel unpack buffer (PBO)
+    bool hasMipmapGeneration() const            { return mipmapGeneration; } // GL_GENERATE_MIPMAP
+
+    // set the number of vertical retraces between buffer swaps, 0 disables vsync
+    bool setSwapInterval(int interval);
+
+    void printSelf() const;
+
+
+protected:
+
+
+private:
+    glExtension();                              // prevent to create an instance directly
+    glExtension(const glExtension&);            // not copyable
+    ~glExtension() {}
+
+    void getExtensionStrings();
+    void getFunctionPointers();
+
+    std::vector<std::string> extensions;
+    int majorVersion;
+    int minorVersion;
+    bool timerQuery;
+    bool swapControl;
+    bool shaderPipeline;
+    bool pixelBuffer;
+    bool mipmapGeneration;
+};
+
+#endif // GL_EXTENSION_H
@@ -29,9 +29,419 @@ You are free to name this file lodepng.cpp or lodepng.c depending on your usage.
 */
 
 #include "lodepng.h"
+#include <math.h>
 
 #define VERSION_STRING "20080927"
 
+#ifdef LODEPNG_COMPILE_THREADS
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+/*
+LodePNG_callOnce calls function only the first time, also if several threads call it at the same time, so that the
+tables made on first use are complete before any decoder or encoder running on another thread reads them
+*/
+#ifdef LODEPNG_COMPILE_THREADS
+#ifdef _WIN32
+typedef INIT_ONCE LodePNG_Once;
+#define LODEPNG_ONCE_INIT INIT_ONCE_STATIC_INIT
+static BOOL CALLBACK LodePNG_onceMain(PINIT_ONCE once, PVOID function, PVOID* context)
+{
+  (void)once; (void)context;
+  ((void (*)(void))function)();
+  return TRUE;
+}
+static void LodePNG_callOnce(LodePNG_Once* once, void (*function)(void))
+{
+  InitOnceExecuteOnce(once, LodePNG_onceMain, (PVOID)function, 0);
+}
+#else
+typedef pthread_once_t LodePNG_Once;
+#define LODEPNG_ONCE_INIT PTHREAD_ONCE_INIT
+static void LodePNG_callOnce(LodePNG_Once* once, void (*function)(void))
+{
+  pthread_once(once, function);
+}
+#endif
+#else
+typedef unsigned LodePNG_Once;
+#define LODEPNG_ONCE_INIT 0
+static void LodePNG_callOnce(LodePNG_Once* once, void (*function)(void))
+{
+  if(!*once) { function(); *once = 1; }
+}
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+#ifdef LODEPNG_COMPILE_SIMD
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LODEPNG_SIMD_X86
+#define LODEPNG_TARGET(features) __attribute__((target(features))) /*allows the intrinsics in a function without compiling the whole file for that CPU*/
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define LODEPNG_SIMD_X86
+#define LODEPNG_TARGET(features)
+#include <intrin.h>
+#endif
+#endif /*LODEPNG_COMPILE_SIMD*/
+
+#ifdef LODEPNG_SIMD_X86
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / x86 CPU features                                                       / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+#define CPU_SSSE3   1
+#define CPU_SSE41   2
+#define CPU_PCLMUL  4
+#define CPU_AVX2    8
+#define CPU_SSE2   16
+
+static LodePNG_Once LodePNG_cpuFeaturesOnce = LODEPNG_ONCE_INIT;
+static unsigned LodePNG_cpuFeatureFlags = 0;
+
+static void LodePNG_detectCpuFeatures(void)
+{
+  unsigned features = 0;
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  if(info[3] & (1 << 26)) features |= CPU_SSE2;
+  if(info[2] & (1 << 9)) features |= CPU_SSSE3;
+  if(info[2] & (1 << 19)) features |= CPU_SSE41;
+  if(info[2] & (1 << 1)) features |= CPU_PCLMUL;
+  if((info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6) /*OS saves the AVX registers*/
+  {
+    __cpuidex(info, 7, 0);
+    if(info[1] & (1 << 5)) features |= CPU_AVX2;
+  }
+#else
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("sse2")) features |= CPU_SSE2;
+  if(__builtin_cpu_supports("ssse3")) features |= CPU_SSSE3;
+  if(__builtin_cpu_supports("sse4.1")) features |= CPU_SSE41;
+  if(__builtin_cpu_supports("pclmul")) features |= CPU_PCLMUL;
+  if(__builtin_cpu_supports("avx2")) features |= CPU_AVX2;
+#endif
+  LodePNG_cpuFeatureFlags = features;
+}
+
+/*returns the CPU_ flags of the SIMD instruction sets the CPU (and OS) supports, detected once*/
+static unsigned LodePNG_cpuFeatures(void)
+{
+  LodePNG_callOnce(&LodePNG_cpuFeaturesOnce, LodePNG_detectCpuFeatures);
+  return LodePNG_cpuFeatureFlags;
+}
+#endif /*LODEPNG_SIMD_X86*/
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / Threads                                                                / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+#define LODEPNG_MAX_THREADS 64
+
+typedef struct LodePNG_ParallelTask
+{
+  void (*function)(void* data, unsigned index);
+  void* data;
+  unsigned first; /*the task calls function with first, first + step, ... up to count*/
+  unsigned step;
+  unsigned count;
+} LodePNG_ParallelTask;
+
+static void LodePNG_ParallelTask_run(LodePNG_ParallelTask* task)
+{
+  unsigned i;
+  for(i = task->first; i < task->count; i += task->step) task->function(task->data, i);
+}
+
+#ifdef LODEPNG_COMPILE_THREADS
+#ifdef _WIN32
+static DWORD WINAPI LodePNG_threadMain(LPVOID task)
+{
+  LodePNG_ParallelTask_run((LodePNG_ParallelTask*)task);
+  return 0;
+}
+#else
+static void* LodePNG_threadMain(void* task)
+{
+  LodePNG_ParallelTask_run((LodePNG_ParallelTask*)task);
+  return 0;
+}
+#endif
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+/*the number of threads LodePNG_parallelFor uses for count indices: numThreads, or one per CPU if it's 0*/
+static unsigned LodePNG_threadCount(unsigned numThreads, unsigned count)
+{
+#ifdef LODEPNG_COMPILE_THREADS
+  if(numThreads == 0)
+  {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    numThreads = (unsigned)info.dwNumberOfProcessors;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    numThreads = cpus > 0 ? (unsigned)cpus : 1;
+#endif
+  }
+#else
+  numThreads = 1;
+#endif /*LODEPNG_COMPILE_THREADS*/
+  if(numThreads > LODEPNG_MAX_THREADS) numThreads = LODEPNG_MAX_THREADS;
+  if(numThreads > count) numThreads = count;
+  return numThreads > 0 ? numThreads : 1;
+}
+
+/*
+calls function(data, index) for every index from 0 to count - 1, spread over the threads given by LodePNG_threadCount,
+the calling thread is one of them. It returns after all calls are done. If a thread can't be created, or without
+LODEPNG_COMPILE_THREADS, the calling thread does that part of the work too.
+*/
+static void LodePNG_parallelFor(void (*function)(void*, unsigned), void* data, unsigned count, unsigned numThreads)
+{
+  LodePNG_ParallelTask tasks[LODEPNG_MAX_THREADS];
+#ifdef LODEPNG_COMPILE_THREADS
+#ifdef _WIN32
+  HANDLE threads[LODEPNG_MAX_THREADS];
+#else
+  pthread_t threads[LODEPNG_MAX_THREADS];
+#endif
+  unsigned char started[LODEPNG_MAX_THREADS];
+#endif /*LODEPNG_COMPILE_THREADS*/
+  unsigned i;
+  
+  numThreads = LodePNG_threadCount(numThreads, count);
+  for(i = 0; i < numThreads; i++)
+  {
+    tasks[i].function = function;
+    tasks[i].data = data;
+    tasks[i].first = i;
+    tasks[i].step = numThreads;
+    tasks[i].count = count;
+  }
+  
+#ifdef LODEPNG_COMPILE_THREADS
+  for(i = 1; i < numThreads; i++)
+  {
+#ifdef _WIN32
+    threads[i] = CreateThread(0, 0, LodePNG_threadMain, &tasks[i], 0, 0);
+    started[i] = threads[i] != 0;
+#else
+    started[i] = pthread_create(&threads[i], 0, LodePNG_threadMain, &tasks[i]) == 0;
+#endif
+  }
+  LodePNG_ParallelTask_run(&tasks[0]);
+  for(i = 1; i < numThreads; i++)
+  {
+    if(!started[i]) { LodePNG_ParallelTask_run(&tasks[i]); continue; }
+#ifdef _WIN32
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], 0);
+#endif
+  }
+#else
+  for(i = 0; i < numThreads; i++) LodePNG_ParallelTask_run(&tasks[i]);
+#endif /*LODEPNG_COMPILE_THREADS*/
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / Memory Allocation                                                      / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+#ifdef LODEPNG_COMPILE_THREADS
+#ifdef _MSC_VER
+#define LODEPNG_THREAD_LOCAL __declspec(thread)
+#else
+#define LODEPNG_THREAD_LOCAL __thread
+#endif
+#else
+#define LODEPNG_THREAD_LOCAL
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+/*
+the allocator of the decoder or encoder that runs on this thread, NULL for malloc. The vectors remember the allocator
+they're made with, so they can be given to other threads. The threads of LodePNG_parallelFor start with NULL.
+*/
+static LODEPNG_THREAD_LOCAL const LodePNG_Allocator* LodePNG_currentAllocator = 0;
+
+static const LodePNG_Allocator* LodePNG_useAllocator(const LodePNG_Allocator* allocator) /*returns the previous one to restore*/
+{
+  const LodePNG_Allocator* previous = LodePNG_currentAllocator;
+  LodePNG_currentAllocator = allocator;
+  return previous;
+}
+
+static void* LodePNG_reallocWith(const LodePNG_Allocator* allocator, void* ptr, size_t size)
+{
+  return allocator ? allocator->reallocate(allocator->data, ptr, size) : realloc(ptr, size);
+}
+
+static void LodePNG_freeWith(const LodePNG_Allocator* allocator, void* ptr)
+{
+  if(allocator) allocator->deallocate(allocator->data, ptr);
+  else free(ptr);
+}
+
+/*for temporary buffers, which are freed by the same decoder or encoder call that allocates them*/
+static void* LodePNG_malloc(size_t size)
+{
+  const LodePNG_Allocator* allocator = LodePNG_currentAllocator;
+  return allocator ? allocator->allocate(allocator->data, size) : malloc(size);
+}
+
+static void LodePNG_free(void* ptr)
+{
+  LodePNG_freeWith(LodePNG_currentAllocator, ptr);
+}
+
+/*
+every allocation of the arena starts with its size, and both are aligned to ARENA_ALIGN bytes. The blocks start with
+an ArenaBlock.
+*/
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(size) (((size) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_HEADER ARENA_ROUND(sizeof(size_t))
+#define ARENA_BLOCK_HEADER ARENA_ROUND(sizeof(ArenaBlock))
+
+typedef struct ArenaBlock
+{
+  struct ArenaBlock* next; /*the older block*/
+  size_t size; /*bytes after the block header*/
+} ArenaBlock;
+
+static unsigned char* ArenaBlock_data(ArenaBlock* block)
+{
+  return (unsigned char*)block + ARENA_BLOCK_HEADER;
+}
+
+static void* Arena_allocate(void* data, size_t size)
+{
+  LodePNG_Arena* arena = (LodePNG_Arena*)data;
+  ArenaBlock* block = (ArenaBlock*)arena->blocks;
+  size_t needed = ARENA_HEADER + ARENA_ROUND(size);
+  unsigned char* result;
+
+  if(size > (size_t)(-1) / 2) return 0; /*would overflow*/
+  arena->allocations++;
+  if(!block || block->size - arena->used < needed)
+  {
+    size_t blockSize = needed > arena->blockSize ? needed : arena->blockSize;
+    block = (ArenaBlock*)malloc(ARENA_BLOCK_HEADER + blockSize);
+    if(!block) return 0;
+    arena->blockAllocations++;
+    if(arena->blocks) arena->total += ((ArenaBlock*)arena->blocks)->size - arena->used; /*the rest of the old block is lost until the reset*/
+    block->next = (ArenaBlock*)arena->blocks;
+    block->size = blockSize;
+    arena->blocks = block;
+    arena->used = 0;
+  }
+
+  result = ArenaBlock_data(block) + arena->used;
+  *(size_t*)result = size;
+  arena->last = arena->used;
+  arena->used += needed;
+  arena->total += needed;
+  if(arena->total > arena->peak) arena->peak = arena->total;
+  return result + ARENA_HEADER;
+}
+
+/*the last allocation grows or shrinks in place if the newest block has room, others are copied*/
+static void* Arena_reallocate(void* data, void* ptr, size_t size)
+{
+  LodePNG_Arena* arena = (LodePNG_Arena*)data;
+  ArenaBlock* block = (ArenaBlock*)arena->blocks;
+  unsigned char* header;
+  size_t oldsize;
+  void* result;
+
+  if(!ptr) return Arena_allocate(data, size);
+  header = (unsigned char*)ptr - ARENA_HEADER;
+  oldsize = *(size_t*)header;
+  if(header == ArenaBlock_data(block) + arena->last && size <= (size_t)(-1) / 2
+  && block->size - arena->last >= ARENA_HEADER + ARENA_ROUND(size))
+  {
+    size_t used = arena->last + ARENA_HEADER + ARENA_ROUND(size);
+    arena->allocations++;
+    arena->total = arena->total - arena->used + used;
+    arena->used = used;
+    if(arena->total > arena->peak) arena->peak = arena->total;
+    *(size_t*)header = size;
+    return ptr;
+  }
+
+  result = Arena_allocate(data, size);
+  if(result) memcpy(result, ptr, oldsize < size ? oldsize : size);
+  return result;
+}
+
+/*only the last allocation is given back, the others stay until the reset*/
+static void Arena_deallocate(void* data, void* ptr)
+{
+  LodePNG_Arena* arena = (LodePNG_Arena*)data;
+  ArenaBlock* block = (ArenaBlock*)arena->blocks;
+
+  if(ptr && block && (unsigned char*)ptr - ARENA_HEADER == ArenaBlock_data(block) + arena->last)
+  {
+    arena->total -= arena->used - arena->last;
+    arena->used = arena->last;
+  }
+}
+
+void LodePNG_Arena_init(LodePNG_Arena* arena, size_t blockSize)
+{
+  arena->allocator.allocate = Arena_allocate;
+  arena->allocator.reallocate = Arena_reallocate;
+  arena->allocator.deallocate = Arena_deallocate;
+  arena->allocator.data = arena;
+  arena->blocks = 0;
+  arena->blockSize = blockSize ? ARENA_ROUND(blockSize) : 65536;
+  arena->used = arena->last = arena->total = 0;
+  arena->allocations = arena->blockAllocations = arena->peak = 0;
+}
+
+void LodePNG_Arena_reset(LodePNG_Arena* arena)
+{
+  ArenaBlock* block = (ArenaBlock*)arena->blocks;
+
+  if(block && block->next)
+  {
+    /*everything fits in one block next time, if the next image isn't bigger than the biggest one so far*/
+    if(arena->peak > arena->blockSize) arena->blockSize = ARENA_ROUND(arena->peak);
+    LodePNG_Arena_cleanup(arena);
+    block = (ArenaBlock*)malloc(ARENA_BLOCK_HEADER + arena->blockSize);
+    if(block)
+    {
+      arena->blockAllocations++;
+      block->next = 0;
+      block->size = arena->blockSize;
+      arena->blocks = block;
+    }
+  }
+  arena->used = arena->last = arena->total = 0;
+}
+
+void LodePNG_Arena_cleanup(LodePNG_Arena* arena)
+{
+  ArenaBlock* block = (ArenaBlock*)arena->blocks;
+  while(block)
+  {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks = 0;
+  arena->used = arena->last = arena->total = 0;
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Tools For C                                                            / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -52,6 +462,7 @@ typedef struct vector /*this one is used only by the deflate compressor*/
   size_t size; /*in groups of bytes depending on type*/
   size_t allocsize; /*in bytes*/
   unsigned typesize; /*sizeof the type you store in data*/
+  const LodePNG_Allocator* allocator; /*the one of the decoder or encoder that made it, NULL for malloc*/
 } vector;
 
 static unsigned vector_resize(vector* p, size_t size) /*returns 1 if success, 0 if failure ==> nothing done*/
@@ -59,7 +470,7 @@ static unsigned vector_resize(vector* p, size_t size) /*returns 1 if success, 0
   if(size * p->typesize > p->allocsize)
   {
     size_t newsize = size * p->typesize * 2;
-    void* data = realloc(p->data, newsize);
+    void* data = LodePNG_reallocWith(p->allocator, p->data, newsize);
     if(data)
     {
       p->allocsize = newsize;
@@ -82,7 +493,7 @@ static unsigned vector_resized(vector* p, size_t size, void dtor(void*)) /*resiz
 static void vector_cleanup(void* p)
 {
   ((vector*)p)->size = ((vector*)p)->allocsize = 0;
-  free(((vector*)p)->data);
+  LodePNG_freeWith(((vector*)p)->allocator, ((vector*)p)->data);
   ((vector*)p)->data = NULL;
 }
 
@@ -97,15 +508,18 @@ static void vector_init(vector* p, unsigned typesize)
   p->data = NULL;
   p->size = p->allocsize = 0;
   p->typesize = typesize;
+  p->allocator = LodePNG_currentAllocator;
 }
 
 static void vector_swap(vector* p, vector* q) /*they're supposed to have the same typesize*/
 {
   size_t tmp;
   void* tmpp;
+  const LodePNG_Allocator* tmpa;
   tmp = p->size; p->size = q->size; q->size = tmp;
   tmp = p->allocsize; p->allocsize = q->allocsize; q->allocsize = tmp;
   tmpp = p->data; p->data = q->data; q->data = tmpp;
+  tmpa = p->allocator; p->allocator = q->allocator; q->allocator = tmpa;
 }
 
 static void* vector_get(vector* p, size_t index)
@@ -123,12 +537,13 @@ typedef struct uivector
   unsigned* data;
   size_t size; /*size in number of unsigned longs*/
   size_t allocsize; /*allocated size in bytes*/
+  const LodePNG_Allocator* allocator; /*the one of the decoder or encoder that made it, NULL for malloc*/
 } uivector;
 
 static void uivector_cleanup(void* p)
 {
   ((uivector*)p)->size = ((uivector*)p)->allocsize = 0;
-  free(((uivector*)p)->data);
+  LodePNG_freeWith(((uivector*)p)->allocator, ((uivector*)p)->data);
   ((uivector*)p)->data = NULL;
 }
 
@@ -137,7 +552,7 @@ static unsigned uivector_resize(uivector* p, size_t size) /*returns 1 if success
   if(size * sizeof(unsigned) > p->allocsize)
   {
     size_t newsize = size * sizeof(unsigned) * 2;
-    void* data = realloc(p->data, newsize);
+    void* data = LodePNG_reallocWith(p->allocator, p->data, newsize);
     if(data)
     {
       p->allocsize = newsize;
@@ -162,6 +577,7 @@ static void uivector_init(uivector* p)
 {
   p->data = NULL;
   p->size = p->allocsize = 0;
+  p->allocator = LodePNG_currentAllocator;
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -184,9 +600,11 @@ static void uivector_swap(uivector* p, uivector* q)
 {
   size_t tmp;
   unsigned* tmpp;
+  const LodePNG_Allocator* tmpa;
   tmp = p->size; p->size = q->size; q->size = tmp;
   tmp = p->allocsize; p->allocsize = q->allocsize; q->allocsize = tmp;
   tmpp = p->data; p->data = q->data; q->data = tmpp;
+  tmpa = p->allocator; p->allocator = q->allocator; q->allocator = tmpa;
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
@@ -198,21 +616,22 @@ typedef struct ucvector
   unsigned char* data;
   size_t size; /*used size*/
   size_t allocsize; /*allocated size*/
+  const LodePNG_Allocator* allocator; /*the one of the decoder or encoder that made it, NULL for malloc*/
 } ucvector;
 
 static void ucvector_cleanup(void* p)
 {
   ((ucvector*)p)->size = ((ucvector*)p)->allocsize = 0;
-  free(((ucvector*)p)->data);
+  LodePNG_freeWith(((ucvector*)p)->allocator, ((ucvector*)p)->data);
   ((ucvector*)p)->data = NULL;
 }
 
 static unsigned ucvector_resize(ucvector* p, size_t size) /*returns 1 if success, 0 if failure ==> nothing done*/
 {
-  if(size * sizeof(unsigned) > p->allocsize)
+  if(size > p->allocsize)
   {
-    size_t newsize = size * sizeof(unsigned) * 2;
-    void* data = realloc(p->data, newsize);
+    size_t newsize = size * 2;
+    void* data = LodePNG_reallocWith(p->allocator, p->data, newsize);
     if(data)
     {
       p->allocsize = newsize;
@@ -234,6 +653,20 @@ static unsigned ucvector_resizev(ucvector* p, size_t size, unsigned char value)
   for(i = oldsize; i < size; i++) p->data[i] = value;
   return 1;
 }
+
+/*resize without reserving more room than size, for a vector whose size is known and won't grow*/
+static unsigned ucvector_resize_exact(ucvector* p, size_t size) /*returns 1 if success, 0 if failure ==> nothing done*/
+{
+  if(size > p->allocsize)
+  {
+    void* data = LodePNG_reallocWith(p->allocator, p->data, size);
+    if(!data) return 0; /*error: not enough memory*/
+    p->allocsize = size;
+    p->data = (unsigned char*)data;
+  }
+  p->size = size;
+  return 1;
+}
 #endif /*LODEPNG_COMPILE_PNG*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -241,14 +674,25 @@ static void ucvector_init(ucvector* p)
 {
   p->data = NULL;
   p->size = p->allocsize = 0;
+  p->allocator = LodePNG_currentAllocator;
+}
+
+#ifdef LODEPNG_COMPILE_PNG
+/*for a buffer that is given to the user, who frees it with free*/
+static void ucvector_init_malloc(ucvector* p)
+{
+  ucvector_init(p);
+  p->allocator = 0;
 }
+#endif /*LODEPNG_COMPILE_PNG*/
 
 #ifdef LODEPNG_COMPILE_ZLIB
 /*you can both convert from vector to buffer&size and vica versa*/
-static void ucvector_init_buffer(ucvector* p, unsigned char* buffer, size_t size)
+static void ucvector_init_buffer(ucvector* p, unsigned char* buffer, size_t size) /*buffer must be made with the current allocator*/
 {
   p->data = buffer;
   p->allocsize = p->size = size;
+  p->allocator = LodePNG_currentAllocator;
 }
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -322,19 +766,148 @@ static void addBitsToStreamReversed(size_t* bitpointer, ucvector* bitstream, uns
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #ifdef LODEPNG_COMPILE_DECODER
-static unsigned char readBitFromStream(size_t* bitpointer, const unsigned char* bitstream)
+/*reads the bits of a deflate stream, the first bit of the stream is the lsb of the first byte.
+Up to 64 bits are kept in a buffer, which is refilled several bytes at a time, so that multiple bits can be peeked and
+consumed at once. Bytes past the end of the data read as 0, compare BitReader_position with the size of the data to
+detect reading past the end.
+The data can also come in pieces from a source (BitReader_setSource), e.g. while the file is read. Then data is the
+current piece, and the source is asked for the next one before fewer than 8 bytes are left, so the positions and the
+end checks are relative to the current piece, and the end is only reached when the source has no more bytes.*/
+typedef struct BitReader
+{
+  const unsigned char* data;
+  size_t size; /*size of data in bytes*/
+  size_t pos; /*byte position of the next refill, goes past size when zeros are read past the end*/
+  unsigned long long buffer; /*the next bits of the stream, the first one in the lsb*/
+  unsigned bitcount; /*number of valid bits in buffer*/
+  /*if not 0, returns the next piece: the restsize bytes rest (the end of the current piece) followed by more bytes,
+  and sets *size to the total size. No more bytes than restsize means the end of the data.*/
+  const unsigned char* (*source)(void* sourcedata, const unsigned char* rest, size_t restsize, size_t* size);
+  void* sourcedata;
+} BitReader;
+
+static void BitReader_init(BitReader* reader, const unsigned char* data, size_t size)
+{
+  reader->data = data;
+  reader->size = size;
+  reader->pos = 0;
+  reader->buffer = 0;
+  reader->bitcount = 0;
+  reader->source = 0;
+  reader->sourcedata = 0;
+}
+
+/*with a source, get the next pieces until at least 8 bytes are left after pos or the source has no more. The last
+8 bytes before pos are kept in the piece, the bits in the buffer came from them, so the position stays valid.*/
+static void BitReader_fill(BitReader* reader)
+{
+  while(reader->source && reader->pos + 8 > reader->size)
+  {
+    size_t keep = reader->pos < 8 ? reader->pos : 8;
+    size_t restsize = reader->size - reader->pos + keep;
+    size_t size = 0;
+    const unsigned char* data = reader->source(reader->sourcedata, &reader->data[reader->pos - keep], restsize, &size);
+    if(size <= restsize) reader->source = 0; /*the end of the data*/
+    reader->data = data;
+    reader->size = size;
+    reader->pos = keep;
+  }
+}
+
+static void BitReader_setSource(BitReader* reader, const unsigned char* (*source)(void*, const unsigned char*, size_t, size_t*), void* sourcedata)
 {
-  unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> ((*bitpointer) & 0x7)) & 1);
-  (*bitpointer)++;
-  return result;
+  BitReader_init(reader, 0, 0);
+  reader->source = source;
+  reader->sourcedata = sourcedata;
+  BitReader_fill(reader);
+}
+
+/*fill the buffer up to at least 56 bits*/
+static void BitReader_refill(BitReader* reader)
+{
+  if(reader->source && reader->pos + 8 > reader->size) BitReader_fill(reader);
+  if(reader->pos + 8 <= reader->size) /*load 8 bytes at once, only the whole bytes that fit are consumed*/
+  {
+    const unsigned char* p = &reader->data[reader->pos];
+    unsigned long long word = (unsigned long long)p[0]         | ((unsigned long long)p[1] <<  8)
+                           | ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24)
+                           | ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40)
+                           | ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+    reader->buffer |= word << reader->bitcount;
+    reader->pos += (63 - reader->bitcount) >> 3;
+    reader->bitcount |= 56;
+  }
+  else /*near the end, byte by byte*/
+  {
+    while(reader->bitcount < 56)
+    {
+      unsigned long long byte = reader->pos < reader->size ? reader->data[reader->pos] : 0;
+      reader->buffer |= byte << reader->bitcount;
+      reader->pos++;
+      reader->bitcount += 8;
+    }
+  }
+}
+
+/*returns the next nbits (at most 32) bits without consuming them, the first bit in the lsb*/
+static unsigned BitReader_peekBits(BitReader* reader, unsigned nbits)
+{
+  if(reader->bitcount < nbits) BitReader_refill(reader);
+  return (unsigned)(reader->buffer & ((1ull << nbits) - 1u));
 }
 
-static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bitstream, size_t nbits)
+/*consume nbits that were peeked before*/
+static void BitReader_skipBits(BitReader* reader, unsigned nbits)
 {
-  unsigned result = 0, i;
-  for(i = 0; i < nbits; i++) result += ((unsigned)readBitFromStream(bitpointer, bitstream)) << i;
+  reader->buffer >>= nbits;
+  reader->bitcount -= nbits;
+}
+
+static unsigned BitReader_readBits(BitReader* reader, unsigned nbits)
+{
+  unsigned result = BitReader_peekBits(reader, nbits);
+  BitReader_skipBits(reader, nbits);
   return result;
 }
+
+/*the position in bits of the next bit to read*/
+static size_t BitReader_position(const BitReader* reader)
+{
+  return reader->pos * 8 - reader->bitcount;
+}
+
+/*skip the bits up to the next byte boundary*/
+static void BitReader_alignToByte(BitReader* reader)
+{
+  BitReader_skipBits(reader, reader->bitcount & 7);
+}
+
+/*read size bytes from a byte boundary: first the whole bytes in the buffer, then the rest directly from data.
+Returns 0 if the data ends before.*/
+static unsigned BitReader_readBytes(BitReader* reader, unsigned char* out, size_t size)
+{
+  size_t n = 0;
+  for(; n < size && reader->bitcount >= 8; n++)
+  {
+    out[n] = (unsigned char)reader->buffer;
+    BitReader_skipBits(reader, 8);
+  }
+  if(n == size) return 1;
+  reader->buffer = 0; /*the buffer is empty now, the next byte is at pos*/
+  reader->bitcount = 0;
+  while(n < size)
+  {
+    size_t avail;
+    if(reader->pos >= reader->size) BitReader_fill(reader);
+    if(reader->pos >= reader->size) return 0;
+    avail = reader->size - reader->pos;
+    if(avail > size - n) avail = size - n;
+    memcpy(&out[n], &reader->data[reader->pos], avail);
+    reader->pos += avail;
+    n += avail;
+  }
+  return 1;
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -346,6 +919,7 @@ static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bits
 #define NUM_DEFLATE_CODE_SYMBOLS 288 /*256 literals, the end code, some length codes, and 2 unused codes*/
 #define NUM_DISTANCE_SYMBOLS 32 /*the distance codes have their own symbols, 30 used, 2 unused*/
 #define NUM_CODE_LENGTH_CODES 19 /*the code length codes. 0-15: code lengths, 16: copy previous 3-6 times, 17: 3-10 zeros, 18: 11-138 zeros*/
+#define HUFFMAN_TABLE_BITS 9 /*number of bits looked up at once in the primary decoding table, longer codes continue in a sub-table*/
 
 static const unsigned LENGTHBASE[29] /*the base lengths represented by codes 257-285*/
   = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
@@ -421,6 +995,7 @@ typedef struct HuffmanTree
   uivector tree2d;
   uivector tree1d;
   uivector lengths; /*the lengths of the codes of the 1d-tree*/
+  uivector table; /*decoding lookup table: the primary table of 2^HUFFMAN_TABLE_BITS entries, followed by the sub-tables*/
   unsigned maxbitlen; /*maximum number of bits a single code can get*/
   unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
 } HuffmanTree;
@@ -443,6 +1018,7 @@ static void HuffmanTree_init(HuffmanTree* tree)
   uivector_init(&tree->tree2d);
   uivector_init(&tree->tree1d);
   uivector_init(&tree->lengths);
+  uivector_init(&tree->table);
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
@@ -450,6 +1026,7 @@ static void HuffmanTree_cleanup(HuffmanTree* tree)
   uivector_cleanup(&tree->tree2d);
   uivector_cleanup(&tree->tree1d);
   uivector_cleanup(&tree->lengths);
+  uivector_cleanup(&tree->table);
 }
 
 /*the tree representation used by the decoder. return value is error*/
@@ -490,6 +1067,79 @@ static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
   return 0;
 }
 
+#ifdef LODEPNG_COMPILE_DECODER
+static unsigned reverseBits(unsigned bits, unsigned num)
+{
+  unsigned i, result = 0;
+  for(i = 0; i < num; i++) result |= ((bits >> (num - i - 1)) & 1) << i;
+  return result;
+}
+
+/*the lookup table representation used by the decoder, made from tree1d and lengths. return value is error.
+The table is indexed with the next bits of the stream, the first bit in the lsb, so with the codes bit-reversed.
+Each entry is (symbol << 8) | length for a code of length bits. In the primary table, an entry with a length of
+16 + n instead refers to a sub-table of 2^n entries at index (entry >> 8), which is indexed by the bits after the
+first HUFFMAN_TABLE_BITS ones. Entries of bit patterns that aren't codes of the tree have length 0.*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+  static const unsigned headsize = 1u << HUFFMAN_TABLE_BITS;
+  static const unsigned mask = (1u << HUFFMAN_TABLE_BITS) - 1u;
+  unsigned maxlens[1u << HUFFMAN_TABLE_BITS]; /*the longest code sharing each primary entry*/
+  unsigned offsets[1u << HUFFMAN_TABLE_BITS]; /*the index of the sub-table of each primary entry*/
+  unsigned n, j, size = headsize;
+
+  for(n = 0; n < headsize; n++) maxlens[n] = 0;
+  for(n = 0; n < tree->numcodes; n++)
+  {
+    unsigned l = tree->lengths.data[n];
+    unsigned index;
+    if(l <= HUFFMAN_TABLE_BITS) continue;
+    index = reverseBits(tree->tree1d.data[n] >> (l - HUFFMAN_TABLE_BITS), HUFFMAN_TABLE_BITS);
+    if(maxlens[index] < l) maxlens[index] = l;
+  }
+  for(n = 0; n < headsize; n++) if(maxlens[n]) size += 1u << (maxlens[n] - HUFFMAN_TABLE_BITS);
+
+  uivector_resize(&tree->table, 0);
+  if(!uivector_resizev(&tree->table, size, 0)) return 9956;
+
+  /*link the primary entries of long codes to their sub-tables*/
+  size = headsize;
+  for(n = 0; n < headsize; n++)
+  {
+    unsigned subbits;
+    offsets[n] = size;
+    if(!maxlens[n]) continue;
+    subbits = maxlens[n] - HUFFMAN_TABLE_BITS;
+    tree->table.data[n] = (size << 8) | (16 + subbits);
+    size += 1u << subbits;
+  }
+
+  /*fill in the symbols, a code shorter than the table index fills every entry starting with its bits*/
+  for(n = 0; n < tree->numcodes; n++)
+  {
+    unsigned l = tree->lengths.data[n];
+    unsigned reversed;
+    if(l == 0) continue;
+    reversed = reverseBits(tree->tree1d.data[n], l);
+    if(l <= HUFFMAN_TABLE_BITS)
+    {
+      for(j = reversed; j < headsize; j += 1u << l) tree->table.data[j] = (n << 8) | l;
+    }
+    else
+    {
+      unsigned index = reversed & mask;
+      unsigned subsize = 1u << (maxlens[index] - HUFFMAN_TABLE_BITS);
+      for(j = reversed >> HUFFMAN_TABLE_BITS; j < subsize; j += 1u << (l - HUFFMAN_TABLE_BITS))
+      {
+        tree->table.data[offsets[index] + j] = (n << 8) | l;
+      }
+    }
+  }
+
+  return 0;
+}
+#endif /*LODEPNG_COMPILE_DECODER*/
+
 static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree) /*given that numcodes, lengths and maxbitlen are already filled in correctly. return value is error.*/
 {
   uivector blcount;
@@ -516,8 +1166,8 @@ static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree) /*given that num
   uivector_cleanup(&blcount);
   uivector_cleanup(&nextcode);
   
-  if(!error) return HuffmanTree_make2DTree(tree);
-  else return error;
+  if(!error) error = HuffmanTree_make2DTree(tree);
+  return error;
 }
 
 /*given the code lengths (as stored in the PNG file), generate the tree as defined by Deflate. maxbitlen is the maximum bits that a code in the tree can have. return value is error.*/
@@ -698,19 +1348,38 @@ static unsigned HuffmanTree_decode(const HuffmanTree* tree, unsigned* decoded, u
   return 0;
 }
 
-static unsigned huffmanDecodeSymbol(unsigned int* error, const unsigned char* in, size_t* bp, const HuffmanTree* codetree, size_t inlength)
+static unsigned huffmanDecodeSymbol(unsigned int* error, BitReader* reader, const HuffmanTree* codetree)
 {
   unsigned treepos = 0, decoded, ct;
   for(;;)
   {
     unsigned char bit;
-    if(((*bp) & 0x07) == 0 && ((*bp) >> 3) > inlength) { *error = 10; return 0; } /*error: end of input memory reached without endcode*/
-    bit = readBitFromStream(bp, in);
+    size_t bp = BitReader_position(reader);
+    if((bp & 0x07) == 0 && (bp >> 3) > reader->size) { *error = 10; return 0; } /*error: end of input memory reached without endcode*/
+    bit = (unsigned char)BitReader_readBits(reader, 1);
     *error = HuffmanTree_decode(codetree, &decoded, &ct, &treepos, bit);
     if(*error) return 0; /*stop, an error happened*/
     if(decoded) return ct;
   }
 }
+
+/*same as huffmanDecodeSymbol, but looks up the whole code at once in the table of the tree instead of walking the
+tree bit by bit. Codes up to HUFFMAN_TABLE_BITS long take one lookup, longer codes one more in a sub-table.*/
+static unsigned huffmanDecodeSymbolTable(unsigned int* error, BitReader* reader, const HuffmanTree* codetree)
+{
+  unsigned bits = BitReader_peekBits(reader, 16);
+  unsigned entry = codetree->table.data[bits & ((1u << HUFFMAN_TABLE_BITS) - 1u)];
+  unsigned length = entry & 255;
+  if(length >= 16) /*long code, continue in the sub-table*/
+  {
+    entry = codetree->table.data[(entry >> 8) + ((bits >> HUFFMAN_TABLE_BITS) & ((1u << (length - 16)) - 1u))];
+    length = entry & 255;
+  }
+  if(length == 0) { *error = 11; return 0; } /*error: the bits aren't a code of the tree*/
+  if(BitReader_position(reader) + length > (reader->size + 1) * 8) { *error = 10; return 0; } /*error: end of input memory reached without endcode*/
+  BitReader_skipBits(reader, length);
+  return entry >> 8;
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -720,16 +1389,21 @@ static unsigned huffmanDecodeSymbol(unsigned int* error, const unsigned char* in
 /* ////////////////////////////////////////////////////////////////////////// */
 
 /*get the tree of a deflated block with fixed tree, as specified in the deflate specification*/
-static void getTreeInflateFixed(HuffmanTree* tree, HuffmanTree* treeD)
+static unsigned getTreeInflateFixed(HuffmanTree* tree, HuffmanTree* treeD, unsigned usetable)
 {
+  unsigned error = 0;
   /*error checking not done, this is fixed stuff, it works, it doesn't depend on the image*/
   generateFixedTree(tree);
   generateDistanceTree(treeD);
+  /*only the decoder reads the lookup tables, so they are made here and not for the trees of the encoder*/
+  if(usetable) error = HuffmanTree_makeTable(tree);
+  if(usetable && !error) error = HuffmanTree_makeTable(treeD);
+  return error;
 }
 
 /*get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
 static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetreeD, HuffmanTree* codelengthcodetree,
-                                      const unsigned char* in, size_t* bp, size_t inlength)
+                                      BitReader* reader, unsigned usetable)
 {
   /*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated*/
   /*C-code note: use no "return" between ctor and dtor of an uivector!*/
@@ -739,11 +1413,12 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
   uivector bitlenD;
   uivector codelengthcode;
   
-  if((*bp) >> 3 >= inlength - 2) { return 49; } /*the bit pointer is or will go past the memory*/
+  BitReader_fill(reader); /*with a source, so that the end check sees at least 8 bytes if there are more*/
+  if(BitReader_position(reader) >> 3 >= reader->size - 2) { return 49; } /*the bit pointer is or will go past the memory*/
 
-  HLIT =  readBitsFromStream(bp, in, 5) + 257; /*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already*/
-  HDIST = readBitsFromStream(bp, in, 5) + 1; /*number of distance codes. Unlike the spec, the value 1 is added to it here already*/
-  HCLEN = readBitsFromStream(bp, in, 4) + 4; /*number of code length codes. Unlike the spec, the value 4 is added to it here already*/
+  HLIT =  BitReader_readBits(reader, 5) + 257; /*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already*/
+  HDIST = BitReader_readBits(reader, 5) + 1; /*number of distance codes. Unlike the spec, the value 1 is added to it here already*/
+  HCLEN = BitReader_readBits(reader, 4) + 4; /*number of code length codes. Unlike the spec, the value 4 is added to it here already*/
   
   /*read the code length codes out of 3 * (amount of code length codes) bits*/
   uivector_init(&codelengthcode);
@@ -753,11 +1428,12 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
   {
     for(i = 0; i < NUM_CODE_LENGTH_CODES; i++)
     {
-      if(i < HCLEN) codelengthcode.data[CLCL[i]] = readBitsFromStream(bp, in, 3);
+      if(i < HCLEN) codelengthcode.data[CLCL[i]] = BitReader_readBits(reader, 3);
       else codelengthcode.data[CLCL[i]] = 0; /*if not, it must stay 0*/
     }
     
     error = HuffmanTree_makeFromLengths(codelengthcodetree, codelengthcode.data, codelengthcode.size, 7);
+    if(!error && usetable) error = HuffmanTree_makeTable(codelengthcodetree);
   }
 
   uivector_cleanup(&codelengthcode);
@@ -772,7 +1448,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
   if(!bitlen.data || !bitlenD.data) error = 9912;
   else while(i < HLIT + HDIST) /*i is the current symbol we're reading in the part that contains the code lengths of lit/len codes and dist codes*/
   {
-    unsigned code = huffmanDecodeSymbol(&error, in, bp, codelengthcodetree, inlength);
+    unsigned code = usetable ? huffmanDecodeSymbolTable(&error, reader, codelengthcodetree)
+                             : huffmanDecodeSymbol(&error, reader, codelengthcodetree);
     if(error) break;
     
     if(code <= 15) /*a length code*/
@@ -786,9 +1463,9 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
       unsigned replength = 3; /*read in the 2 bits that indicate repeat length (3-6)*/
       unsigned value; /*set value to the previous code*/
       
-      if((*bp) >> 3 >= inlength) { error = 50; break; } /*error, bit pointer jumps past memory*/
+      if(BitReader_position(reader) >> 3 >= reader->size) { error = 50; break; } /*error, bit pointer jumps past memory*/
       
-      replength += readBitsFromStream(bp, in, 2);
+      replength += BitReader_readBits(reader, 2);
       
       if((i - 1) < HLIT) value = bitlen.data[i - 1];
       else value = bitlenD.data[i - HLIT - 1];
@@ -804,9 +1481,9 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
     else if(code == 17) /*repeat "0" 3-10 times*/
     {
       unsigned replength = 3; /*read in the bits that indicate repeat length*/
-      if((*bp) >> 3 >= inlength) { error = 50; break; } /*error, bit pointer jumps past memory*/
+      if(BitReader_position(reader) >> 3 >= reader->size) { error = 50; break; } /*error, bit pointer jumps past memory*/
 
-      replength += readBitsFromStream(bp, in, 3);
+      replength += BitReader_readBits(reader, 3);
       
       /*repeat this value in the next lengths*/
       for(n = 0; n < replength; n++)
@@ -820,8 +1497,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
     else if(code == 18) /*repeat "0" 11-138 times*/
     {
       unsigned replength = 11; /*read in the bits that indicate repeat length*/
-      if((*bp) >> 3 >= inlength) { error = 50; break; } /*error, bit pointer jumps past memory*/
-      replength += readBitsFromStream(bp, in, 7);
+      if(BitReader_position(reader) >> 3 >= reader->size) { error = 50; break; } /*error, bit pointer jumps past memory*/
+      replength += BitReader_readBits(reader, 7);
       
       /*repeat this value in the next lengths*/
       for(n = 0; n < replength; n++)
@@ -840,6 +1517,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
   /*now we've finally got HLIT and HDIST, so generate the code trees, and the function is done*/
   if(!error) error = HuffmanTree_makeFromLengths(codetree, &bitlen.data[0], bitlen.size, 15);
   if(!error) error = HuffmanTree_makeFromLengths(codetreeD, &bitlenD.data[0], bitlenD.size, 15);
+  if(!error && usetable) error = HuffmanTree_makeTable(codetree);
+  if(!error && usetable) error = HuffmanTree_makeTable(codetreeD);
   
   uivector_cleanup(&bitlen);
   uivector_cleanup(&bitlenD);
@@ -847,8 +1526,78 @@ static unsigned getTreeInflateDynamic(HuffmanTree* codetree, HuffmanTree* codetr
   return error;
 }
 
+/*Receives the inflated data while inflating, so the out buffer only has to hold the last 32K of it (the window
+of deflate) and what the sink did not consume yet, instead of all of it. Used by LodePNG_decodeStream.*/
+typedef struct InflateSink
+{
+  /*consume the bytes it can use of in and return how many, the others are given again in the next call*/
+  size_t (*consume)(void* data, const unsigned char* in, size_t size, unsigned* error);
+  void* data;
+  size_t done; /*position in out of the first byte not consumed yet*/
+} InflateSink;
+
+static const size_t INFLATE_WINDOW = 32768; /*the largest distance of deflate*/
+static const unsigned INFLATE_STOP = 9900; /*not an error: returned by a sink that needs no more data, to stop the inflator*/
+
+/*give the new bytes of out to the sink, then move the ones still needed to the front of out*/
+static unsigned inflateFlush(ucvector* out, size_t* pos, InflateSink* sink)
+{
+  unsigned error = 0;
+  size_t keep; /*position of the first byte still needed*/
+  
+  sink->done += sink->consume(sink->data, &out->data[sink->done], (*pos) - sink->done, &error);
+  if(error) return error;
+  
+  keep = (*pos) > INFLATE_WINDOW ? (*pos) - INFLATE_WINDOW : 0;
+  if(keep > sink->done) keep = sink->done;
+  if(keep > 0)
+  {
+    memmove(out->data, &out->data[keep], (*pos) - keep);
+    (*pos) -= keep;
+    sink->done -= keep;
+  }
+  
+  return 0;
+}
+
+/*make room for size more bytes at pos in out, by flushing to the sink if there is one, else by growing out*/
+static unsigned inflateReserve(ucvector* out, size_t* pos, size_t size, InflateSink* sink, unsigned memoryerror)
+{
+  if(sink)
+  {
+    unsigned error = inflateFlush(out, pos, sink);
+    if(error) return error;
+  }
+  if((*pos) + size > out->size) ucvector_resize(out, ((*pos) + size) * 2); /*reserve more room at once*/
+  if((*pos) + size > out->size) return memoryerror; /*not enough memory*/
+  return 0;
+}
+
+/*
+copies the length bytes from distance bytes before out to out, the bytes repeat if the distance is smaller than the
+length. 8 bytes are copied at once where they don't overlap, for a short distance after the first period of the
+repetition that is at least 8 bytes long.
+*/
+static void inflateCopyMatch(unsigned char* out, size_t distance, size_t length)
+{
+  const unsigned char* in = out - distance;
+  
+  if(distance == 1) { memset(out, in[0], length); return; }
+  if(distance < 8)
+  {
+    size_t period = distance * ((8 + distance - 1) / distance); /*a multiple of distance*/
+    size_t n = period < length ? period : length, i;
+    for(i = 0; i < n; i++) out[i] = in[i];
+    out += n;
+    length -= n;
+    in = out - period;
+  }
+  for(; length >= 8; length -= 8, out += 8, in += 8) memcpy(out, in, 8);
+  for(; length > 0; length--) *out++ = *in++;
+}
+
 /*inflate a block with dynamic of fixed Huffman tree*/
-static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength, unsigned btype)
+static unsigned inflateHuffmanBlock(ucvector* out, BitReader* reader, size_t* pos, InflateSink* sink, unsigned btype, unsigned usetable)
 {
   unsigned endreached = 0, error = 0;
   HuffmanTree codetree; /*287, the code tree for Huffman codes*/
@@ -857,24 +1606,24 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   HuffmanTree_init(&codetree);
   HuffmanTree_init(&codetreeD);
   
-  if(btype == 1) getTreeInflateFixed(&codetree, &codetreeD);
+  if(btype == 1) error = getTreeInflateFixed(&codetree, &codetreeD, usetable);
   else if(btype == 2)
   {
     HuffmanTree codelengthcodetree; /*18, the code tree for code length codes*/
     HuffmanTree_init(&codelengthcodetree);
-    error = getTreeInflateDynamic(&codetree, &codetreeD, &codelengthcodetree, in, bp, inlength);
+    error = getTreeInflateDynamic(&codetree, &codetreeD, &codelengthcodetree, reader, usetable);
     HuffmanTree_cleanup(&codelengthcodetree);
   }
   
   while(!endreached && !error)
   {
-    unsigned code = huffmanDecodeSymbol(&error, in, bp, &codetree, inlength);
+    unsigned code = usetable ? huffmanDecodeSymbolTable(&error, reader, &codetree)
+                             : huffmanDecodeSymbol(&error, reader, &codetree);
     if(error) break; /*some error happened in the above function*/
     if(code == 256) endreached = 1; /*end code*/
     else if(code <= 255) /*literal symbol*/
     {
-      if((*pos) >= out->size) ucvector_resize(out, ((*pos) + 1) * 2); /*reserve more room at once*/
-      if((*pos) >= out->size) { error = 9913; break; } /*not enough memory*/
+      if((*pos) >= out->size) { error = inflateReserve(out, pos, 1, sink, 9913); if(error) break; }
       out->data[(*pos)] = (unsigned char)(code);
       (*pos)++;
     }
@@ -883,37 +1632,31 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
       /*part 1: get length base*/
       size_t length = LENGTHBASE[code - FIRST_LENGTH_CODE_INDEX];
       unsigned codeD, distance, numextrabitsD;
-      size_t start, forward, backward, numextrabits;
+      size_t numextrabits;
       
       /*part 2: get extra bits and add the value of that to length*/
       numextrabits = LENGTHEXTRA[code - FIRST_LENGTH_CODE_INDEX];
-      if(((*bp) >> 3) >= inlength) { error = 51; break; } /*error, bit pointer will jump past memory*/
-      length += readBitsFromStream(bp, in, numextrabits);
+      if((BitReader_position(reader) >> 3) >= reader->size) { error = 51; break; } /*error, bit pointer will jump past memory*/
+      length += BitReader_readBits(reader, (unsigned)numextrabits);
       
       /*part 3: get distance code*/
-      codeD = huffmanDecodeSymbol(&error, in, bp, &codetreeD, inlength);
+      codeD = usetable ? huffmanDecodeSymbolTable(&error, reader, &codetreeD)
+                       : huffmanDecodeSymbol(&error, reader, &codetreeD);
       if(error) break;
       if(codeD > 29) { error = 18; break; } /*error: invalid distance code (30-31 are never used)*/
       distance = DISTANCEBASE[codeD];
       
       /*part 4: get extra bits from distance*/
       numextrabitsD = DISTANCEEXTRA[codeD];
-      if(((*bp) >> 3) >= inlength) { error = 51; break; } /*error, bit pointer will jump past memory*/
-      distance += readBitsFromStream(bp, in, numextrabitsD);
+      if((BitReader_position(reader) >> 3) >= reader->size) { error = 51; break; } /*error, bit pointer will jump past memory*/
+      distance += BitReader_readBits(reader, numextrabitsD);
       
       /*part 5: fill in all the out[n] values based on the length and dist*/
-      start = (*pos);
-      backward = start - distance;
-      if((*pos) + length >= out->size) ucvector_resize(out, ((*pos) + length) * 2); /*reserve more room at once*/
-      if((*pos) + length >= out->size) { error = 9914; break; } /*not enough memory*/
-      
-      for(forward = 0; forward < length; forward++)
-      {
-        out->data[(*pos)] = out->data[backward];
-        (*pos)++;
-        backward++;
-        if(backward >= start) backward = start - distance;
-      }
+      if((*pos) + length > out->size) { error = inflateReserve(out, pos, length, sink, 9914); if(error) break; }
+      /*after the reserve, because flushing to the sink moves the data*/
+      if(distance > (*pos)) { error = 52; break; } /*error: the distance goes back to before the start of the data*/
+      inflateCopyMatch(&out->data[*pos], distance, length);
+      (*pos) += length;
     }
   }
   
@@ -923,37 +1666,37 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   return error;
 }
 
-static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
+static unsigned inflateNoCompression(ucvector* out, BitReader* reader, size_t* pos, InflateSink* sink)
 {
-  /*go to first boundary of byte*/
-  size_t p;
-  unsigned LEN, NLEN, n, error = 0;
-  while(((*bp) & 0x7) != 0) (*bp)++;
-  p = (*bp) / 8; /*byte position*/
+  unsigned char lengths[4];
+  unsigned LEN, NLEN;
   
-  /*read LEN (2 bytes) and NLEN (2 bytes)*/
-  if(p >= inlength - 4) return 52; /*error, bit pointer will jump past memory*/
-  LEN = in[p] + 256 * in[p + 1]; p += 2;
-  NLEN = in[p] + 256 * in[p + 1]; p += 2;
+  /*go to first boundary of byte, and read LEN (2 bytes) and NLEN (2 bytes)*/
+  BitReader_alignToByte(reader);
+  if(!BitReader_readBytes(reader, lengths, 4)) return 52; /*error, bit pointer will jump past memory*/
+  LEN = lengths[0] + 256 * lengths[1];
+  NLEN = lengths[2] + 256 * lengths[3];
   
   /*check if 16-bit NLEN is really the one's complement of LEN*/
   if(LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
   
-  if((*pos) + LEN >= out->size) { if(!ucvector_resize(out, (*pos) + LEN)) return 9915; }
+  if((*pos) + LEN > out->size)
+  {
+    unsigned error = inflateReserve(out, pos, LEN, sink, 9915);
+    if(error) return error;
+  }
   
   /*read the literal data: LEN bytes are now stored in the out buffer*/
-  if(p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
-  for(n = 0; n < LEN; n++) out->data[(*pos)++] = in[p++];
-  
-  (*bp) = p * 8;
+  if(!BitReader_readBytes(reader, &out->data[*pos], LEN)) return 23; /*error: reading outside of in buffer*/
+  (*pos) += LEN;
   
-  return error;
+  return 0;
 }
 
-/*inflate the deflated data (cfr. deflate spec); return value is the error*/
-unsigned LodeFlate_inflate(ucvector* out, const unsigned char* in, size_t insize, size_t inpos)
+/*inflate the deflated data from the reader into out, or through out into the sink if it is not 0. Then out holds
+all the data, or the data the sink did not consume (from sink->done on) after the last part of the window.*/
+static unsigned inflateData(ucvector* out, BitReader* reader, InflateSink* sink, const LodeZlib_DecompressSettings* settings)
 {
-  size_t bp = 0; /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
   unsigned BFINAL = 0;
   size_t pos = 0; /*byte position in the out buffer*/
   
@@ -962,22 +1705,34 @@ unsigned LodeFlate_inflate(ucvector* out, const unsigned char* in, size_t insize
   while(!BFINAL)
   {
     unsigned BTYPE;
-    if((bp >> 3) >= insize) return 52; /*error, bit pointer will jump past memory*/
-    BFINAL = readBitFromStream(&bp, &in[inpos]);
-    BTYPE = 1 * readBitFromStream(&bp, &in[inpos]); BTYPE += 2 * readBitFromStream(&bp, &in[inpos]);
+    BitReader_fill(reader); /*with a source, the piece can end right before the block, e.g. at the end of an IDAT chunk*/
+    if((BitReader_position(reader) >> 3) >= reader->size) return 52; /*error, bit pointer will jump past memory*/
+    BFINAL = BitReader_readBits(reader, 1);
+    BTYPE = BitReader_readBits(reader, 2);
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
-    else if(BTYPE == 0) error = inflateNoCompression(out, &in[inpos], &bp, &pos, insize); /*no compression*/
-    else error = inflateHuffmanBlock(out, &in[inpos], &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+    else if(BTYPE == 0) error = inflateNoCompression(out, reader, &pos, sink); /*no compression*/
+    else error = inflateHuffmanBlock(out, reader, &pos, sink, BTYPE, settings->huffmanTable); /*compression, BTYPE 01 or 10*/
     if(error) return error;
   }
   
+  if(sink) error = inflateFlush(out, &pos, sink); /*the rest that is left*/
+  if(error) return error;
+  
   if(!ucvector_resize(out, pos)) error = 9916; /*Only now we know the true size of out, resize it to that*/
   
   return error;
 }
 
-#endif /*LODEPNG_COMPILE_DECODER*/
+/*inflate the deflated data (cfr. deflate spec); return value is the error*/
+unsigned LodeFlate_inflate(ucvector* out, const unsigned char* in, size_t insize, size_t inpos, const LodeZlib_DecompressSettings* settings)
+{
+  BitReader reader; /*reads the deflate data starting at inpos*/
+  BitReader_init(&reader, &in[inpos], insize - inpos);
+  return inflateData(out, &reader, 0, settings);
+}
+
+#endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
@@ -1085,137 +1840,143 @@ static void encodeLZ77_brute(uivector* out, const unsigned char* in, size_t size
 #endif
 
 static const unsigned HASH_NUM_VALUES = 65536;
-static const unsigned HASH_NUM_CHARACTERS = 6;
-static const unsigned HASH_SHIFT = 2;
+static const unsigned HASH_WINDOW = 32768; /*size of the chain array, the largest window size of deflate*/
+
+/*hash of the 3 bytes at data[pos], the minimum length of a match. pos + 3 must be <= the size of data*/
+static unsigned getHash(const unsigned char* data, size_t pos)
+{
+  unsigned value = data[pos] | ((unsigned)data[pos + 1] << 8) | ((unsigned)data[pos + 2] << 16);
+  return ((value * 2654435761u) >> 16) % HASH_NUM_VALUES; /*multiplicative hashing, the high bits are mixed best*/
+}
+
 /*
-Good and fast values: HASH_NUM_VALUES=65536, HASH_NUM_CHARACTERS=6, HASH_SHIFT=2
-making HASH_NUM_CHARACTERS larger (like 8), makes the file size larger but is a bit faster
-making HASH_NUM_CHARACTERS smaller (like 3), makes the file size smaller but is slower
+The hash chains: head has the last position with each hash value, and chain has for each position of the last
+HASH_WINDOW bytes the previous position with the same hash value. Positions are stored plus 1, so that 0 is the end.
 */
-
-static unsigned getHash(const unsigned char* data, size_t size, size_t pos)
+static void insertHash(uivector* head, uivector* chain, const unsigned char* in, size_t pos)
 {
-  unsigned result = 0;
-  size_t amount, i;
-  if(pos >= size) return 0;
-  amount = HASH_NUM_CHARACTERS; if(pos + amount >= size) amount = size - pos;
-  for(i = 0; i < amount; i++) result ^= (data[pos + i] << (i * HASH_SHIFT));
-  return result % HASH_NUM_VALUES;
+  unsigned hash = getHash(in, pos);
+  chain->data[pos % HASH_WINDOW] = head->data[hash];
+  head->data[hash] = (unsigned)(pos + 1);
 }
 
-/*LZ77-encode the data using a hash table technique to let it encode faster. Return value is error code*/
-static unsigned encodeLZ77(uivector* out, const unsigned char* in, size_t size, unsigned windowSize)
+/*
+find the longest match for the bytes at pos among the earlier positions in the hash chain, testing at most
+settings->chainLength of them. Returns the length (0 if there is no match of at least 3 bytes) and sets *distance.
+*/
+static unsigned findMatch(unsigned* distance, const unsigned char* in, size_t size, size_t pos,
+                          const uivector* head, const uivector* chain, const LodeZlib_DeflateSettings* settings)
 {
-  /**generate hash table**/
-  vector table; /*HASH_NUM_VALUES uivectors; this represents what would be an std::vector<std::vector<unsigned> > in C++*/
-  uivector tablepos1, tablepos2;
-  unsigned pos, i, error = 0;
+  unsigned length = 0, chainlength = settings->chainLength;
+  size_t windowSize = settings->windowSize < HASH_WINDOW ? settings->windowSize : HASH_WINDOW;
+  size_t maxlength = size - pos < MAX_SUPPORTED_DEFLATE_LENGTH ? size - pos : MAX_SUPPORTED_DEFLATE_LENGTH;
+  size_t nice = settings->niceMatch < maxlength ? settings->niceMatch : maxlength;
+  unsigned node;
   
-  vector_init(&table, sizeof(uivector));
-  if(!vector_resize(&table, HASH_NUM_VALUES)) return 9917;
-  for(i = 0; i < HASH_NUM_VALUES; i++)
+  if(maxlength < 3) return 0;
+  for(node = head->data[getHash(in, pos)]; node != 0 && chainlength > 0; node = chain->data[(node - 1) % HASH_WINDOW], chainlength--)
   {
-    uivector* v = (uivector*)vector_get(&table, i);
-    uivector_init(v);
+    size_t backpos = node - 1;
+    if(pos - backpos > windowSize) break; /*the rest of the chain is even further back*/
+    
+    /*a longer match must have the same byte at the current length, test that one first*/
+    if(in[backpos + length] == in[pos + length])
+    {
+      const unsigned char* back = &in[backpos];
+      const unsigned char* fore = &in[pos];
+      unsigned current = 0;
+      while(current < maxlength && back[current] == fore[current]) current++; /*backpos + current may pass pos, the match overlaps itself*/
+      if(current > length)
+      {
+        length = current;
+        *distance = (unsigned)(pos - backpos);
+        if(length >= nice) break; /*good enough, don't search any further*/
+      }
+    }
   }
+  return length >= 3 ? length : 0;
+}
 
-  /*remember start and end positions in the tables to searching in*/
-  uivector_init(&tablepos1);
-  uivector_init(&tablepos2);
-  if(!uivector_resizev(&tablepos1, HASH_NUM_VALUES, 0)) error = 9918;
-  if(!uivector_resizev(&tablepos2, HASH_NUM_VALUES, 0)) error = 9919;
+/*
+LZ77-encode the bytes in[start..size-1] using hash chains within a window of up to 32768 bytes. The bytes of the
+window before start are a dictionary the matches may refer to, the decoder already has them as the output of the
+previous part of the stream. With lazy matching, a match is only used if the next position doesn't have a longer one,
+otherwise the current byte becomes a literal. Return value is error code
+*/
+static unsigned encodeLZ77(uivector* out, const unsigned char* in, size_t start, size_t size, const LodeZlib_DeflateSettings* settings)
+{
+  uivector head, chain;
+  size_t windowSize = settings->windowSize < HASH_WINDOW ? settings->windowSize : HASH_WINDOW;
+  size_t pos = start, inserted = start < windowSize ? 0 : start - windowSize; /*the positions before inserted are in the hash chains*/
+  unsigned length, distance = 0, error = 0;
   
-  if(!error)
+  uivector_init(&head);
+  uivector_init(&chain);
+  if(!uivector_resizev(&head, HASH_NUM_VALUES, 0)) error = 9917;
+  if(!uivector_resizev(&chain, HASH_WINDOW, 0)) error = 9918;
+  
+  while(!error && pos < size)
   {
-    for(pos = 0; pos < size; pos++)
-    {
-      unsigned length = 0, offset = 0; /*the length and offset found for the current position*/
-      unsigned max_offset = pos < windowSize ? pos : windowSize; /*how far back to test*/
-      unsigned tablepos;
+    for(; inserted < pos && inserted + 3 <= size; inserted++) insertHash(&head, &chain, in, inserted);
+    length = findMatch(&distance, in, size, pos, &head, &chain, settings);
     
-      /*/search for the longest string*/
-      /*first find out where in the table to start (the first value that is in the range from "pos - max_offset" to "pos")*/
-      unsigned hash = getHash(in, size, pos);
-      if(!uivector_push_back((uivector*)vector_get(&table, hash), pos))  { error = 9920; break; }
-      
-      while(((uivector*)vector_get(&table, hash))->data[tablepos1.data[hash]] < pos - max_offset) tablepos1.data[hash]++; /*it now points to the first value in the table for which the index is larger than or equal to pos - max_offset*/
-      while(((uivector*)vector_get(&table, hash))->data[tablepos2.data[hash]] < pos) tablepos2.data[hash]++; /*it now points to the first value in the table for which the index is larger than or equal to pos*/
-
-      for(tablepos = tablepos2.data[hash] - 1; tablepos >= tablepos1.data[hash] && tablepos < tablepos2.data[hash]; tablepos--)
-      {
-        unsigned backpos = ((uivector*)vector_get(&table, hash))->data[tablepos];
-        unsigned current_offset = pos - backpos;
-
-        /*test the next characters*/
-        unsigned current_length = 0;
-        unsigned backtest = backpos;
-        unsigned foretest = pos;
-        while(foretest < size && in[backtest] == in[foretest] && current_length < MAX_SUPPORTED_DEFLATE_LENGTH) /*maximum supporte length by deflate is max length*/
-        {
-          if(backpos >= pos) backpos -= current_offset; /*continue as if we work on the decoded bytes after pos by jumping back before pos*/
-          current_length++;
-          backtest++;
-          foretest++;
-        }
-        if(current_length > length)
-        {
-          length = current_length; /*the longest length*/
-          offset = current_offset; /*the offset that is related to this longest length*/
-          if(current_length == MAX_SUPPORTED_DEFLATE_LENGTH) break; /*you can jump out of this for loop once a length of max length is found (gives significant speed gain)*/
-        }
-      }
-      
-      /**encode it as length/distance pair or literal value**/
-      if(length < 3) /*only lengths of 3 or higher are supported as length/distance pair*/
+    if(settings->lazyMatching)
+    {
+      while(length > 0 && length < settings->niceMatch && pos + 1 < size)
       {
+        unsigned nextlength, nextdistance = 0;
+        for(; inserted <= pos && inserted + 3 <= size; inserted++) insertHash(&head, &chain, in, inserted);
+        nextlength = findMatch(&nextdistance, in, size, pos + 1, &head, &chain, settings);
+        if(nextlength <= length) break;
+        
+        /*the match starting at the next byte is longer, output the current byte as literal instead*/
         if(!uivector_push_back(out, in[pos])) { error = 9921; break; }
+        pos++;
+        length = nextlength;
+        distance = nextdistance;
       }
-      else
-      {
-        unsigned j;
-        addLengthDistance(out, length, offset);
-        for(j = 0; j < length - 1; j++)
-        {
-          pos++;
-          if(!uivector_push_back((uivector*)vector_get(&table, getHash(in, size, pos)), pos)) { error = 9922; break; }
-        }
-      }
-    } /*end of the loop through each character of input*/
-  } /*end of "if(!error)"*/
-  
-  /*cleanup*/
-  for(i = 0; i < table.size; i++)
-  {
-    uivector* v = (uivector*)vector_get(&table, i);
-    uivector_cleanup(v);
+      if(error) break;
+    }
+    
+    /**encode it as length/distance pair or literal value**/
+    if(length == 0)
+    {
+      if(!uivector_push_back(out, in[pos])) { error = 9922; break; }
+      pos++;
+    }
+    else
+    {
+      addLengthDistance(out, length, distance);
+      pos += length;
+    }
   }
-  vector_cleanup(&table);
-  uivector_cleanup(&tablepos1);
-  uivector_cleanup(&tablepos2);
+  
+  uivector_cleanup(&head);
+  uivector_cleanup(&chain);
   return error;
 }
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datapos, size_t datasize, unsigned final)
 {
   /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte, 2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
   
-  size_t i, j, numdeflateblocks = datasize / 65536 + 1;
-  unsigned datapos = 0;
+  size_t i, j, numdeflateblocks = (datasize - datapos + 65534) / 65535; /*a block has at most 65535 bytes*/
+  if(numdeflateblocks == 0) numdeflateblocks = 1;
   for(i = 0; i < numdeflateblocks; i++)
   {
     unsigned BFINAL, BTYPE, LEN, NLEN;
     unsigned char firstbyte;
     
-    BFINAL = (i == numdeflateblocks - 1);
+    BFINAL = final && (i == numdeflateblocks - 1);
     BTYPE = 0;
     
     firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
     ucvector_push_back(out, firstbyte);
     
     LEN = 65535;
-    if(datasize - datapos < 65535) LEN = (unsigned)datasize - datapos;
+    if(datasize - datapos < 65535) LEN = (unsigned)(datasize - datapos);
     NLEN = 65535 - LEN;
     
     ucvector_push_back(out, (unsigned char)(LEN % 256));
@@ -1260,7 +2021,21 @@ static void writeLZ77data(size_t* bp, ucvector* out, const uivector* lz77_encode
   }
 }
 
-static unsigned deflateDynamic(ucvector* out, const unsigned char* data, size_t datasize, const LodeZlib_DeflateSettings* settings)
+/*
+add an empty stored block that isn't final, like the sync flush of zlib: the bits 0 (BFINAL) and 00 (BTYPE), zero
+bits up to the next byte, LEN 0 and NLEN 65535. The data after it starts at a byte boundary.
+*/
+static void addSyncFlush(size_t* bp, ucvector* out)
+{
+  addBitsToStream(bp, out, 0, 3);
+  ucvector_push_back(out, 0);
+  ucvector_push_back(out, 0);
+  ucvector_push_back(out, 255);
+  ucvector_push_back(out, 255);
+  *bp = out->size * 8;
+}
+
+static unsigned deflateDynamic(ucvector* out, const unsigned char* data, size_t datapos, size_t datasize, unsigned final, const LodeZlib_DeflateSettings* settings)
 {
   /*
   after the BFINAL and BTYPE, the dynamic block consists out of the following:
@@ -1285,7 +2060,7 @@ static unsigned deflateDynamic(ucvector* out, const unsigned char* data, size_t
   uivector lldll; /*lit/len & dist code lenghts*/
   uivector clcls;
   
-  unsigned BFINAL = 1; /*make only one block... the first and final one*/
+  unsigned BFINAL = final; /*make only one block... the first and final one, unless more parts of the stream follow*/
   size_t numcodes, numcodesD, i, bp = 0; /*the bit pointer*/
   unsigned HLIT, HDIST, HCLEN;
   
@@ -1304,13 +2079,13 @@ static unsigned deflateDynamic(ucvector* out, const unsigned char* data, size_t
   {
     if(settings->useLZ77)
     {
-      error = encodeLZ77(&lz77_encoded, data, datasize, settings->windowSize); /*LZ77 encoded*/
+      error = encodeLZ77(&lz77_encoded, data, datapos, datasize, settings); /*LZ77 encoded*/
       if(error) break;
     }
     else
     {
-      if(!uivector_resize(&lz77_encoded, datasize)) { error = 9923; break; }
-      for(i = 0; i < datasize; i++) lz77_encoded.data[i] = data[i]; /*no LZ77, but still will be Huffman compressed*/
+      if(!uivector_resize(&lz77_encoded, datasize - datapos)) { error = 9923; break; }
+      for(i = 0; i < datasize - datapos; i++) lz77_encoded.data[i] = data[datapos + i]; /*no LZ77, but still will be Huffman compressed*/
     }
     
     if(!uivector_resizev(&frequencies, 286, 0)) { error = 9924; break; }
@@ -1416,6 +2191,7 @@ static unsigned deflateDynamic(ucvector* out, const unsigned char* data, size_t
     writeLZ77data(&bp, out, &lz77_encoded, &codes, &codesD);
     if(HuffmanTree_getLength(&codes, 256) == 0) { error = 64; break; } /*the length of the end code 256 must be larger than 0*/
     addHuffmanSymbol(&bp, out, HuffmanTree_getCode(&codes, 256), HuffmanTree_getLength(&codes, 256)); /*end code*/
+    if(!BFINAL) addSyncFlush(&bp, out);
     
     break; /*end of error-while*/
   }
@@ -1435,12 +2211,12 @@ static unsigned deflateDynamic(ucvector* out, const unsigned char* data, size_t
   return error;
 }
 
-static unsigned deflateFixed(ucvector* out, const unsigned char* data, size_t datasize, const LodeZlib_DeflateSettings* settings)
+static unsigned deflateFixed(ucvector* out, const unsigned char* data, size_t datapos, size_t datasize, unsigned final, const LodeZlib_DeflateSettings* settings)
 {
   HuffmanTree codes; /*tree for literal values and length codes*/
   HuffmanTree codesD; /*tree for distance codes*/
   
-  unsigned BFINAL = 1; /*make only one block... the first and final one*/
+  unsigned BFINAL = final; /*make only one block... the first and final one, unless more parts of the stream follow*/
   unsigned error = 0;
   size_t i, bp = 0; /*the bit pointer*/
   
@@ -1458,15 +2234,16 @@ static unsigned deflateFixed(ucvector* out, const unsigned char* data, size_t da
   {
     uivector lz77_encoded;
     uivector_init(&lz77_encoded);
-    error = encodeLZ77(&lz77_encoded, data, datasize, settings->windowSize);
+    error = encodeLZ77(&lz77_encoded, data, datapos, datasize, settings);
     if(!error) writeLZ77data(&bp, out, &lz77_encoded, &codes, &codesD);
     uivector_cleanup(&lz77_encoded);
   }
   else /*no LZ77, but still will be Huffman compressed*/
   {
-    for(i = 0; i < datasize; i++) addHuffmanSymbol(&bp, out, HuffmanTree_getCode(&codes, data[i]), HuffmanTree_getLength(&codes, data[i]));
+    for(i = datapos; i < datasize; i++) addHuffmanSymbol(&bp, out, HuffmanTree_getCode(&codes, data[i]), HuffmanTree_getLength(&codes, data[i]));
   }
   if(!error) addHuffmanSymbol(&bp, out, HuffmanTree_getCode(&codes, 256), HuffmanTree_getLength(&codes, 256)); /*"end" code*/
+  if(!error && !BFINAL) addSyncFlush(&bp, out);
   
   /*cleanup*/
   HuffmanTree_cleanup(&codes);
@@ -1475,27 +2252,150 @@ static unsigned deflateFixed(ucvector* out, const unsigned char* data, size_t da
   return error;
 }
 
-unsigned LodeFlate_deflate(ucvector* out, const unsigned char* data, size_t datasize, const LodeZlib_DeflateSettings* settings)
+/*
+deflate the bytes data[datapos..datasize-1], the bytes before datapos are the dictionary of the LZ77 encoder. If final
+is 0, the last block doesn't have BFINAL set and the output ends at a byte boundary (with a sync flush for compressed
+blocks), so that the deflate data of the next part of the stream can be appended to it.
+*/
+static unsigned deflateRange(ucvector* out, const unsigned char* data, size_t datapos, size_t datasize, unsigned final, const LodeZlib_DeflateSettings* settings)
 {
   unsigned error = 0;
-  if(settings->btype == 0) error = deflateNoCompression(out, data, datasize);
-  else if(settings->btype == 1) error = deflateFixed(out, data, datasize, settings);
-  else if(settings->btype == 2) error = deflateDynamic(out, data, datasize, settings);
+  if(settings->btype == 0) error = deflateNoCompression(out, data, datapos, datasize, final); /*stored blocks are byte aligned already*/
+  else if(settings->btype == 1) error = deflateFixed(out, data, datapos, datasize, final, settings);
+  else if(settings->btype == 2) error = deflateDynamic(out, data, datapos, datasize, final, settings);
   else error = 61;
   return error;
 }
 
+unsigned LodeFlate_deflate(ucvector* out, const unsigned char* data, size_t datasize, const LodeZlib_DeflateSettings* settings)
+{
+  return deflateRange(out, data, 0, datasize, 1, settings);
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+#ifdef LODEPNG_SIMD_X86
+/*bytes summed before the modulo, the largest multiple of 64 not above 5552, the largest n for which 255n(n+1)/2 + (n+1)(65521-1) fits in 32 bits*/
+#define ADLER32_NMAX 5504
+
+/*horizontal sum of the 4 32-bit integers*/
+LODEPNG_TARGET("ssse3")
+static unsigned adler32_sum_epi32(__m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (unsigned)_mm_cvtsi128_si32(v);
+}
+
+/*adler32 of blocks of 32 bytes (len must be a multiple of 32). Per block, s1 gets the sum of the bytes (psadbw), and
+s2 the bytes weighted by 32..1 (pmaddubsw), plus 32 times the s1 of before the block, which is accumulated in ps.*/
+LODEPNG_TARGET("ssse3")
+static unsigned update_adler32_ssse3(unsigned adler, const unsigned char* data, size_t len)
+{
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+  const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+
+  while(len > 0)
+  {
+    size_t amount = len > ADLER32_NMAX ? ADLER32_NMAX : len;
+    size_t blocks = amount / 32;
+    __m128i ps = _mm_cvtsi32_si128((int)(s1 * blocks));
+    __m128i v1 = zero;
+    __m128i v2 = _mm_cvtsi32_si128((int)s2);
+    len -= amount;
+    while(blocks > 0)
+    {
+      const __m128i bytes1 = _mm_loadu_si128((const __m128i*)data);
+      const __m128i bytes2 = _mm_loadu_si128((const __m128i*)(data + 16));
+      ps = _mm_add_epi32(ps, v1);
+      v1 = _mm_add_epi32(v1, _mm_sad_epu8(bytes1, zero));
+      v2 = _mm_add_epi32(v2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+      v1 = _mm_add_epi32(v1, _mm_sad_epu8(bytes2, zero));
+      v2 = _mm_add_epi32(v2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+      data += 32;
+      blocks--;
+    }
+    v2 = _mm_add_epi32(v2, _mm_slli_epi32(ps, 5));
+    s1 = (s1 + adler32_sum_epi32(v1)) % 65521;
+    s2 = adler32_sum_epi32(v2) % 65521;
+  }
+
+  return (s2 << 16) | s1;
+}
+
+/*same as update_adler32_ssse3 with blocks of 64 bytes (len must be a multiple of 64) in 256-bit registers*/
+LODEPNG_TARGET("avx2")
+static unsigned update_adler32_avx2(unsigned adler, const unsigned char* data, size_t len)
+{
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+  const __m256i tap1 = _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49,
+                                        48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33);
+  const __m256i tap2 = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi16(1);
+
+  while(len > 0)
+  {
+    size_t amount = len > ADLER32_NMAX ? ADLER32_NMAX : len;
+    size_t blocks = amount / 64;
+    __m256i ps = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)(s1 * blocks));
+    __m256i v1 = zero;
+    __m256i v2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)s2);
+    len -= amount;
+    while(blocks > 0)
+    {
+      const __m256i bytes1 = _mm256_loadu_si256((const __m256i*)data);
+      const __m256i bytes2 = _mm256_loadu_si256((const __m256i*)(data + 32));
+      ps = _mm256_add_epi32(ps, v1);
+      v1 = _mm256_add_epi32(v1, _mm256_sad_epu8(bytes1, zero));
+      v2 = _mm256_add_epi32(v2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes1, tap1), ones));
+      v1 = _mm256_add_epi32(v1, _mm256_sad_epu8(bytes2, zero));
+      v2 = _mm256_add_epi32(v2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes2, tap2), ones));
+      data += 64;
+      blocks--;
+    }
+    v2 = _mm256_add_epi32(v2, _mm256_slli_epi32(ps, 6));
+    s1 = (s1 + adler32_sum_epi32(_mm_add_epi32(_mm256_castsi256_si128(v1), _mm256_extracti128_si256(v1, 1)))) % 65521;
+    s2 = adler32_sum_epi32(_mm_add_epi32(_mm256_castsi256_si128(v2), _mm256_extracti128_si256(v2, 1))) % 65521;
+  }
+
+  return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_SIMD_X86*/
+
+/*the blocks of 64 (AVX2) or 32 (SSSE3) bytes are done with SIMD if the CPU supports it, the rest byte by byte*/
 static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
 {
-   unsigned s1 = adler & 0xffff;
-   unsigned s2 = (adler >> 16) & 0xffff;
+   unsigned s1, s2;
    
+#ifdef LODEPNG_SIMD_X86
+  if(len >= 64 && (LodePNG_cpuFeatures() & CPU_AVX2))
+  {
+    unsigned amount = len & ~63u;
+    adler = update_adler32_avx2(adler, data, amount);
+    data += amount;
+    len -= amount;
+  }
+  if(len >= 32 && (LodePNG_cpuFeatures() & CPU_SSSE3))
+  {
+    unsigned amount = len & ~31u;
+    adler = update_adler32_ssse3(adler, data, amount);
+    data += amount;
+    len -= amount;
+  }
+#endif /*LODEPNG_SIMD_X86*/
+  s1 = adler & 0xffff;
+  s2 = (adler >> 16) & 0xffff;
   while(len > 0)
   {
     /*at least 5550 sums can be done before the sums overflow, saving us from a lot of module divisions*/
@@ -1520,6 +2420,27 @@ static unsigned adler32(const unsigned char* data, unsigned len)
   return update_adler32(1L, data, len);
 }
 
+#ifdef LODEPNG_COMPILE_ENCODER
+/*
+Return the adler32 of the bytes A followed by the len2 bytes B, from adler1 of A and adler2 of B. The sum s1 of B
+starts at 1 instead of s1 of A, and s2 of B misses len2 times s1 of A, so both are corrected modulo 65521.
+*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+  const unsigned BASE = 65521;
+  unsigned rem = (unsigned)(len2 % BASE);
+  unsigned s1 = adler1 & 0xffff;
+  unsigned s2 = (rem * s1) % BASE;
+  s1 += (adler2 & 0xffff) + BASE - 1;
+  s2 += (adler1 >> 16) + (adler2 >> 16) + BASE - rem;
+  if(s1 >= BASE) s1 -= BASE;
+  if(s1 >= BASE) s1 -= BASE;
+  if(s2 >= 2 * BASE) s2 -= 2 * BASE;
+  if(s2 >= BASE) s2 -= BASE;
+  return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_COMPILE_ENCODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Reading and writing single bits and bytes from/to stream for Zlib      / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -1545,15 +2466,13 @@ unsigned LodeZlib_read32bitInt(const unsigned char* buffer)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned LodeZlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DecompressSettings* settings)
+/*check the 2 bytes of the zlib header, return value is error*/
+static unsigned LodeZlib_checkHeader(const unsigned char* in)
 {
-  unsigned error = 0;
   unsigned CM, CINFO, FDICT;
-  ucvector outv;
   
-  if(insize < 2) { error = 53; return error; } /*error, size of zlib data too small*/
   /*read information from zlib header*/
-  if((in[0] * 256 + in[1]) % 31 != 0) { error = 24; return error; } /*error: 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way*/
+  if((in[0] * 256 + in[1]) % 31 != 0) return 24; /*error: 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way*/
 
   CM = in[0] & 15;
   CINFO = (in[0] >> 4) & 15;
@@ -1561,11 +2480,23 @@ unsigned LodeZlib_decompress(unsigned char** out, size_t* outsize, const unsigne
   FDICT = (in[1] >> 5) & 1;
   /*FLEVEL = (in[1] >> 6) & 3; //not really important, all it does it to give a compiler warning about unused variable, we don't care what encoding setting the encoder used*/
   
-  if(CM != 8 || CINFO > 7) { error = 25; return error; } /*error: only compression method 8: inflate with sliding window of 32k is supported by the PNG spec*/
-  if(FDICT != 0) { error = 26; return error; } /*error: the specification of PNG says about the zlib stream: "The additional flags shall not specify a preset dictionary."*/
+  if(CM != 8 || CINFO > 7) return 25; /*error: only compression method 8: inflate with sliding window of 32k is supported by the PNG spec*/
+  if(FDICT != 0) return 26; /*error: the specification of PNG says about the zlib stream: "The additional flags shall not specify a preset dictionary."*/
+  
+  return 0;
+}
+
+unsigned LodeZlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DecompressSettings* settings)
+{
+  unsigned error = 0;
+  ucvector outv;
+  
+  if(insize < 2) { error = 53; return error; } /*error, size of zlib data too small*/
+  error = LodeZlib_checkHeader(in);
+  if(error) return error;
   
   ucvector_init_buffer(&outv, *out, *outsize); /*ucvector-controlled version of the output buffer, for dynamic array*/
-  error = LodeFlate_inflate(&outv, in, insize, 2);
+  error = LodeFlate_inflate(&outv, in, insize, 2, settings);
   *out = outv.data;
   *outsize = outv.size;
   if(error) return error;
@@ -1584,14 +2515,78 @@ unsigned LodeZlib_decompress(unsigned char** out, size_t* outsize, const unsigne
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
-unsigned LodeZlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DeflateSettings* settings)
+/*
+the deflate data of the stream is made of segments that are deflated independently, each on its own thread (like pigz):
+every segment but the last ends with a sync flush at a byte boundary, and uses the 32768 bytes before it as dictionary,
+so the segments are simply concatenated and it costs only a few bytes per segment. The Adler-32 checksums of the
+segments are computed on the same threads and combined.
+*/
+#define DEFLATE_MIN_SEGMENT 131072 /*smaller segments would lose more with their own Huffman trees than the threads gain*/
+
+typedef struct DeflateSegment
 {
-  /*initially, *out must be NULL and outsize 0, if you just give some random *out that's pointing to a non allocated buffer, this'll crash*/
-  ucvector deflatedata, outv;
-  size_t i;
+  const unsigned char* in; /*all the data, the bytes before start are the dictionary*/
+  size_t start, end;
+  unsigned final;
+  const LodeZlib_DeflateSettings* settings;
+  ucvector out;
+  unsigned adler;
   unsigned error;
+} DeflateSegment;
+
+static void deflateSegment(void* data, unsigned index)
+{
+  DeflateSegment* segment = &((DeflateSegment*)data)[index];
+  ucvector_init(&segment->out); /*here, so that it's made with the allocator of the thread that uses it*/
+  segment->error = deflateRange(&segment->out, segment->in, segment->start, segment->end, segment->final, segment->settings);
+  segment->adler = adler32(&segment->in[segment->start], (unsigned)(segment->end - segment->start));
+}
+
+/*
+deflate in[start..end-1] with up to numThreads threads (0 means one per CPU), splitting it into segments at multiples of
+unit bytes from start, e.g. the scanlines of an image. The bytes before start are the dictionary of the first segment.
+The deflate data is appended to out and *adler is updated with the bytes. Only the last segment is final if final is
+set, otherwise the data ends with a sync flush so that more deflate data can follow.
+*/
+static unsigned deflateSegments(ucvector* out, unsigned* adler, const unsigned char* in, size_t start, size_t end, unsigned final,
+                                const LodeZlib_DeflateSettings* settings, unsigned numThreads, size_t unit)
+{
+  size_t size = end - start, numUnits = size / (unit > 0 ? unit : 1), maxSegments = size / DEFLATE_MIN_SEGMENT, outsize;
+  unsigned error = 0, numSegments, s;
+  DeflateSegment* segments;
+  
+  numSegments = LodePNG_threadCount(numThreads, numUnits < maxSegments ? (unsigned)numUnits : (unsigned)maxSegments);
+  segments = (DeflateSegment*)LodePNG_malloc(numSegments * sizeof(DeflateSegment));
+  if(!segments) return 9958;
+  for(s = 0; s < numSegments; s++)
+  {
+    segments[s].in = in;
+    segments[s].start = s == 0 ? start : start + (numUnits * s / numSegments) * unit;
+    segments[s].end = s == numSegments - 1 ? end : start + (numUnits * (s + 1) / numSegments) * unit;
+    segments[s].final = final && s == numSegments - 1;
+    segments[s].settings = settings;
+    segments[s].error = 0;
+  }
+  LodePNG_parallelFor(deflateSegment, segments, numSegments, numSegments);
+  
+  for(s = 0; s < numSegments; s++)
+  {
+    if(segments[s].error) { error = segments[s].error; break; }
+    *adler = adler32_combine(*adler, segments[s].adler, segments[s].end - segments[s].start);
+    outsize = out->size;
+    if(!ucvector_resize(out, outsize + segments[s].out.size)) { error = 9964; break; }
+    if(segments[s].out.size) memcpy(&out->data[outsize], segments[s].out.data, segments[s].out.size);
+  }
   
-  unsigned ADLER32;
+  for(s = 0; s < numSegments; s++) ucvector_cleanup(&segments[s].out);
+  LodePNG_free(segments);
+  
+  return error;
+}
+
+/*the 2 bytes in front of the deflate data of a zlib stream*/
+static void addZlibHeader(ucvector* out)
+{
   /*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
   unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
   unsigned FLEVEL = 0;
@@ -1600,21 +2595,27 @@ unsigned LodeZlib_compress(unsigned char** out, size_t* outsize, const unsigned
   unsigned FCHECK = 31 - CMFFLG % 31;
   CMFFLG += FCHECK;
   
-  ucvector_init_buffer(&outv, *out, *outsize); /*ucvector-controlled version of the output buffer, for dynamic array*/
-  
-  ucvector_push_back(&outv, (unsigned char)(CMFFLG / 256));
-  ucvector_push_back(&outv, (unsigned char)(CMFFLG % 256));
+  ucvector_push_back(out, (unsigned char)(CMFFLG / 256));
+  ucvector_push_back(out, (unsigned char)(CMFFLG % 256));
+}
+
+/*
+zlib-compress in with up to numThreads threads (0 means one per CPU), splitting it into segments at multiples of unit
+bytes, e.g. the scanlines of an image. With one segment the result is the same as a single deflate of the data.
+*/
+static unsigned zlibCompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DeflateSettings* settings,
+                             unsigned numThreads, size_t unit)
+{
+  /*initially, *out must be NULL and outsize 0, if you just give some random *out that's pointing to a non allocated buffer, this'll crash*/
+  ucvector outv;
+  unsigned error = 0;
+  unsigned ADLER32 = 1;
   
-  ucvector_init(&deflatedata);
-  error = LodeFlate_deflate(&deflatedata, in, insize, settings);
+  ucvector_init_buffer(&outv, *out, *outsize); /*ucvector-controlled version of the output buffer, for dynamic array*/
   
-  if(!error)
-  {
-    ADLER32 = adler32(in, (unsigned)insize);
-    for(i = 0; i < deflatedata.size; i++) ucvector_push_back(&outv, deflatedata.data[i]);
-    ucvector_cleanup(&deflatedata);
-    LodeZlib_add32bitInt(&outv, ADLER32);
-  }
+  addZlibHeader(&outv);
+  error = deflateSegments(&outv, &ADLER32, in, 0, insize, 1, settings, numThreads, unit);
+  if(!error) LodeZlib_add32bitInt(&outv, ADLER32);
   
   *out = outv.data;
   *outsize = outv.size;
@@ -1622,6 +2623,11 @@ unsigned LodeZlib_compress(unsigned char** out, size_t* outsize, const unsigned
   return error;
 }
 
+unsigned LodeZlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DeflateSettings* settings)
+{
+  return zlibCompress(out, outsize, in, insize, settings, 1, 1);
+}
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #endif /*LODEPNG_COMPILE_ZLIB*/
@@ -1634,10 +2640,37 @@ void LodeZlib_DeflateSettings_init(LodeZlib_DeflateSettings* settings)
 {
   settings->btype = 2; /*compress with dynamic huffman tree (not in the mathematical sense, just not the predefined one)*/
   settings->useLZ77 = 1;
-  settings->windowSize = 2048; /*this is a good tradeoff between speed and compression ratio*/
+  settings->windowSize = 32768;
+  settings->chainLength = 128; /*the same as LodeZlib_DeflateSettings_setLevel with level 6*/
+  settings->niceMatch = 128;
+  settings->lazyMatching = 1;
 }
 
-const LodeZlib_DeflateSettings LodeZlib_defaultDeflateSettings = {2, 1, 2048};
+const LodeZlib_DeflateSettings LodeZlib_defaultDeflateSettings = {2, 1, 32768, 128, 128, 1};
+
+/*chainLength, niceMatch and lazyMatching of the levels 1 to 9, similar to zlib*/
+static const unsigned DEFLATE_LEVELS[9][3] =
+{
+  {   4,   8, 0}, {   8,  16, 0}, {  32,  32, 0},
+  {  16,  16, 1}, {  32,  32, 1}, { 128, 128, 1},
+  { 256, 128, 1}, {1024, 258, 1}, {4096, 258, 1}
+};
+
+void LodeZlib_DeflateSettings_setLevel(LodeZlib_DeflateSettings* settings, unsigned level)
+{
+  if(level > 9) level = 9;
+  settings->useLZ77 = 1;
+  settings->windowSize = 32768;
+  if(level == 0)
+  {
+    settings->btype = 0; /*no compression at all*/
+    return;
+  }
+  settings->btype = 2;
+  settings->chainLength = DEFLATE_LEVELS[level - 1][0];
+  settings->niceMatch = DEFLATE_LEVELS[level - 1][1];
+  settings->lazyMatching = DEFLATE_LEVELS[level - 1][2];
+}
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
@@ -1646,9 +2679,10 @@ const LodeZlib_DeflateSettings LodeZlib_defaultDeflateSettings = {2, 1, 2048};
 void LodeZlib_DecompressSettings_init(LodeZlib_DecompressSettings* settings)
 {
   settings->ignoreAdler32 = 0;
+  settings->huffmanTable = 1;
 }
 
-const LodeZlib_DecompressSettings LodeZlib_defaultDecompressSettings = {0};
+const LodeZlib_DecompressSettings LodeZlib_defaultDecompressSettings = {0, 1};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -1689,16 +2723,23 @@ static unsigned LodePNG_compress(unsigned char** out, size_t* outsize, const uns
 {
   return LodeZlib_compress(out, outsize, in, insize, settings);
 }
+
+/*compress the scanlines with up to numThreads threads, the segments of the zlib stream start at a scanline*/
+static unsigned LodePNG_compressParallel(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DeflateSettings* settings,
+                                         unsigned numThreads, size_t linebytes)
+{
+  return zlibCompress(out, outsize, in, insize, settings, numThreads, linebytes);
+}
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / CRC32                                                                  / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-static unsigned Crc32_crc_table_computed = 0;
-static unsigned Crc32_crc_table[256];
+static LodePNG_Once Crc32_crc_table_once = LODEPNG_ONCE_INIT;
+static unsigned Crc32_crc_table[8][256]; /*[0] is the byte table, [k] advances a byte k more bytes for slicing-by-8*/
 
-/*Make the table for a fast CRC.*/
+/*Make the tables for a fast CRC.*/
 static void Crc32_make_crc_table(void)
 {
   unsigned c, k, n;
@@ -1710,23 +2751,133 @@ static void Crc32_make_crc_table(void)
       if(c & 1) c = 0xedb88320L ^ (c >> 1);
       else c = c >> 1;
     }
-    Crc32_crc_table[n] = c;
+    Crc32_crc_table[0][n] = c;
+  }
+  for(n = 0; n < 256; n++)
+  {
+    c = Crc32_crc_table[0][n];
+    for(k = 1; k < 8; k++)
+    {
+      c = Crc32_crc_table[0][c & 0xff] ^ (c >> 8);
+      Crc32_crc_table[k][n] = c;
+    }
+  }
+}
+
+#ifdef LODEPNG_SIMD_X86
+/*CRC of len bytes (at least 64, a multiple of 16) by folding 4 x 128 bits at once with carry-less multiplication, then
+Barrett reduction, see "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Intel. The
+constants are the bit-reflected powers of x modulo the CRC32 polynomial given there. crc is the running CRC.*/
+LODEPNG_TARGET("pclmul,sse4.1")
+static unsigned Crc32_update_crc_pclmul(const unsigned char* buf, unsigned crc, size_t len)
+{
+  const __m128i k1k2 = _mm_set_epi32(0x00000001, 0xc6e41596, 0x00000001, 0x54442bd4);
+  const __m128i k3k4 = _mm_set_epi32(0x00000000, 0xccaa009e, 0x00000001, 0x751997d0);
+  const __m128i k5k0 = _mm_set_epi32(0x00000000, 0x00000000, 0x00000001, 0x63cd6124);
+  const __m128i poly = _mm_set_epi32(0x00000001, 0xf7011641, 0x00000001, 0xdb710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  buf += 64;
+  len -= 64;
+
+  /*fold 4 blocks of 128 bits in parallel*/
+  while(len >= 64)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(buf + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 0x30)));
+    buf += 64;
+    len -= 64;
+  }
+
+  /*fold the 4 blocks into 1*/
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /*fold the remaining blocks of 128 bits*/
+  while(len >= 16)
+  {
+    x2 = _mm_loadu_si128((const __m128i*)buf);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    buf += 16;
+    len -= 16;
   }
-  Crc32_crc_table_computed = 1;
+
+  /*fold 128 bits to 64 bits*/
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /*Barrett reduction to 32 bits*/
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (unsigned)_mm_extract_epi32(x1, 1);
 }
+#endif /*LODEPNG_SIMD_X86*/
 
 /*Update a running CRC with the bytes buf[0..len-1]--the CRC should be 
 initialized to all 1's, and the transmitted value is the 1's complement of the
-final running CRC (see the crc() routine below).*/
+final running CRC (see the crc() routine below).
+8 bytes are processed at once with the slicing-by-8 tables, or 64 with PCLMULQDQ if the CPU supports it.*/
 static unsigned Crc32_update_crc(const unsigned char* buf, unsigned crc, size_t len)
 {
   unsigned c = crc;
-  size_t n;
 
-  if(!Crc32_crc_table_computed) Crc32_make_crc_table();
-  for(n = 0; n < len; n++)
+  LodePNG_callOnce(&Crc32_crc_table_once, Crc32_make_crc_table);
+#ifdef LODEPNG_SIMD_X86
+  if(len >= 64 && (LodePNG_cpuFeatures() & (CPU_PCLMUL | CPU_SSE41)) == (CPU_PCLMUL | CPU_SSE41))
+  {
+    size_t size = len & ~(size_t)15;
+    c = Crc32_update_crc_pclmul(buf, c, size);
+    buf += size;
+    len -= size;
+  }
+#endif /*LODEPNG_SIMD_X86*/
+  while(len >= 8)
+  {
+    c ^= buf[0] | ((unsigned)buf[1] << 8) | ((unsigned)buf[2] << 16) | ((unsigned)buf[3] << 24);
+    c = Crc32_crc_table[7][c & 0xff] ^ Crc32_crc_table[6][(c >> 8) & 0xff]
+      ^ Crc32_crc_table[5][(c >> 16) & 0xff] ^ Crc32_crc_table[4][(c >> 24) & 0xff]
+      ^ Crc32_crc_table[3][buf[4]] ^ Crc32_crc_table[2][buf[5]]
+      ^ Crc32_crc_table[1][buf[6]] ^ Crc32_crc_table[0][buf[7]];
+    buf += 8;
+    len -= 8;
+  }
+  while(len > 0)
   {
-    c = Crc32_crc_table[(c ^ buf[n]) & 0xff] ^ (c >> 8);
+    c = Crc32_crc_table[0][(c ^ *buf) & 0xff] ^ (c >> 8);
+    buf++;
+    len--;
   }
   return c;
 }
@@ -2289,34 +3440,140 @@ unsigned LodePNG_InfoRaw_copy(LodePNG_InfoRaw* dest, const LodePNG_InfoRaw* sour
 
 /* ////////////////////////////////////////////////////////////////////////// */
 
+#ifdef LODEPNG_SIMD_X86
+/*
+pshufb masks of convertToRGBA8SSSE3 for 4 pixels: the first 16 bytes pick the bytes of the output from the 16 bytes at
+the pixels, the last 16 from the 16 bytes that end at the 4th pixel, for pixels of more than 4 bytes. -1 gives a 0 byte,
+alpha is or'ed in after. The channels of 16-bit pixels are their most significant bytes, which come first.
+*/
+static const signed char CONVERT_GREY8[32] = { 0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1 };
+static const signed char CONVERT_RGB8[32] = { 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 };
+static const signed char CONVERT_GREYALPHA8[32] = { 0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7 };
+static const signed char CONVERT_GREY16[32] = { 0, 0, 0, -1, 2, 2, 2, -1, 4, 4, 4, -1, 6, 6, 6, -1 };
+static const signed char CONVERT_GREYALPHA16[32] = { 0, 0, 0, 2, 4, 4, 4, 6, 8, 8, 8, 10, 12, 12, 12, 14 };
+static const signed char CONVERT_RGB16[32] = { 0, 2, 4, -1, 6, 8, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                               -1, -1, -1, -1, -1, -1, -1, -1, 4, 6, 8, -1, 10, 12, 14, -1 };
+static const signed char CONVERT_RGBA16[32] = { 0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                -1, -1, -1, -1, -1, -1, -1, -1, 0, 2, 4, 6, 8, 10, 12, 14 };
+
+/*
+converts 4 pixels of inbytes bytes at a time to RGBA with 8 bits with the shuffle masks, returns how many pixels it
+did, it doesn't read past the end of in. If opaque, alpha is 255, or 0 for the pixels equal to keypixel if keyed.
+*/
+LODEPNG_TARGET("ssse3")
+static size_t convertToRGBA8SSSE3(unsigned char* out, const unsigned char* in, size_t numpixels, size_t inbytes,
+                                  const signed char* mask, unsigned opaque, unsigned keyed, unsigned keypixel)
+{
+  const __m128i masklo = _mm_loadu_si128((const __m128i*)mask);
+  const __m128i maskhi = _mm_loadu_si128((const __m128i*)(mask + 16));
+  const __m128i alpha = _mm_set1_epi32(opaque ? (int)0xff000000u : 0);
+  const __m128i key = _mm_set1_epi32((int)keypixel);
+  const size_t step = 4 * inbytes; /*input bytes of 4 pixels*/
+  const size_t window = step > 16 ? step : 16; /*input bytes read for 4 pixels*/
+  size_t i = 0;
+  for(; i * inbytes + window <= numpixels * inbytes; i += 4)
+  {
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&in[i * inbytes]), masklo);
+    if(step > 16) x = _mm_or_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&in[i * inbytes + step - 16]), maskhi));
+    x = _mm_or_si128(x, alpha);
+    if(keyed) x = _mm_andnot_si128(_mm_and_si128(_mm_cmpeq_epi32(x, key), alpha), x);
+    _mm_storeu_si128((__m128i*)&out[4 * i], x);
+  }
+  return i;
+}
+
+/*
+palette indices to RGBA with 8 bits, the colors of 8 pixels are gathered from the palette at once. It stops before the
+first 8 pixels with an index outside of the palette, so the scalar loop gives the error.
+*/
+LODEPNG_TARGET("avx2")
+static size_t convertPaletteToRGBA8AVX2(unsigned char* out, const unsigned char* in, size_t numpixels, const unsigned char* palette, size_t palettesize)
+{
+  const __m256i last = _mm256_set1_epi32((int)palettesize - 1);
+  size_t i = 0;
+  for(; i + 8 <= numpixels; i += 8)
+  {
+    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&in[i]));
+    if(!_mm256_testz_si256(_mm256_cmpgt_epi32(index, last), _mm256_cmpgt_epi32(index, last))) break;
+    _mm256_storeu_si256((__m256i*)&out[4 * i], _mm256_i32gather_epi32((const int*)palette, index, 4));
+  }
+  return i;
+}
+
+/*
+converts the pixels of the common 8-bit and 16-bit color types to RGBA with 8 bits with SIMD, if the CPU supports it.
+Returns how many pixels, from the start, it did, the scalar loops of LodePNG_convert do the rest. 16-bit color keys
+are compared with both bytes, those are left to the scalar loops.
+*/
+static size_t convertToRGBA8SIMD(unsigned char* out, const unsigned char* in, const LodePNG_InfoColor* infoIn, size_t numpixels)
+{
+  unsigned features = LodePNG_cpuFeatures();
+  unsigned key = infoIn->key_defined;
+  
+  if(infoIn->colorType == 3 && infoIn->bitDepth == 8)
+  {
+    if(!(features & CPU_AVX2) || infoIn->palettesize == 0) return 0;
+    return convertPaletteToRGBA8AVX2(out, in, numpixels, infoIn->palette, infoIn->palettesize);
+  }
+  if(!(features & CPU_SSSE3)) return 0;
+  if(infoIn->bitDepth == 8)
+  {
+    switch(infoIn->colorType)
+    {
+      /*a key with a value above 255 matches no pixel*/
+      case 0: return convertToRGBA8SSSE3(out, in, numpixels, 1, CONVERT_GREY8, 1, key && infoIn->key_r < 256, infoIn->key_r * 0x010101u | 0xff000000u);
+      case 2: return convertToRGBA8SSSE3(out, in, numpixels, 3, CONVERT_RGB8, 1, key && infoIn->key_r < 256 && infoIn->key_g < 256 && infoIn->key_b < 256,
+                                         infoIn->key_r | (infoIn->key_g << 8) | (infoIn->key_b << 16) | 0xff000000u);
+      case 4: return convertToRGBA8SSSE3(out, in, numpixels, 2, CONVERT_GREYALPHA8, 0, 0, 0);
+      default: return 0;
+    }
+  }
+  if(infoIn->bitDepth == 16)
+  {
+    switch(infoIn->colorType)
+    {
+      case 0: return key ? 0 : convertToRGBA8SSSE3(out, in, numpixels, 2, CONVERT_GREY16, 1, 0, 0);
+      case 2: return key ? 0 : convertToRGBA8SSSE3(out, in, numpixels, 6, CONVERT_RGB16, 1, 0, 0);
+      case 4: return convertToRGBA8SSSE3(out, in, numpixels, 4, CONVERT_GREYALPHA16, 0, 0, 0);
+      case 6: return convertToRGBA8SSSE3(out, in, numpixels, 8, CONVERT_RGBA16, 0, 0, 0);
+      default: return 0;
+    }
+  }
+  return 0;
+}
+#endif /*LODEPNG_SIMD_X86*/
+
 /*
 converts from any color type to 24-bit or 32-bit (later maybe more supported). return value = LodePNG error code
 the out buffer must have (w * h * bpp + 7) / 8 bytes, where bpp is the bits per pixel of the output color type (LodePNG_InfoColor_getBpp)
 for < 8 bpp images, there may _not_ be padding bits at the end of scanlines.
 */
-unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_InfoColor* infoOut, LodePNG_InfoColor* infoIn, unsigned w, unsigned h)
+unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, const LodePNG_InfoColor* infoOut, const LodePNG_InfoColor* infoIn, unsigned w, unsigned h)
 {
-  const size_t numpixels = w * h; /*amount of pixels*/
+  const size_t numpixels = (size_t)w * h; /*amount of pixels*/
   const unsigned OUT_BYTES = LodePNG_InfoColor_getBpp(infoOut) / 8; /*bytes per pixel in the output image*/
   const unsigned OUT_ALPHA = LodePNG_InfoColor_isAlphaType(infoOut); /*use 8-bit alpha channel*/
   size_t i, c, bp = 0; /*bitpointer, used by less-than-8-bit color types*/
+  size_t first = 0; /*the first pixel of the 8-bit and 16-bit loops, the ones before are done with SIMD*/
   
   /*cases where in and out already have the same format*/
   if(LodePNG_InfoColor_equal(infoIn, infoOut))
   {
-    size_t i, size = (w * h * LodePNG_InfoColor_getBpp(infoIn) + 7) / 8;
-    for(i = 0; i < size; i++) out[i] = in[i];
+    memcpy(out, in, (numpixels * LodePNG_InfoColor_getBpp(infoIn) + 7) / 8);
     return 0;
   }
 
   if((infoOut->colorType == 2 || infoOut->colorType == 6) && infoOut->bitDepth == 8)
   {
+#ifdef LODEPNG_SIMD_X86
+    if(OUT_ALPHA) first = convertToRGBA8SIMD(out, in, infoIn, numpixels);
+#endif /*LODEPNG_SIMD_X86*/
     if(infoIn->bitDepth == 8)
     {
       switch(infoIn->colorType)
       {
         case 0: /*greyscale color*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = 255;
             out[OUT_BYTES * i + 0] = out[OUT_BYTES * i + 1] = out[OUT_BYTES * i + 2] = in[i];
@@ -2324,7 +3581,7 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
           }
         break;
         case 2: /*RGB color*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = 255;
             for(c = 0; c < 3; c++) out[OUT_BYTES * i + c] = in[3 * i + c];
@@ -2332,7 +3589,7 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
           }
         break;
         case 3: /*indexed color (palette)*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = 255;
             if(in[i] >= infoIn->palettesize) return 46;
@@ -2340,14 +3597,14 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
           }
         break;
         case 4: /*greyscale with alpha*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             out[OUT_BYTES * i + 0] = out[OUT_BYTES * i + 1] = out[OUT_BYTES * i + 2] = in[2 * i + 0];
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = in[2 * i + 1];
           }
         break;
         case 6: /*RGB with alpha*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             for(c = 0; c < OUT_BYTES; c++) out[OUT_BYTES * i + c] = in[4 * i + c];
           }
@@ -2360,15 +3617,15 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
       switch(infoIn->colorType)
       {
         case 0: /*greyscale color*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = 255;
             out[OUT_BYTES * i + 0] = out[OUT_BYTES * i + 1] = out[OUT_BYTES * i + 2] = in[2 * i];
-            if(OUT_ALPHA && infoIn->key_defined && 256U * in[i] + in[i + 1] == infoIn->key_r) out[OUT_BYTES * i + 3] = 0;
+            if(OUT_ALPHA && infoIn->key_defined && 256U * in[2 * i] + in[2 * i + 1] == infoIn->key_r) out[OUT_BYTES * i + 3] = 0;
           }
         break;
         case 2: /*RGB color*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = 255;
             for(c = 0; c < 3; c++) out[OUT_BYTES * i + c] = in[6 * i + 2 * c];
@@ -2376,14 +3633,14 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
           }
         break;
         case 4: /*greyscale with alpha*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             out[OUT_BYTES * i + 0] = out[OUT_BYTES * i + 1] = out[OUT_BYTES * i + 2] = in[4 * i]; /*most significant byte*/
             if(OUT_ALPHA) out[OUT_BYTES * i + 3] = in[4 * i + 2];
           }
         break;
         case 6: /*RGB with alpha*/
-          for(i = 0; i < numpixels; i++)
+          for(i = first; i < numpixels; i++)
           {
             for(c = 0; c < OUT_BYTES; c++) out[OUT_BYTES * i + c] = in[8 * i + 2 * c];
           }
@@ -2452,7 +3709,7 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
           {
             if(OUT_ALPHA) out[OUT_BYTES * i + 1] = 255;
             out[OUT_BYTES * i] = in[2 * i];
-            if(OUT_ALPHA && infoIn->key_defined && 256U * in[i] + in[i + 1] == infoIn->key_r) out[OUT_BYTES * i + 1] = 0;
+            if(OUT_ALPHA && infoIn->key_defined && 256U * in[2 * i] + in[2 * i + 1] == infoIn->key_r) out[OUT_BYTES * i + 1] = 0;
           }
         break;
         case 4: /*greyscale with alpha*/
@@ -2478,6 +3735,16 @@ unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_In
       }
     }
   }
+  else if(infoOut->colorType == 3 && infoOut->bitDepth == 8) /*palette indices of less than 8 bits to one byte each*/
+  {
+    if(infoIn->colorType != 3) return 59;
+    for(i = 0; i < numpixels; i++)
+    {
+      unsigned value = readBitsFromReversedStream(&bp, in, infoIn->bitDepth);
+      if(value >= infoIn->palettesize) return 47;
+      out[i] = (unsigned char)value;
+    }
+  }
   else return 59;
   
   return 0;
@@ -2496,16 +3763,43 @@ static int paethPredictor(int a, int b, int c)
   else return c;
 }
 
+#ifdef LODEPNG_SIMD_X86
+/*paethPredictor for 8 values in 16-bit lanes, a, b and c must be 0-255*/
+LODEPNG_TARGET("sse2")
+static __m128i paethPredictorSSE2(__m128i a, __m128i b, __m128i c)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i pa = _mm_sub_epi16(b, c); /*|p - a| with p = a + b - c*/
+  __m128i pb = _mm_sub_epi16(a, c); /*|p - b|*/
+  __m128i pc = _mm_add_epi16(pa, pb); /*|p - c|*/
+  __m128i smallest, nearest, mask;
+  pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+  pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+  pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+  smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+  /*a if pa is the smallest, else b if pb is, else c*/
+  mask = _mm_cmpeq_epi16(smallest, pb);
+  nearest = _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, c));
+  mask = _mm_cmpeq_epi16(smallest, pa);
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, nearest));
+}
+#endif /*LODEPNG_SIMD_X86*/
+
 /*shared values used by multiple Adam7 related functions*/
 
 static const unsigned ADAM7_IX[7] = { 0, 4, 0, 2, 0, 1, 0 }; /*x start values*/
 static const unsigned ADAM7_IY[7] = { 0, 0, 4, 0, 2, 0, 1 }; /*y start values*/
 static const unsigned ADAM7_DX[7] = { 8, 8, 4, 4, 2, 2, 1 }; /*x delta values*/
 static const unsigned ADAM7_DY[7] = { 8, 8, 8, 4, 4, 2, 2 }; /*y delta values*/
+static const unsigned ADAM7_GRIDX[7] = { 8, 4, 4, 2, 2, 1, 1 }; /*x distance of the pixels known after the first 1-7 passes*/
+static const unsigned ADAM7_GRIDY[7] = { 8, 8, 4, 4, 2, 2, 1 }; /*y distance of the pixels known after the first 1-7 passes*/
 
-static void Adam7_getpassvalues(unsigned passw[7], unsigned passh[7], size_t filter_passstart[8], size_t padded_passstart[8], size_t passstart[8], unsigned w, unsigned h, unsigned bpp)
+/*the sizes are computed in size_t, because the product of the 32-bit sizes of the header can overflow an unsigned.
+return value is error 77 if even a size_t overflows, then the passstart values must not be used*/
+static unsigned Adam7_getpassvalues(unsigned passw[7], unsigned passh[7], size_t filter_passstart[8], size_t padded_passstart[8], size_t passstart[8], unsigned w, unsigned h, unsigned bpp)
 {
   /*the passstart values have 8 values: the 8th one actually indicates the byte after the end of the 7th (= last) pass*/
+  static const size_t maxsize = (size_t)(-1);
   unsigned i;
   
   /*calculate width and height in pixels of each pass*/
@@ -2520,10 +3814,19 @@ static void Adam7_getpassvalues(unsigned passw[7], unsigned passh[7], size_t fil
   filter_passstart[0] = padded_passstart[0] = passstart[0] = 0;
   for(i = 0; i < 7; i++)
   {
-    filter_passstart[i + 1] = filter_passstart[i] + ((passw[i] && passh[i]) ? passh[i] * (1 + (passw[i] * bpp + 7) / 8) : 0); /*if passw[i] is 0, it's 0 bytes, not 1 (no filtertype-byte)*/
-    padded_passstart[i + 1] = padded_passstart[i] + passh[i] * ((passw[i] * bpp + 7) / 8); /*bits padded if needed to fill full byte at end of each scanline*/
-    passstart[i + 1] = passstart[i] + (passh[i] * passw[i] * bpp + 7) / 8; /*only padded at end of reduced image*/
+    size_t linebytes, numpixels;
+    if(bpp != 0 && passw[i] > (maxsize - 7) / bpp) return 77; /*integer overflow*/
+    linebytes = ((size_t)passw[i] * bpp + 7) / 8;
+    if(passh[i] != 0 && linebytes + 1 > (maxsize - filter_passstart[i]) / passh[i]) return 77; /*integer overflow*/
+    numpixels = (size_t)passw[i] * passh[i];
+    if(passh[i] != 0 && numpixels / passh[i] != passw[i]) return 77; /*integer overflow*/
+    if(bpp != 0 && numpixels > (maxsize - 7) / bpp) return 77; /*integer overflow*/
+    /*if passw[i] is 0, it's 0 bytes, not 1 (no filtertype-byte)*/
+    filter_passstart[i + 1] = filter_passstart[i] + ((passw[i] && passh[i]) ? passh[i] * (1 + linebytes) : 0);
+    padded_passstart[i + 1] = padded_passstart[i] + passh[i] * linebytes; /*bits padded if needed to fill full byte at end of each scanline*/
+    passstart[i + 1] = passstart[i] + (numpixels * bpp + 7) / 8; /*only padded at end of reduced image*/
   }
+  return 0;
 }
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -2569,6 +3872,114 @@ void LodePNG_inspect(LodePNG_Decoder* decoder, const unsigned char* in, size_t i
   decoder->error = checkColorValidity(decoder->infoPng.color.colorType, decoder->infoPng.color.bitDepth);
 }
 
+#ifdef LODEPNG_SIMD_X86
+/*a pixel of bytewidth 3 or 4 in the low 32 bits of a register*/
+LODEPNG_TARGET("sse2")
+static __m128i unfilterLoadPixel(const unsigned char* p, size_t bytewidth)
+{
+  unsigned v;
+  if(bytewidth == 4) memcpy(&v, p, 4);
+  else v = p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16); /*no 4-byte load, it may be past the end*/
+  return _mm_cvtsi32_si128((int)v);
+}
+
+LODEPNG_TARGET("sse2")
+static void unfilterStorePixel(unsigned char* p, __m128i v, size_t bytewidth)
+{
+  unsigned u = (unsigned)_mm_cvtsi128_si32(v);
+  if(bytewidth == 4) memcpy(p, &u, 4);
+  else
+  {
+    p[0] = (unsigned char)u;
+    p[1] = (unsigned char)(u >> 8);
+    p[2] = (unsigned char)(u >> 16);
+  }
+}
+
+/*SSE2 version of unfilterScanline for the filter types 1-4 with bytewidth 3 or 4 (any bytewidth for type 2), and
+precon not NULL. Up adds 16 bytes at once. Sub adds the pixels of 16 bytes (4 pixels) as a prefix sum. Average and
+Paeth depend on the pixel just before, so they work one pixel at a time, with all channels at once.
+Like the scalar version, it only writes the bytes of recon after reading them from scanline, since they may overlap.*/
+LODEPNG_TARGET("sse2")
+static void unfilterScanlineSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, unsigned char filterType, size_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero; /*the previous pixel of recon*/
+  size_t i = 0;
+  switch(filterType)
+  {
+    case 1:
+      if(bytewidth == 4)
+      {
+        for(; i + 16 <= length; i += 16)
+        {
+          __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+          x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+          x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+          x = _mm_add_epi8(x, _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 3, 3, 3)));
+          _mm_storeu_si128((__m128i*)&recon[i], x);
+          a = x;
+        }
+        a = _mm_srli_si128(a, 12);
+      }
+      else /*bytewidth 3, 4 pixels are 12 bytes, the load of 16 must stay inside the scanline*/
+      {
+        const __m128i mask = _mm_setr_epi32(0xffffff, 0, 0, 0);
+        for(; i + 16 <= length; i += 12)
+        {
+          __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+          x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+          x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+          a = _mm_or_si128(_mm_or_si128(a, _mm_slli_si128(a, 3)), _mm_or_si128(_mm_slli_si128(a, 6), _mm_slli_si128(a, 9)));
+          x = _mm_add_epi8(x, a);
+          _mm_storel_epi64((__m128i*)&recon[i], x);
+          unfilterStorePixel(&recon[i + 8], _mm_srli_si128(x, 8), 4);
+          a = _mm_and_si128(_mm_srli_si128(x, 9), mask);
+        }
+      }
+      for(; i < length; i += bytewidth)
+      {
+        a = _mm_add_epi8(a, unfilterLoadPixel(&scanline[i], bytewidth));
+        unfilterStorePixel(&recon[i], a, bytewidth);
+      }
+      break;
+    case 2:
+      for(; i + 16 <= length; i += 16)
+      {
+        __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+        _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+      }
+      for(; i < length; i++) recon[i] = scanline[i] + precon[i];
+      break;
+    case 3:
+      for(; i < length; i += bytewidth)
+      {
+        __m128i b = unfilterLoadPixel(&precon[i], bytewidth);
+        /*pavgb rounds up, subtract the carry of the lowest bit to round down*/
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+        a = _mm_add_epi8(unfilterLoadPixel(&scanline[i], bytewidth), avg);
+        unfilterStorePixel(&recon[i], a, bytewidth);
+      }
+      break;
+    case 4:
+    {
+      __m128i c = zero; /*the previous pixel of precon, a, b and c are in 16-bit lanes*/
+      for(; i < length; i += bytewidth)
+      {
+        __m128i b = _mm_unpacklo_epi8(unfilterLoadPixel(&precon[i], bytewidth), zero);
+        __m128i nearest = paethPredictorSSE2(a, b, c);
+        a = _mm_add_epi8(_mm_unpacklo_epi8(unfilterLoadPixel(&scanline[i], bytewidth), zero), nearest);
+        a = _mm_and_si128(a, _mm_set1_epi16(0xff));
+        unfilterStorePixel(&recon[i], _mm_packus_epi16(a, a), bytewidth);
+        c = b;
+      }
+      break;
+    }
+  }
+}
+#endif /*LODEPNG_SIMD_X86*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, unsigned char filterType, size_t length)
 {
   /*
@@ -2580,6 +3991,14 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
   
   size_t i;
+#ifdef LODEPNG_SIMD_X86
+  if(precon && ((filterType >= 1 && filterType <= 4 && (bytewidth == 3 || bytewidth == 4)) || filterType == 2)
+  && (LodePNG_cpuFeatures() & CPU_SSE2))
+  {
+    unfilterScanlineSSE2(recon, scanline, precon, bytewidth, filterType, length);
+    return 0;
+  }
+#endif /*LODEPNG_SIMD_X86*/
   switch(filterType)
   {
     case 0:
@@ -2653,54 +4072,91 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
   return 0;
 }
 
-static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+unsigned LodePNG_unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+{
+  return unfilter(out, in, w, h, bpp);
+}
+
+static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp, unsigned passes)
 {
   /*Note: this function works on image buffers WITHOUT padding bits at end of scanlines with non-multiple-of-8 bit amounts, only between reduced images is padding
-  out must be big enough AND must be 0 everywhere if bpp < 8 in the current implementation (because that's likely a little bit faster)*/
+  out must be big enough AND must be 0 everywhere in the current implementation (because that's likely a little bit faster)
+  only for bpp < 8, Adam7_unfilterDeinterlace does whole bytes. out gets the image of the first passes, see Adam7_postProcess*/
   unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned gridx = ADAM7_GRIDX[passes - 1], gridy = ADAM7_GRIDY[passes - 1];
+  size_t olinebits = (size_t)bpp * ((w + gridx - 1) / gridx);
   unsigned i;
 
-  Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+  if(Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp)) return; /*checked by the caller*/
   
-  if(bpp >= 8)
+  /*Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
+  for(i = 0; i < passes; i++)
   {
-    for(i = 0; i < 7; i++)
+    unsigned x, y, b;
+    unsigned ilinebits = bpp * passw[i];
+    size_t obp, ibp; /*bit pointers (for out and in buffer)*/
+    for(y = 0; y < passh[i]; y++)
+    for(x = 0; x < passw[i]; x++)
     {
-      unsigned x, y, b;
-      size_t bytewidth = bpp / 8;
-      for(y = 0; y < passh[i]; y++)
-      for(x = 0; x < passw[i]; x++)
+      ibp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
+      obp = ((ADAM7_IY[i] + y * ADAM7_DY[i]) / gridy) * olinebits + ((ADAM7_IX[i] + x * ADAM7_DX[i]) / gridx) * bpp;
+      for(b = 0; b < bpp; b++)
       {
-        size_t pixelinstart = passstart[i] + (y * passw[i] + x) * bytewidth;
-        size_t pixeloutstart = ((ADAM7_IY[i] + y * ADAM7_DY[i]) * w + ADAM7_IX[i] + x * ADAM7_DX[i]) * bytewidth;
-        for(b = 0; b < bytewidth; b++)
-        {
-          out[pixeloutstart + b] = in[pixelinstart + b];
-        }
+        unsigned char bit = readBitFromReversedStream(&ibp, in);
+        setBitOfReversedStream0(&obp, out, bit); /*note that this function assumes the out buffer is completely 0, use setBitOfReversedStream otherwise*/
       }
     }
   }
-  else /*bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
+}
+
+/*puts count pixels of bytewidth bytes from in at every step bytes in out, with copies of a fixed size for the pixel sizes of PNG*/
+static void Adam7_scatterRow(unsigned char* out, const unsigned char* in, unsigned count, size_t step, size_t bytewidth)
+{
+  unsigned x;
+  if(step == bytewidth) { memcpy(out, in, count * bytewidth); return; } /*the rows of the 7th pass are whole rows of the image*/
+  switch(bytewidth)
   {
-    for(i = 0; i < 7; i++)
+    case 1: for(x = 0; x < count; x++) out[x * step] = in[x]; break;
+    case 2: for(x = 0; x < count; x++) memcpy(&out[x * step], &in[2 * x], 2); break;
+    case 3: for(x = 0; x < count; x++) memcpy(&out[x * step], &in[3 * x], 3); break;
+    case 4: for(x = 0; x < count; x++) memcpy(&out[x * step], &in[4 * x], 4); break;
+    case 6: for(x = 0; x < count; x++) memcpy(&out[x * step], &in[6 * x], 6); break;
+    case 8: for(x = 0; x < count; x++) memcpy(&out[x * step], &in[8 * x], 8); break;
+    default: for(x = 0; x < count; x++) memcpy(&out[x * step], &in[bytewidth * x], bytewidth); break;
+  }
+}
+
+/*
+Adam7 with whole bytes per pixel (bpp >= 8): each scanline of the first passes is unfiltered in place in in, and its
+pixels are scattered to their place in out right away, while it is in the cache, so the image is written in one go.
+Row y of out is at out + y * outstride.
+*/
+static unsigned Adam7_unfilterDeinterlace(unsigned char* out, size_t outstride, unsigned char* in, unsigned w, unsigned h, unsigned bpp, unsigned passes)
+{
+  unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned gridx = ADAM7_GRIDX[passes - 1], gridy = ADAM7_GRIDY[passes - 1];
+  size_t bytewidth = bpp / 8;
+  unsigned i, y;
+  unsigned error = Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+  if(error) return error;
+  
+  for(i = 0; i < passes; i++)
+  {
+    size_t linebytes = passw[i] * bytewidth;
+    size_t step = (ADAM7_DX[i] / gridx) * bytewidth;
+    unsigned char* prevline = 0;
+    for(y = 0; y < passh[i]; y++)
     {
-      unsigned x, y, b;
-      unsigned ilinebits = bpp * passw[i];
-      unsigned olinebits = bpp * w;
-      size_t obp, ibp; /*bit pointers (for out and in buffer)*/
-      for(y = 0; y < passh[i]; y++)
-      for(x = 0; x < passw[i]; x++)
-      {
-        ibp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
-        obp = (ADAM7_IY[i] + y * ADAM7_DY[i]) * olinebits + (ADAM7_IX[i] + x * ADAM7_DX[i]) * bpp;
-        for(b = 0; b < bpp; b++)
-        {
-          unsigned char bit = readBitFromReversedStream(&ibp, in);
-          setBitOfReversedStream0(&obp, out, bit); /*note that this function assumes the out buffer is completely 0, use setBitOfReversedStream otherwise*/
-        }
-      }
+      unsigned char* line = &in[filter_passstart[i] + y * (linebytes + 1)]; /*filter type and scanline*/
+      unsigned char* outline = &out[((ADAM7_IY[i] + y * ADAM7_DY[i]) / gridy) * outstride + (ADAM7_IX[i] / gridx) * bytewidth];
+      unsigned error = unfilterScanline(&line[1], &line[1], prevline, bytewidth, line[0], linebytes);
+      if(error) return error;
+      Adam7_scatterRow(outline, &line[1], passw[i], step, bytewidth);
+      prevline = &line[1];
     }
   }
+  
+  return 0;
 }
 
 static void removePaddingBits(unsigned char* out, const unsigned char* in, size_t olinebits, size_t ilinebits, unsigned h)
@@ -2726,13 +4182,40 @@ static void removePaddingBits(unsigned char* out, const unsigned char* in, size_
   }
 }
 
+/*
+Adam7: the image of the first passes (1-7) from the decompressed data, in is overwritten. After all 7 it's the whole
+image, after fewer it's a preview of lower resolution, made of the pixels at every ADAM7_GRIDX-th column of every
+ADAM7_GRIDY-th row, which are the ones those passes have. With whole bytes per pixel, row y is at out + y * outstride,
+with less the rows are packed without padding bits between them, and out must be 0.
+*/
+static unsigned Adam7_postProcess(unsigned char* out, size_t outstride, unsigned char* in, unsigned w, unsigned h, unsigned bpp, unsigned passes)
+{
+  unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned i, error;
+  
+  if(bpp >= 8) return Adam7_unfilterDeinterlace(out, outstride, in, w, h, bpp, passes);
+  
+  error = Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+  if(error) return error;
+  for(i = 0; i < passes; i++)
+  {
+    error = unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp);
+    if(error) return error;
+    /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline, move bytes instead of bits or move not at all*/
+    /*remove padding bits in scanlines; after this there still may be padding bits between the different reduced images: each reduced image still starts nicely at a byte*/
+    removePaddingBits(&in[passstart[i]], &in[padded_passstart[i]], (size_t)passw[i] * bpp, (((size_t)passw[i] * bpp + 7) / 8) * 8, passh[i]);
+  }
+  Adam7_deinterlace(out, in, w, h, bpp, passes);
+  return 0;
+}
+
 /*out must be buffer big enough to contain full image, and in must contain the full decompressed data from the IDAT chunks*/
 static unsigned postProcessScanlines(unsigned char* out, unsigned char* in, const LodePNG_InfoPng* infoPng) /*return value is error*/
 {
   /*
   This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype. Steps:
   *) if no Adam7: 1) unfilter 2) remove padding bits (= posible extra bits per scanline if bpp < 8)
-  *) if adam7: 1) 7x unfilter 2) 7x remove padding bits 3) Adam7_deinterlace
+  *) if adam7: 1) 7x unfilter 2) 7x remove padding bits 3) Adam7_deinterlace, or with whole bytes per pixel, per scanline: unfilter and put the pixels in place
   NOTE: the in buffer will be overwritten with intermediate data!
   */
   unsigned bpp = LodePNG_InfoColor_getBpp(&infoPng->color);
@@ -2747,363 +4230,561 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in, cons
     {
       error = unfilter(in, in, w, h, bpp);
       if(error) return error;
-      removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
+      removePaddingBits(out, in, (size_t)w * bpp, (((size_t)w * bpp + 7) / 8) * 8, h);
     }
     else error = unfilter(out, in, w, h, bpp); /*we can immediatly filter into the out buffer, no other steps needed*/
   }
   else /*interlaceMethod is 1 (Adam7)*/
   {
-    unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
-    unsigned i;
-    
-    Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
-    
-    for(i = 0; i < 7; i++)
-    {
-      error = unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp);
-      if(error) return error;
-      if(bpp < 8) /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline, move bytes instead of bits or move not at all*/
-      {
-        /*remove padding bits in scanlines; after this there still may be padding bits between the different reduced images: each reduced image still starts nicely at a byte*/
-        removePaddingBits(&in[passstart[i]], &in[padded_passstart[i]], passw[i] * bpp, ((passw[i] * bpp + 7) / 8) * 8, passh[i]);
-      }
-    }
-    
-    Adam7_deinterlace(out, in, w, h, bpp);
+    error = Adam7_postProcess(out, (size_t)w * (bpp / 8), in, w, h, bpp, 7);
   }
   
   return error;
 }
 
-/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsize, const unsigned char* in, size_t size)
+/*
+process a chunk other than IDAT and IEND that is in memory as a whole, with its length, type and CRC. critical_pos is
+1 after IHDR, 2 after PLTE and 3 after IDAT, it tells where unknown chunks were. The error is set in the decoder.
+*/
+static void decodeChunk(LodePNG_Decoder* decoder, const unsigned char* chunk, unsigned* critical_pos)
 {
-  unsigned char IEND = 0;
-  const unsigned char* chunk;
-  size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  
-  /*for unknown chunk order*/
+  unsigned chunkLength = LodePNG_chunk_length(chunk);
+  const unsigned char* data = LodePNG_chunk_data_const(chunk);
   unsigned unknown = 0;
-  unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
-  
-  /*provide some proper output values if error will happen*/
-  *out = 0;
-  *outsize = 0;
-  
-  if(size == 0 || in == 0) { decoder->error = 48; return; } /*the given data is empty*/
-
-  LodePNG_inspect(decoder, in, size); /*reads header and resets other parameters in decoder->infoPng*/
-  if(decoder->error) return;
-
-  ucvector_init(&idat);
-  
-  chunk = &in[33]; /*first byte of the first chunk after the header*/
+  size_t i;
   
-  while(!IEND) /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk. IDAT data is put at the start of the in buffer*/
+  /*palette chunk (PLTE)*/
+  if(LodePNG_chunk_type_equals(chunk, "PLTE"))
   {
-    unsigned chunkLength;
-    const unsigned char* data; /*the data in the chunk*/
-    
-    if((size_t)((chunk - in) + 12) > size || chunk < in) { decoder->error = 30; break; } /*error: size of the in buffer too small to contain next chunk*/
-    chunkLength = LodePNG_chunk_length(chunk); /*length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes*/
-    if(chunkLength > 2147483647) { decoder->error = 63; break; }
-    if((size_t)((chunk - in) + chunkLength + 12) > size || (chunk + chunkLength + 12) < in) { decoder->error = 35; break; } /*error: size of the in buffer too small to contain next chunk*/
-    data = LodePNG_chunk_data_const(chunk);
-    
-    /*IDAT chunk, containing compressed image data*/
-    if(LodePNG_chunk_type_equals(chunk, "IDAT"))
+    unsigned pos = 0;
+    if(decoder->infoPng.color.palette) free(decoder->infoPng.color.palette);
+    decoder->infoPng.color.palettesize = chunkLength / 3;
+    decoder->infoPng.color.palette = (unsigned char*)malloc(4 * decoder->infoPng.color.palettesize);
+    if(!decoder->infoPng.color.palette && decoder->infoPng.color.palettesize) { decoder->error = 9937; return; }
+    if(!decoder->infoPng.color.palette) decoder->infoPng.color.palettesize = 0; /*malloc failed...*/
+    if(decoder->infoPng.color.palettesize > 256) { decoder->error = 38; return; } /*error: palette too big*/
+    for(i = 0; i < decoder->infoPng.color.palettesize; i++)
     {
-      size_t oldsize = idat.size;
-      if(!ucvector_resize(&idat, oldsize + chunkLength)) { decoder->error = 9936; break; }
-      for(i = 0; i < chunkLength; i++) idat.data[oldsize + i] = data[i];
-      critical_pos = 3;
+      decoder->infoPng.color.palette[4 * i + 0] = data[pos++]; /*R*/
+      decoder->infoPng.color.palette[4 * i + 1] = data[pos++]; /*G*/
+      decoder->infoPng.color.palette[4 * i + 2] = data[pos++]; /*B*/
+      decoder->infoPng.color.palette[4 * i + 3] = 255; /*alpha*/
     }
-    /*IEND chunk*/
-    else if(LodePNG_chunk_type_equals(chunk, "IEND"))
+    *critical_pos = 2;
+  }
+  /*palette transparency chunk (tRNS)*/
+  else if(LodePNG_chunk_type_equals(chunk, "tRNS"))
+  {
+    if(decoder->infoPng.color.colorType == 3)
     {
-      IEND = 1;
+      if(chunkLength > decoder->infoPng.color.palettesize) { decoder->error = 39; return; } /*error: more alpha values given than there are palette entries*/
+      for(i = 0; i < chunkLength; i++) decoder->infoPng.color.palette[4 * i + 3] = data[i];
     }
-    /*palette chunk (PLTE)*/
-    else if(LodePNG_chunk_type_equals(chunk, "PLTE"))
+    else if(decoder->infoPng.color.colorType == 0)
     {
-      unsigned pos = 0;
-      if(decoder->infoPng.color.palette) free(decoder->infoPng.color.palette);
-      decoder->infoPng.color.palettesize = chunkLength / 3;
-      decoder->infoPng.color.palette = (unsigned char*)malloc(4 * decoder->infoPng.color.palettesize);
-      if(!decoder->infoPng.color.palette && decoder->infoPng.color.palettesize) { decoder->error = 9937; break; }
-      if(!decoder->infoPng.color.palette) decoder->infoPng.color.palettesize = 0; /*malloc failed...*/
-      if(decoder->infoPng.color.palettesize > 256) { decoder->error = 38; break; } /*error: palette too big*/
-      for(i = 0; i < decoder->infoPng.color.palettesize; i++)
-      {
-        decoder->infoPng.color.palette[4 * i + 0] = data[pos++]; /*R*/
-        decoder->infoPng.color.palette[4 * i + 1] = data[pos++]; /*G*/
-        decoder->infoPng.color.palette[4 * i + 2] = data[pos++]; /*B*/
-        decoder->infoPng.color.palette[4 * i + 3] = 255; /*alpha*/
-      }
-      critical_pos = 2;
+      if(chunkLength != 2) { decoder->error = 40; return; } /*error: this chunk must be 2 bytes for greyscale image*/
+      decoder->infoPng.color.key_defined = 1;
+      decoder->infoPng.color.key_r = decoder->infoPng.color.key_g = decoder->infoPng.color.key_b = 256 * data[0] + data[1];
     }
-    /*palette transparency chunk (tRNS)*/
-    else if(LodePNG_chunk_type_equals(chunk, "tRNS"))
+    else if(decoder->infoPng.color.colorType == 2)
     {
-      if(decoder->infoPng.color.colorType == 3)
-      {
-        if(chunkLength > decoder->infoPng.color.palettesize) { decoder->error = 39; break; } /*error: more alpha values given than there are palette entries*/
-        for(i = 0; i < chunkLength; i++) decoder->infoPng.color.palette[4 * i + 3] = data[i];
-      }
-      else if(decoder->infoPng.color.colorType == 0)
-      {
-        if(chunkLength != 2) { decoder->error = 40; break; } /*error: this chunk must be 2 bytes for greyscale image*/
-        decoder->infoPng.color.key_defined = 1;
-        decoder->infoPng.color.key_r = decoder->infoPng.color.key_g = decoder->infoPng.color.key_b = 256 * data[0] + data[1];
-      }
-      else if(decoder->infoPng.color.colorType == 2)
-      {
-        if(chunkLength != 6) { decoder->error = 41; break; } /*error: this chunk must be 6 bytes for RGB image*/
-        decoder->infoPng.color.key_defined = 1;
-        decoder->infoPng.color.key_r = 256 * data[0] + data[1];
-        decoder->infoPng.color.key_g = 256 * data[2] + data[3];
-        decoder->infoPng.color.key_b = 256 * data[4] + data[5];
-      }
-      else { decoder->error = 42; break; } /*error: tRNS chunk not allowed for other color models*/
+      if(chunkLength != 6) { decoder->error = 41; return; } /*error: this chunk must be 6 bytes for RGB image*/
+      decoder->infoPng.color.key_defined = 1;
+      decoder->infoPng.color.key_r = 256 * data[0] + data[1];
+      decoder->infoPng.color.key_g = 256 * data[2] + data[3];
+      decoder->infoPng.color.key_b = 256 * data[4] + data[5];
     }
+    else { decoder->error = 42; return; } /*error: tRNS chunk not allowed for other color models*/
+  }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*background color chunk (bKGD)*/
-    else if(LodePNG_chunk_type_equals(chunk, "bKGD"))
+  /*background color chunk (bKGD)*/
+  else if(LodePNG_chunk_type_equals(chunk, "bKGD"))
+  {
+    if(decoder->infoPng.color.colorType == 3)
     {
-      if(decoder->infoPng.color.colorType == 3)
-      {
-        if(chunkLength != 1) { decoder->error = 43; break; } /*error: this chunk must be 1 byte for indexed color image*/
-        decoder->infoPng.background_defined = 1;
-        decoder->infoPng.background_r = decoder->infoPng.background_g = decoder->infoPng.background_g = data[0];
-      }
-      else if(decoder->infoPng.color.colorType == 0 || decoder->infoPng.color.colorType == 4)
-      {
-        if(chunkLength != 2) { decoder->error = 44; break; } /*error: this chunk must be 2 bytes for greyscale image*/
-        decoder->infoPng.background_defined = 1;
-        decoder->infoPng.background_r = decoder->infoPng.background_g = decoder->infoPng.background_b = 256 * data[0] + data[1];
-      }
-      else if(decoder->infoPng.color.colorType == 2 || decoder->infoPng.color.colorType == 6)
+      if(chunkLength != 1) { decoder->error = 43; return; } /*error: this chunk must be 1 byte for indexed color image*/
+      decoder->infoPng.background_defined = 1;
+      decoder->infoPng.background_r = decoder->infoPng.background_g = decoder->infoPng.background_g = data[0];
+    }
+    else if(decoder->infoPng.color.colorType == 0 || decoder->infoPng.color.colorType == 4)
+    {
+      if(chunkLength != 2) { decoder->error = 44; return; } /*error: this chunk must be 2 bytes for greyscale image*/
+      decoder->infoPng.background_defined = 1;
+      decoder->infoPng.background_r = decoder->infoPng.background_g = decoder->infoPng.background_b = 256 * data[0] + data[1];
+    }
+    else if(decoder->infoPng.color.colorType == 2 || decoder->infoPng.color.colorType == 6)
+    {
+      if(chunkLength != 6) { decoder->error = 45; return; } /*error: this chunk must be 6 bytes for greyscale image*/
+      decoder->infoPng.background_defined = 1;
+      decoder->infoPng.background_r = 256 * data[0] + data[1];
+      decoder->infoPng.background_g = 256 * data[2] + data[3];
+      decoder->infoPng.background_b = 256 * data[4] + data[5];
+    }
+  }
+  /*text chunk (tEXt)*/
+  else if(LodePNG_chunk_type_equals(chunk, "tEXt"))
+  {
+    if(decoder->settings.readTextChunks)
+    {
+      char *key = 0, *str = 0;
+      
+      while(!decoder->error) /*not really a while loop, only used to break on error*/
       {
-        if(chunkLength != 6) { decoder->error = 45; break; } /*error: this chunk must be 6 bytes for greyscale image*/
-        decoder->infoPng.background_defined = 1;
-        decoder->infoPng.background_r = 256 * data[0] + data[1];
-        decoder->infoPng.background_g = 256 * data[2] + data[3];
-        decoder->infoPng.background_b = 256 * data[4] + data[5];
+        unsigned length, string2_begin;
+        
+        for(length = 0; length < chunkLength && data[length] != 0; length++) ;
+        if(length + 1 >= chunkLength) { decoder->error = 75; break; }
+        key = (char*)malloc(length + 1);
+        if(!key) { decoder->error = 9938; break; }
+        key[length] = 0;
+        for(i = 0; i < length; i++) key[i] = data[i];
+
+        string2_begin = length + 1;
+        if(string2_begin > chunkLength)  { decoder->error = 75; break; }
+        length = chunkLength - string2_begin;
+        str = (char*)malloc(length + 1);
+        if(!str) { decoder->error = 9939; break; }
+        str[length] = 0;
+        for(i = 0; i < length; i++) str[i] = data[string2_begin + i];
+
+        decoder->error = LodePNG_Text_add(&decoder->infoPng.text, key, str);
+        
+        break;
       }
+
+      free(key);
+      free(str);
     }
-    /*text chunk (tEXt)*/
-    else if(LodePNG_chunk_type_equals(chunk, "tEXt"))
+  }
+  /*compressed text chunk (zTXt)*/
+  else if(LodePNG_chunk_type_equals(chunk, "zTXt"))
+  {
+    if(decoder->settings.readTextChunks)
     {
-      if(decoder->settings.readTextChunks)
+      unsigned length, string2_begin;
+      char *key = 0;
+      ucvector decoded;
+      
+      ucvector_init(&decoded);
+      
+      while(!decoder->error) /*not really a while loop, only used to break on error*/
       {
-        char *key = 0, *str = 0;
+        for(length = 0; length < chunkLength && data[length] != 0; length++) ;
+        if(length + 2 >= chunkLength) { decoder->error = 75; break; }
+        key = (char*)malloc(length + 1);
+        if(!key) { decoder->error = 9940; break; }
+        key[length] = 0;
+        for(i = 0; i < length; i++) key[i] = data[i];
         
-        while(!decoder->error) /*not really a while loop, only used to break on error*/
-        {
-          unsigned length, string2_begin;
-          
-          for(length = 0; length < chunkLength && data[length] != 0; length++) ;
-          if(length + 1 >= chunkLength) { decoder->error = 75; break; }
-          key = (char*)malloc(length + 1);
-          if(!key) { decoder->error = 9938; break; }
-          key[length] = 0;
-          for(i = 0; i < length; i++) key[i] = data[i];
-  
-          string2_begin = length + 1;
-          if(string2_begin > chunkLength)  { decoder->error = 75; break; }
-          length = chunkLength - string2_begin;
-          str = (char*)malloc(length + 1);
-          if(!str) { decoder->error = 9939; break; }
-          str[length] = 0;
-          for(i = 0; i < length; i++) str[i] = data[string2_begin + i];
-  
-          decoder->error = LodePNG_Text_add(&decoder->infoPng.text, key, str);
-          
-          break;
-        }
+        if(data[length + 1] != 0) { decoder->error = 72; break; } /*the 0 byte indicating compression must be 0*/
+        
+        string2_begin = length + 2;
+        if(string2_begin > chunkLength)  { decoder->error = 75; break; }
+        length = chunkLength - string2_begin;
+        decoder->error = LodePNG_decompress(&decoded.data, &decoded.size, (unsigned char*)(&data[string2_begin]), length, &decoder->settings.zlibsettings);
+        if(decoder->error) break;
+        ucvector_push_back(&decoded, 0);
 
-        free(key);
-        free(str);
+        decoder->error = LodePNG_Text_add(&decoder->infoPng.text, key, (char*)decoded.data);
+        
+        break;
       }
+
+      free(key);
+      ucvector_cleanup(&decoded);
+      if(decoder->error) return;
     }
-    /*compressed text chunk (zTXt)*/
-    else if(LodePNG_chunk_type_equals(chunk, "zTXt"))
+  }
+  /*international text chunk (iTXt)*/
+  else if(LodePNG_chunk_type_equals(chunk, "iTXt"))
+  {
+    if(decoder->settings.readTextChunks)
     {
-      if(decoder->settings.readTextChunks)
+      unsigned length, begin, compressed;
+      char *key = 0, *langtag = 0, *transkey = 0;
+      ucvector decoded;
+      ucvector_init(&decoded);
+      
+      while(!decoder->error) /*not really a while loop, only used to break on error*/
       {
-        unsigned length, string2_begin;
-        char *key = 0;
-        ucvector decoded;
+        if(chunkLength < 5) { decoder->error = 76; break; }
+        for(length = 0; length < chunkLength && data[length] != 0; length++) ;
+        if(length + 2 >= chunkLength) { decoder->error = 75; break; }
+        key = (char*)malloc(length + 1);
+        if(!key) { decoder->error = 9941; break; }
+        key[length] = 0;
+        for(i = 0; i < length; i++) key[i] = data[i];
         
-        ucvector_init(&decoded);
+        compressed = data[length + 1];
+        if(data[length + 2] != 0) { decoder->error = 72; break; } /*the 0 byte indicating compression must be 0*/
         
-        while(!decoder->error) /*not really a while loop, only used to break on error*/
+        begin = length + 3;
+        length = 0;
+        for(i = begin; i < chunkLength && data[i] != 0; i++) length++;
+        if(begin + length + 1 >= chunkLength) { decoder->error = 75; break; }
+        langtag = (char*)malloc(length + 1);
+        if(!langtag) { decoder->error = 9942; break; }
+        langtag[length] = 0;
+        for(i = 0; i < length; i++) langtag[i] = data[begin + i];
+        
+        begin += length + 1;
+        length = 0;
+        for(i = begin; i < chunkLength && data[i] != 0; i++) length++;
+        if(begin + length + 1 >= chunkLength) { decoder->error = 75; break; }
+        transkey = (char*)malloc(length + 1);
+        if(!transkey) { decoder->error = 9943; break; }
+        transkey[length] = 0;
+        for(i = 0; i < length; i++) transkey[i] = data[begin + i];
+
+        begin += length + 1;
+        if(begin > chunkLength)  { decoder->error = 75; break; }
+        length = chunkLength - begin;
+        
+        if(compressed)
         {
-          for(length = 0; length < chunkLength && data[length] != 0; length++) ;
-          if(length + 2 >= chunkLength) { decoder->error = 75; break; }
-          key = (char*)malloc(length + 1);
-          if(!key) { decoder->error = 9940; break; }
-          key[length] = 0;
-          for(i = 0; i < length; i++) key[i] = data[i];
-          
-          if(data[length + 1] != 0) { decoder->error = 72; break; } /*the 0 byte indicating compression must be 0*/
-          
-          string2_begin = length + 2;
-          if(string2_begin > chunkLength)  { decoder->error = 75; break; }
-          length = chunkLength - string2_begin;
-          decoder->error = LodePNG_decompress(&decoded.data, &decoded.size, (unsigned char*)(&data[string2_begin]), length, &decoder->settings.zlibsettings);
+          decoder->error = LodePNG_decompress(&decoded.data, &decoded.size, (unsigned char*)(&data[begin]), length, &decoder->settings.zlibsettings);
           if(decoder->error) break;
           ucvector_push_back(&decoded, 0);
-
-          decoder->error = LodePNG_Text_add(&decoder->infoPng.text, key, (char*)decoded.data);
-          
-          break;
         }
-
-        free(key);
-        ucvector_cleanup(&decoded);
-        if(decoder->error) break;
-      }
-    }
-    /*international text chunk (iTXt)*/
-    else if(LodePNG_chunk_type_equals(chunk, "iTXt"))
-    {
-      if(decoder->settings.readTextChunks)
-      {
-        unsigned length, begin, compressed;
-        char *key = 0, *langtag = 0, *transkey = 0;
-        ucvector decoded;
-        ucvector_init(&decoded);
-        
-        while(!decoder->error) /*not really a while loop, only used to break on error*/
+        else
         {
-          if(chunkLength < 5) { decoder->error = 76; break; }
-          for(length = 0; length < chunkLength && data[length] != 0; length++) ;
-          if(length + 2 >= chunkLength) { decoder->error = 75; break; }
-          key = (char*)malloc(length + 1);
-          if(!key) { decoder->error = 9941; break; }
-          key[length] = 0;
-          for(i = 0; i < length; i++) key[i] = data[i];
-          
-          compressed = data[length + 1];
-          if(data[length + 2] != 0) { decoder->error = 72; break; } /*the 0 byte indicating compression must be 0*/
-          
-          begin = length + 3;
-          length = 0;
-          for(i = begin; i < chunkLength && data[i] != 0; i++) length++;
-          if(begin + length + 1 >= chunkLength) { decoder->error = 75; break; }
-          langtag = (char*)malloc(length + 1);
-          if(!langtag) { decoder->error = 9942; break; }
-          langtag[length] = 0;
-          for(i = 0; i < length; i++) langtag[i] = data[begin + i];
-          
-          begin += length + 1;
-          length = 0;
-          for(i = begin; i < chunkLength && data[i] != 0; i++) length++;
-          if(begin + length + 1 >= chunkLength) { decoder->error = 75; break; }
-          transkey = (char*)malloc(length + 1);
-          if(!transkey) { decoder->error = 9943; break; }
-          transkey[length] = 0;
-          for(i = 0; i < length; i++) transkey[i] = data[begin + i];
-
-          begin += length + 1;
-          if(begin > chunkLength)  { decoder->error = 75; break; }
-          length = chunkLength - begin;
-          
-          if(compressed)
-          {
-            decoder->error = LodePNG_decompress(&decoded.data, &decoded.size, (unsigned char*)(&data[begin]), length, &decoder->settings.zlibsettings);
-            if(decoder->error) break;
-            ucvector_push_back(&decoded, 0);
-          }
-          else
-          {
-            if(!ucvector_resize(&decoded, length + 1)) { decoder->error = 9944; break; }
-            decoded.data[length] = 0;
-            for(i = 0; i < length; i++) decoded.data[i] = data[begin + i];
-          }
-          
-          decoder->error = LodePNG_IText_add(&decoder->infoPng.itext, key, langtag, transkey, (char*)decoded.data);
-          
-          break;
+          if(!ucvector_resize(&decoded, length + 1)) { decoder->error = 9944; break; }
+          decoded.data[length] = 0;
+          for(i = 0; i < length; i++) decoded.data[i] = data[begin + i];
         }
-
-        free(key);
-        free(langtag);
-        free(transkey);
-        ucvector_cleanup(&decoded);
-        if(decoder->error) break;
+        
+        decoder->error = LodePNG_IText_add(&decoder->infoPng.itext, key, langtag, transkey, (char*)decoded.data);
+        
+        break;
       }
+
+      free(key);
+      free(langtag);
+      free(transkey);
+      ucvector_cleanup(&decoded);
+      if(decoder->error) return;
     }
-    else if(LodePNG_chunk_type_equals(chunk, "tIME"))
-    {
-      if(chunkLength != 7) { decoder->error = 73; break; }
-      decoder->infoPng.time_defined = 1;
-      decoder->infoPng.time.year = 256 * data[0] + data[+ 1];
-      decoder->infoPng.time.month = data[2];
-      decoder->infoPng.time.day = data[3];
-      decoder->infoPng.time.hour = data[4];
-      decoder->infoPng.time.minute = data[5];
-      decoder->infoPng.time.second = data[6];
-    }
-    else if(LodePNG_chunk_type_equals(chunk, "pHYs"))
-    {
-      if(chunkLength != 9) { decoder->error = 74; break; }
-      decoder->infoPng.phys_defined = 1;
-      decoder->infoPng.phys_x = 16777216 * data[0] + 65536 * data[1] + 256 * data[2] + data[3];
-      decoder->infoPng.phys_y = 16777216 * data[4] + 65536 * data[5] + 256 * data[6] + data[7];
-      decoder->infoPng.phys_unit = data[8];
-    }
+  }
+  else if(LodePNG_chunk_type_equals(chunk, "tIME"))
+  {
+    if(chunkLength != 7) { decoder->error = 73; return; }
+    decoder->infoPng.time_defined = 1;
+    decoder->infoPng.time.year = 256 * data[0] + data[+ 1];
+    decoder->infoPng.time.month = data[2];
+    decoder->infoPng.time.day = data[3];
+    decoder->infoPng.time.hour = data[4];
+    decoder->infoPng.time.minute = data[5];
+    decoder->infoPng.time.second = data[6];
+  }
+  else if(LodePNG_chunk_type_equals(chunk, "pHYs"))
+  {
+    if(chunkLength != 9) { decoder->error = 74; return; }
+    decoder->infoPng.phys_defined = 1;
+    decoder->infoPng.phys_x = 16777216 * data[0] + 65536 * data[1] + 256 * data[2] + data[3];
+    decoder->infoPng.phys_y = 16777216 * data[4] + 65536 * data[5] + 256 * data[6] + data[7];
+    decoder->infoPng.phys_unit = data[8];
+  }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    else /*it's not an implemented chunk type, so ignore it: skip over the data*/
-    {
-      if(LodePNG_chunk_critical(chunk)) { decoder->error = 69; break; } /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
-      unknown = 1;
+  else /*it's not an implemented chunk type, so ignore it: skip over the data*/
+  {
+    if(LodePNG_chunk_critical(chunk)) { decoder->error = 69; return; } /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
+    unknown = 1;
 #ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
-      if(decoder->settings.rememberUnknownChunks)
-      {
-        LodePNG_UnknownChunks* unknown = &decoder->infoPng.unknown_chunks;
-        decoder->error = LodePNG_append_chunk(&unknown->data[critical_pos - 1], &unknown->datasize[critical_pos - 1], chunk);
-        if(decoder->error) break;
-      }
-#endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
-    }
-    
-    if(!decoder->settings.ignoreCrc && !unknown) /*check CRC if wanted, only on known chunk types*/
+    if(decoder->settings.rememberUnknownChunks)
     {
-      if(LodePNG_chunk_check_crc(chunk)) { decoder->error = 57; break; }
+      LodePNG_UnknownChunks* unknown = &decoder->infoPng.unknown_chunks;
+      decoder->error = LodePNG_append_chunk(&unknown->data[*critical_pos - 1], &unknown->datasize[*critical_pos - 1], chunk);
+      if(decoder->error) return;
     }
-    
-    if(!IEND) chunk = LodePNG_chunk_next_const(chunk);
+#endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
   }
   
-  if(!decoder->error)
+  if(!decoder->settings.ignoreCrc && !unknown) /*check CRC if wanted, only on known chunk types*/
   {
-    ucvector scanlines;
-    ucvector_init(&scanlines);
-    if(!ucvector_resize(&scanlines, ((decoder->infoPng.width * (decoder->infoPng.height * LodePNG_InfoColor_getBpp(&decoder->infoPng.color) + 7)) / 8) + decoder->infoPng.height)) decoder->error = 9945; /*maximum final image length is already reserved in the vector's length - this is not really necessary*/
-    if(!decoder->error) decoder->error = LodePNG_decompress(&scanlines.data, &scanlines.size, idat.data, idat.size, &decoder->settings.zlibsettings); /*decompress with the Zlib decompressor*/
-    
-    if(!decoder->error)
+    if(LodePNG_chunk_check_crc(chunk)) { decoder->error = 57; return; }
+  }
+}
+
+/*
+Source of the BitReader for the IDAT chunks of a PNG in memory. The data of the chunks is given where it is, only the
+few bytes around the boundaries of the chunks are copied into a small buffer, so the compressed data is not copied.
+*/
+typedef struct IdatSource
+{
+  const unsigned char* chunk; /*the current IDAT chunk*/
+  size_t used; /*bytes of the data of the current chunk given to the reader*/
+  unsigned char stitch[64]; /*the end of a chunk followed by the start of the next ones*/
+} IdatSource;
+
+/*go to the next IDAT chunk before IEND, the chunks up to IEND were checked by decodeChunks. Returns 0 if there is none.*/
+static unsigned IdatSource_next(IdatSource* source)
+{
+  do
+  {
+    if(LodePNG_chunk_type_equals(source->chunk, "IEND")) { source->used = LodePNG_chunk_length(source->chunk); return 0; }
+    source->chunk = LodePNG_chunk_next_const(source->chunk);
+  }
+  while(!LodePNG_chunk_type_equals(source->chunk, "IDAT"));
+  source->used = 0;
+  return 1;
+}
+
+static const unsigned char* IdatSource_more(void* data, const unsigned char* rest, size_t restsize, size_t* size)
+{
+  IdatSource* source = (IdatSource*)data;
+  unsigned length = LodePNG_chunk_length(source->chunk);
+  size_t n;
+  
+  /*the rest are the last bytes given of this chunk: give the rest of the chunk from there*/
+  if(source->used < length && source->used >= restsize)
+  {
+    const unsigned char* begin = &LodePNG_chunk_data_const(source->chunk)[source->used - restsize];
+    *size = restsize + length - source->used;
+    source->used = length;
+    return begin;
+  }
+  
+  /*at the end of the chunk, stitch the rest and the start of the next chunks together*/
+  if(restsize > 0) memmove(source->stitch, rest, restsize);
+  n = restsize;
+  while(n < sizeof(source->stitch))
+  {
+    size_t amount;
+    if(source->used == length)
+    {
+      if(!IdatSource_next(source)) break;
+      length = LodePNG_chunk_length(source->chunk);
+      continue;
+    }
+    amount = length - source->used < sizeof(source->stitch) - n ? length - source->used : sizeof(source->stitch) - n;
+    memcpy(&source->stitch[n], &LodePNG_chunk_data_const(source->chunk)[source->used], amount);
+    source->used += amount;
+    n += amount;
+  }
+  *size = n;
+  return source->stitch;
+}
+
+/*decompress the zlib data of the IDAT chunks starting at the given one, see LodePNG_decompress*/
+static unsigned LodePNG_decompressIdat(ucvector* out, const unsigned char* chunk, const LodeZlib_DecompressSettings* settings)
+{
+  IdatSource source;
+  BitReader reader;
+  unsigned char bytes[4];
+  unsigned error;
+  
+  source.chunk = chunk;
+  source.used = 0;
+  BitReader_setSource(&reader, IdatSource_more, &source);
+  
+  if(!BitReader_readBytes(&reader, bytes, 2)) return 53; /*error, size of zlib data too small*/
+  error = LodeZlib_checkHeader(bytes);
+  if(!error) error = inflateData(out, &reader, 0, settings);
+  if(error) return error;
+  
+  if(!settings->ignoreAdler32)
+  {
+    BitReader_alignToByte(&reader);
+    if(!BitReader_readBytes(&reader, bytes, 4)) return 58;
+    if(LodeZlib_read32bitInt(bytes) != adler32(out->data, (unsigned)out->size)) return 58;
+  }
+  
+  return 0;
+}
+
+/*read the chunks after the header up to IEND, the decoder has inspected the header. Returns the first IDAT chunk.*/
+static const unsigned char* decodeChunks(LodePNG_Decoder* decoder, const unsigned char* in, size_t size)
+{
+  unsigned char IEND = 0;
+  const unsigned char* chunk;
+  const unsigned char* idat = 0; /*the first IDAT chunk, the data is decompressed where it is*/
+  
+  /*for unknown chunk order*/
+  unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
+  
+  chunk = &in[33]; /*first byte of the first chunk after the header*/
+  
+  while(!IEND) /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk*/
+  {
+    unsigned chunkLength;
+    
+    if((size_t)((chunk - in) + 12) > size || chunk < in) { decoder->error = 30; break; } /*error: size of the in buffer too small to contain next chunk*/
+    chunkLength = LodePNG_chunk_length(chunk); /*length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes*/
+    if(chunkLength > 2147483647) { decoder->error = 63; break; }
+    if((size_t)((chunk - in) + chunkLength + 12) > size || (chunk + chunkLength + 12) < in) { decoder->error = 35; break; } /*error: size of the in buffer too small to contain next chunk*/
+    
+    /*IDAT chunk, containing compressed image data*/
+    if(LodePNG_chunk_type_equals(chunk, "IDAT"))
+    {
+      if(!idat) idat = chunk;
+      critical_pos = 3;
+    }
+    /*IEND chunk*/
+    else if(LodePNG_chunk_type_equals(chunk, "IEND"))
+    {
+      IEND = 1;
+    }
+    else
+    {
+      decodeChunk(decoder, chunk, &critical_pos); /*checks the CRC too*/
+      if(decoder->error) break;
+      chunk = LodePNG_chunk_next_const(chunk);
+      continue;
+    }
+    
+    if(!decoder->settings.ignoreCrc) /*check CRC if wanted*/
+    {
+      if(LodePNG_chunk_check_crc(chunk)) { decoder->error = 57; break; }
+    }
+    
+    if(!IEND) chunk = LodePNG_chunk_next_const(chunk);
+  }
+  
+  if(!decoder->error && !idat) decoder->error = 53; /*error: no image data, the zlib data is empty*/
+  return decoder->error ? 0 : idat;
+}
+
+/*the size of the filtered scanlines of the image, which is what the zlib data of the IDAT chunks decompresses to.
+return value is error 77 if it doesn't fit in a size_t*/
+static unsigned getScanlinesSize(size_t* size, const LodePNG_InfoPng* infoPng)
+{
+  unsigned bpp = LodePNG_InfoColor_getBpp(&infoPng->color);
+  unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned error;
+  
+  if(infoPng->interlaceMethod == 0)
+  {
+    size_t linebytes;
+    if(infoPng->width > ((size_t)(-1) - 7) / bpp) return 77; /*integer overflow*/
+    linebytes = ((size_t)infoPng->width * bpp + 7) / 8;
+    if(infoPng->height != 0 && linebytes + 1 > (size_t)(-1) / infoPng->height) return 77; /*integer overflow*/
+    *size = infoPng->height * (1 + linebytes);
+    return 0;
+  }
+  error = Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, infoPng->width, infoPng->height, bpp);
+  if(!error) *size = filter_passstart[7];
+  return error;
+}
+
+/*the Adam7 passes that are decoded: the adam7Passes of the settings for an interlaced image, else 7 (all)*/
+static unsigned getDecodedPasses(const LodePNG_Decoder* decoder)
+{
+  unsigned passes = decoder->settings.adam7Passes;
+  if(decoder->infoPng.interlaceMethod == 0 || passes == 0 || passes > 7) return 7;
+  return passes;
+}
+
+void LodePNG_getDecodedSize(const LodePNG_Decoder* decoder, unsigned* w, unsigned* h)
+{
+  unsigned passes = getDecodedPasses(decoder);
+  *w = (decoder->infoPng.width + ADAM7_GRIDX[passes - 1] - 1) / ADAM7_GRIDX[passes - 1];
+  *h = (decoder->infoPng.height + ADAM7_GRIDY[passes - 1] - 1) / ADAM7_GRIDY[passes - 1];
+}
+
+/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+static void decodeGeneric(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsize, const unsigned char* in, size_t size)
+{
+  const unsigned char* idat;
+  
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+  *outsize = 0;
+  
+  if(size == 0 || in == 0) { decoder->error = 48; return; } /*the given data is empty*/
+
+  LodePNG_inspect(decoder, in, size); /*reads header and resets other parameters in decoder->infoPng*/
+  if(decoder->error) return;
+  
+  idat = decodeChunks(decoder, in, size);
+  
+  if(!decoder->error)
+  {
+    ucvector scanlines;
+    size_t scanlinessize = 0;
+    ucvector_init(&scanlines);
+    /*the inflator gets a buffer of the exact size, so that it never has to grow it for a valid image*/
+    decoder->error = getScanlinesSize(&scanlinessize, &decoder->infoPng);
+    if(!decoder->error && !ucvector_resize_exact(&scanlines, scanlinessize)) decoder->error = 9945;
+    if(!decoder->error) decoder->error = LodePNG_decompressIdat(&scanlines, idat, &decoder->settings.zlibsettings); /*decompress with the Zlib decompressor*/
+    
+    if(!decoder->error)
     {
       ucvector outv;
-      ucvector_init(&outv);
-      if(!ucvector_resizev(&outv, (decoder->infoPng.height * decoder->infoPng.width * LodePNG_InfoColor_getBpp(&decoder->infoPng.color) + 7) / 8, 0)) decoder->error = 9946;
+      ucvector_init_malloc(&outv);
+      size_t size = ((size_t)decoder->infoPng.height * decoder->infoPng.width * LodePNG_InfoColor_getBpp(&decoder->infoPng.color) + 7) / 8;
+      /*only the deinterlace of pixels smaller than a byte needs the bits 0*/
+      if(LodePNG_InfoColor_getBpp(&decoder->infoPng.color) < 8 ? !ucvector_resizev(&outv, size, 0) : !ucvector_resize_exact(&outv, size)) decoder->error = 9946;
       if(!decoder->error) decoder->error = postProcessScanlines(outv.data, scanlines.data, &decoder->infoPng);
       *out = outv.data;
       *outsize = outv.size;
     }
     ucvector_cleanup(&scanlines);
   }
-  
-  ucvector_cleanup(&idat);
 }
 
-void LodePNG_decode(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize)
+static void decodeRows(LodePNG_Decoder* decoder, const unsigned char* in, size_t insize, LodePNG_RowFunc row, void* rowdata,
+                       unsigned char* target, size_t targetstride);
+
+/*row function that packs rows of pixels smaller than a byte into an image without padding bits between the rows*/
+static unsigned packRow(void* data, const LodePNG_Decoder* decoder, unsigned y, const unsigned char* row, size_t rowsize)
+{
+  unsigned char* out = (unsigned char*)data;
+  unsigned w, h;
+  size_t linebits, ibp = 0, obp, x;
+  (void)rowsize;
+  LodePNG_getDecodedSize(decoder, &w, &h);
+  linebits = (size_t)w * LodePNG_InfoColor_getBpp(&decoder->infoRaw.color);
+  obp = y * linebits;
+  for(x = 0; x < linebits; x++) setBitOfReversedStream0(&obp, out, readBitFromReversedStream(&ibp, row));
+  return 0;
+}
+
+/*the size in bytes of an image of w * h pixels of bpp bits without padding bits between the rows, computed in size_t
+because the product of the 32-bit sizes from the header can overflow an unsigned. return value is error*/
+static unsigned getImageSize(size_t* size, unsigned w, unsigned h, unsigned bpp)
+{
+  size_t numpixels = (size_t)w * h;
+  if(h != 0 && numpixels / h != w) return 77; /*integer overflow*/
+  if(bpp != 0 && numpixels > ((size_t)(-1) - 7) / bpp) return 77; /*integer overflow*/
+  *size = (numpixels * bpp + 7) / 8;
+  return 0;
+}
+
+static void decodeImage(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize)
 {
   *out = 0;
   *outsize = 0;
+  
+  if(insize > 0 && in != 0)
+  {
+    const LodePNG_InfoColor* color;
+    size_t linebits, size;
+    unsigned w, h;
+    
+    LodePNG_inspect(decoder, in, insize);
+    if(decoder->error) return;
+    color = decoder->settings.color_convert ? &decoder->infoRaw.color : &decoder->infoPng.color;
+    LodePNG_getDecodedSize(decoder, &w, &h);
+    linebits = (size_t)w * LodePNG_InfoColor_getBpp(color);
+    if((decoder->infoPng.interlaceMethod == 0 && linebits % 8 == 0) || getDecodedPasses(decoder) < 7)
+    {
+      /*
+      the rows of the result are at byte boundaries: inflate into the window of the stream decoder, and unfilter and
+      convert each scanline into its row of the result as soon as it's inflated, so the image is in memory only once.
+      A preview of the first Adam7 passes is made by the stream decoder too, its rows are packed if they aren't.
+      */
+      decoder->error = getImageSize(&size, w, h, LodePNG_InfoColor_getBpp(color));
+      if(decoder->error) return;
+      *outsize = size;
+      *out = (unsigned char*)(linebits % 8 == 0 ? malloc(*outsize) : calloc(*outsize, 1));
+      if(!(*out) && *outsize) { decoder->error = 9947; *outsize = 0; return; }
+      if(linebits % 8 == 0) decodeRows(decoder, in, insize, 0, 0, *out, linebits / 8);
+      else decodeRows(decoder, in, insize, packRow, *out, 0, 0);
+      if(decoder->error) { free(*out); *out = 0; *outsize = 0; }
+      return;
+    }
+  }
+  
   decodeGeneric(decoder, out, outsize, in, insize);
   if(decoder->error) return;
   if(!decoder->settings.color_convert || LodePNG_InfoColor_equal(&decoder->infoRaw.color, &decoder->infoPng.color))
@@ -3121,11 +4802,16 @@ void LodePNG_decode(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsi
   {
     /*color conversion needed; sort of copy of the data*/
     unsigned char* data = *out;
+    size_t size;
 
     /*TODO: check if this works according to the statement in the documentation: "The converter can convert from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
     if(!(decoder->infoRaw.color.colorType == 2 || decoder->infoRaw.color.colorType == 6) && !(decoder->infoRaw.color.bitDepth == 8)) { decoder->error = 56; return; }
 
-    *outsize = (decoder->infoPng.width * decoder->infoPng.height * LodePNG_InfoColor_getBpp(&decoder->infoRaw.color) + 7) / 8;
+    *out = 0;
+    *outsize = 0;
+    decoder->error = getImageSize(&size, decoder->infoPng.width, decoder->infoPng.height, LodePNG_InfoColor_getBpp(&decoder->infoRaw.color));
+    if(decoder->error) { free(data); return; }
+    *outsize = size;
     *out = (unsigned char*)malloc(*outsize);
     if(!(*out))
     {
@@ -3137,6 +4823,13 @@ void LodePNG_decode(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsi
   }
 }
 
+void LodePNG_decode(LodePNG_Decoder* decoder, unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize)
+{
+  const LodePNG_Allocator* previous = LodePNG_useAllocator(decoder->settings.allocator);
+  decodeImage(decoder, out, outsize, in, insize);
+  LodePNG_useAllocator(previous);
+}
+
 unsigned LodePNG_decode32(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in, size_t insize)
 {
   unsigned error;
@@ -3154,13 +4847,524 @@ unsigned LodePNG_decode32(unsigned char** out, unsigned* w, unsigned* h, const u
 #ifdef LODEPNG_COMPILE_DISK
 unsigned LodePNG_decode32f(unsigned char** out, unsigned* w, unsigned* h, const char* filename)
 {
-  unsigned char* buffer;
-  size_t buffersize;
-  unsigned error;
-  error = LodePNG_loadFile(&buffer, &buffersize, filename);
-  if(!error) error = LodePNG_decode32(out, w, h, buffer, buffersize);
-  free(buffer);
-  return error;
+  unsigned char* buffer;
+  size_t buffersize;
+  unsigned error;
+  error = LodePNG_loadFile(&buffer, &buffersize, filename);
+  if(!error) error = LodePNG_decode32(out, w, h, buffer, buffersize);
+  free(buffer);
+  return error;
+}
+#endif /*LODEPNG_COMPILE_DISK*/
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / PNG Decoder, streaming                                                 / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+/*
+LodePNG_decodeStream reads the PNG with a read function and gives the image row by row to a row function, so neither
+the file nor the image have to be in memory as a whole. The IDAT data is read in pieces by the BitReader of the
+inflator, and the inflator gives the scanlines to PNGStream_consume, which unfilters and converts them one at a time.
+Besides the chunks other than IDAT, the memory used is one piece of input, the 32K window of deflate with a few
+scanlines and the scanline buffers. Adam7 interlaced images can't be given row by row before the last pass, they are
+decompressed as a whole first.
+LodePNG_decodeRows does the same for a PNG in memory: the chunks are read by decodeChunks, and the BitReader gets the
+IDAT data where it is from an IdatSource instead of the read function. LodePNG_decodeInto is built on it.
+*/
+
+static const size_t PNG_STREAM_PIECE = 32768; /*size of the pieces of IDAT data read at once*/
+
+typedef struct PNGStream
+{
+  LodePNG_Decoder* decoder;
+  LodePNG_ReadFunc read; /*0 if the PNG is in memory, then the IDAT chunks are read by idat*/
+  void* readdata;
+  IdatSource idat;
+  LodePNG_RowFunc row;
+  void* rowdata;
+  unsigned char* target; /*if not 0, the rows are written at target + y * targetstride instead of given to row*/
+  size_t targetstride;
+  
+  unsigned char header[8]; /*length and type of the current chunk*/
+  ucvector piece; /*the current piece of the zlib data, given to the BitReader*/
+  size_t idatleft; /*bytes of the current IDAT chunk not read yet*/
+  unsigned idatcrc; /*CRC of the current IDAT chunk so far*/
+  unsigned idatend; /*1 when the IDAT chunks are read, header is the chunk after them*/
+  unsigned error; /*error while reading the IDAT chunks, the inflator only sees that the data ends*/
+  
+  unsigned passes; /*Adam7 passes decoded, 7 unless it's a preview of the first passes*/
+  unsigned width, height; /*size of the decoded image, smaller than the PNG for a preview*/
+  size_t rowbytes; /*bytes of a row of the decoded image in the color type of the PNG*/
+  unsigned y; /*number of rows given to the row function*/
+  size_t linebytes; /*bytes of a scanline without the filter type*/
+  unsigned adler; /*adler32 of the scanlines consumed so far*/
+  ucvector line; /*unfiltered scanline*/
+  ucvector prevline; /*the scanline before, for the unfilter*/
+  ucvector converted; /*scanline in the color type of infoRaw, empty if there is no color conversion*/
+} PNGStream;
+
+/*read exactly size bytes, returns 0 if the data ends before*/
+static unsigned PNGStream_read(PNGStream* stream, unsigned char* buffer, size_t size)
+{
+  while(size > 0)
+  {
+    size_t n = stream->read(stream->readdata, buffer, size);
+    if(n == 0 || n > size) return 0;
+    buffer += n;
+    size -= n;
+  }
+  return 1;
+}
+
+/*read the length and type of the next chunk, return value is error*/
+static unsigned PNGStream_readHeader(PNGStream* stream)
+{
+  if(!PNGStream_read(stream, stream->header, 8)) return 30; /*error: the data ends before the next chunk*/
+  if(LodePNG_chunk_length(stream->header) > 2147483647) return 63;
+  if(LodePNG_chunk_type_equals(stream->header, "IDAT"))
+  {
+    stream->idatleft = LodePNG_chunk_length(stream->header);
+    stream->idatcrc = Crc32_update_crc(&stream->header[4], 0xffffffffu, 4);
+  }
+  else stream->idatend = 1;
+  return 0;
+}
+
+/*the current IDAT chunk is read: check its CRC and read the header of the next chunk*/
+static unsigned PNGStream_nextIdat(PNGStream* stream)
+{
+  unsigned char crc[4];
+  if(!PNGStream_read(stream, crc, 4)) return 30;
+  if(!stream->decoder->settings.ignoreCrc && LodePNG_read32bitInt(crc) != (stream->idatcrc ^ 0xffffffffu)) return 57;
+  return PNGStream_readHeader(stream);
+}
+
+/*source of the BitReader: the rest of the current piece followed by the next bytes of the IDAT chunks*/
+static const unsigned char* PNGStream_source(void* data, const unsigned char* rest, size_t restsize, size_t* size)
+{
+  PNGStream* stream = (PNGStream*)data;
+  size_t n = restsize;
+  if(restsize > 0) memmove(stream->piece.data, rest, restsize);
+  
+  while(n < stream->piece.size && !stream->idatend && !stream->error)
+  {
+    if(stream->idatleft == 0) stream->error = PNGStream_nextIdat(stream);
+    else
+    {
+      size_t amount = stream->idatleft < stream->piece.size - n ? stream->idatleft : stream->piece.size - n;
+      if(!PNGStream_read(stream, &stream->piece.data[n], amount)) { stream->error = 30; break; }
+      stream->idatcrc = Crc32_update_crc(&stream->piece.data[n], stream->idatcrc, amount);
+      stream->idatleft -= amount;
+      n += amount;
+    }
+  }
+  
+  *size = n;
+  return stream->piece.data;
+}
+
+/*convert the row if needed and give it to the row function, or convert or copy it to its row of the target*/
+static unsigned PNGStream_emitRow(PNGStream* stream, const unsigned char* row)
+{
+  LodePNG_Decoder* decoder = stream->decoder;
+  size_t rowsize = stream->rowbytes;
+  if(stream->target)
+  {
+    unsigned char* out = &stream->target[stream->y * stream->targetstride];
+    if(stream->converted.size)
+    {
+      unsigned error = LodePNG_convert(out, row, &decoder->infoRaw.color, &decoder->infoPng.color, stream->width, 1);
+      if(error) return error;
+    }
+    else if(out != row) memcpy(out, row, rowsize);
+    stream->y++;
+    return 0;
+  }
+  if(stream->converted.size)
+  {
+    unsigned error = LodePNG_convert(stream->converted.data, row, &decoder->infoRaw.color, &decoder->infoPng.color, stream->width, 1);
+    if(error) return error;
+    row = stream->converted.data;
+    rowsize = stream->converted.size;
+  }
+  if(stream->row(stream->rowdata, decoder, stream->y, row, rowsize)) return 82; /*error: the row function stopped the decoding*/
+  stream->y++;
+  return 0;
+}
+
+/*sink of the inflator: unfilter and give out the whole scanlines in the data, the rest comes again with more*/
+static size_t PNGStream_consume(void* data, const unsigned char* in, size_t size, unsigned* error)
+{
+  PNGStream* stream = (PNGStream*)data;
+  size_t bytewidth = (LodePNG_InfoColor_getBpp(&stream->decoder->infoPng.color) + 7) / 8;
+  size_t done = 0;
+  
+  while(size - done >= stream->linebytes + 1 && !(*error))
+  {
+    if(stream->y < stream->decoder->infoPng.height) /*data after the last scanline is ignored*/
+    {
+      if(stream->target && !stream->converted.size)
+      {
+        /*unfilter straight into the target, the row before is there too*/
+        unsigned char* line = &stream->target[stream->y * stream->targetstride];
+        *error = unfilterScanline(line, &in[done + 1], stream->y ? line - stream->targetstride : 0, bytewidth, in[done], stream->linebytes);
+        if(!(*error)) *error = PNGStream_emitRow(stream, line);
+      }
+      else
+      {
+        ucvector swap;
+        *error = unfilterScanline(stream->line.data, &in[done + 1], stream->y ? stream->prevline.data : 0, bytewidth, in[done], stream->linebytes);
+        if(!(*error)) *error = PNGStream_emitRow(stream, stream->line.data);
+        swap = stream->prevline;
+        stream->prevline = stream->line;
+        stream->line = swap;
+      }
+    }
+    done += stream->linebytes + 1;
+  }
+  
+  stream->adler = update_adler32(stream->adler, in, (unsigned)done);
+  return done;
+}
+
+/*Adam7: decompress the scanlines of the passes, then give out the rows of the deinterlaced image, or of the preview*/
+static unsigned PNGStream_decodeInterlaced(PNGStream* stream, ucvector* scanlines)
+{
+  const LodePNG_InfoPng* infoPng = &stream->decoder->infoPng;
+  unsigned bpp = LodePNG_InfoColor_getBpp(&infoPng->color);
+  size_t linebits = (size_t)stream->width * bpp;
+  unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned error = 0;
+  unsigned y;
+  ucvector image;
+  
+  if(stream->passes == 7) stream->adler = update_adler32(stream->adler, scanlines->data, (unsigned)scanlines->size);
+  error = Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, infoPng->width, infoPng->height, bpp);
+  if(error) return error;
+  if(scanlines->size < filter_passstart[stream->passes]) return 83; /*error: the image data is smaller than the image*/
+  
+  if(stream->target && !stream->converted.size && bpp >= 8)
+  {
+    /*the pixels are scattered straight to their place in the target*/
+    error = Adam7_postProcess(stream->target, stream->targetstride, scanlines->data, infoPng->width, infoPng->height, bpp, stream->passes);
+    if(!error) stream->y = stream->height;
+    return error;
+  }
+  
+  ucvector_init(&image);
+  if(!ucvector_resizev(&image, (stream->height * linebits + 7) / 8, 0)) return 9959; /*the deinterlace needs the bits 0*/
+  error = Adam7_postProcess(image.data, linebits / 8, scanlines->data, infoPng->width, infoPng->height, bpp, stream->passes);
+  
+  for(y = 0; y < stream->height && !error; y++)
+  {
+    if(linebits % 8 == 0) error = PNGStream_emitRow(stream, &image.data[y * (linebits / 8)]);
+    else /*the rows of the image are not at byte boundaries, pad them*/
+    {
+      size_t ibp = y * linebits, obp = 0, x;
+      memset(stream->line.data, 0, stream->rowbytes);
+      for(x = 0; x < linebits; x++) setBitOfReversedStream(&obp, stream->line.data, readBitFromReversedStream(&ibp, image.data));
+      error = PNGStream_emitRow(stream, stream->line.data);
+    }
+  }
+  
+  ucvector_cleanup(&image);
+  return error;
+}
+
+/*the scanlines of the first passes of an Adam7 image, for a preview, the inflator stops when they are complete*/
+typedef struct PassScanlines
+{
+  ucvector* scanlines; /*has the size of the scanlines of the passes*/
+  size_t filled; /*bytes of them inflated so far*/
+} PassScanlines;
+
+static size_t PNGStream_collectPasses(void* data, const unsigned char* in, size_t size, unsigned* error)
+{
+  PassScanlines* passes = (PassScanlines*)data;
+  size_t amount = passes->scanlines->size - passes->filled;
+  if(amount > size) amount = size;
+  if(amount > 0) /*the scanlines can be empty, then their data is NULL*/
+  {
+    memcpy(&passes->scanlines->data[passes->filled], in, amount);
+    passes->filled += amount;
+  }
+  if(passes->filled == passes->scanlines->size) *error = INFLATE_STOP;
+  return amount;
+}
+
+/*decode the IDAT chunks, the header of the first one is read. After it, header is the chunk after the IDAT chunks.*/
+static unsigned PNGStream_decodeIdat(PNGStream* stream)
+{
+  LodePNG_Decoder* decoder = stream->decoder;
+  const LodeZlib_DecompressSettings* settings = &decoder->settings.zlibsettings;
+  BitReader reader;
+  unsigned char bytes[4];
+  ucvector out;
+  unsigned error = 0;
+  
+  stream->idatend = 0;
+  ucvector_init(&out);
+  if(stream->read) BitReader_setSource(&reader, PNGStream_source, stream);
+  else BitReader_setSource(&reader, IdatSource_more, &stream->idat);
+  
+  if(!BitReader_readBytes(&reader, bytes, 2)) error = 53; /*error, size of zlib data too small*/
+  else error = LodeZlib_checkHeader(bytes);
+  
+  if(!error && decoder->infoPng.interlaceMethod == 0)
+  {
+    /*the out buffer holds the window and the scanlines not consumed yet, and the largest stored block*/
+    InflateSink sink;
+    sink.consume = PNGStream_consume;
+    sink.data = stream;
+    sink.done = 0;
+    if(!ucvector_resize(&out, INFLATE_WINDOW + 65536 + 2 * (stream->linebytes + 1))) error = 9960;
+    if(!error) error = inflateData(&out, &reader, &sink, settings);
+    if(!error)
+    {
+      stream->adler = update_adler32(stream->adler, &out.data[sink.done], (unsigned)(out.size - sink.done));
+      if(stream->y < decoder->infoPng.height) error = 83; /*error: the image data is smaller than the image*/
+    }
+  }
+  else if(!error && stream->passes < 7)
+  {
+    /*a preview needs only the first passes, they come first in the zlib data*/
+    unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+    ucvector scanlines;
+    PassScanlines passes;
+    InflateSink sink;
+    error = Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, decoder->infoPng.width, decoder->infoPng.height,
+                                LodePNG_InfoColor_getBpp(&decoder->infoPng.color));
+    ucvector_init(&scanlines);
+    passes.scanlines = &scanlines;
+    passes.filled = 0;
+    sink.consume = PNGStream_collectPasses;
+    sink.data = &passes;
+    sink.done = 0;
+    if(!error && (!ucvector_resize(&out, INFLATE_WINDOW + 65536) || !ucvector_resize_exact(&scanlines, filter_passstart[stream->passes]))) error = 9960;
+    if(!error) error = inflateData(&out, &reader, &sink, settings);
+    if(error == INFLATE_STOP) error = 0;
+    scanlines.size = passes.filled; /*smaller if the zlib data ended before*/
+    if(!error) error = PNGStream_decodeInterlaced(stream, &scanlines);
+    ucvector_cleanup(&scanlines);
+  }
+  else if(!error)
+  {
+    error = inflateData(&out, &reader, 0, settings);
+    if(!error) error = PNGStream_decodeInterlaced(stream, &out);
+  }
+  if(stream->error && error != 82) error = stream->error; /*the inflator failed because the IDAT chunks could not be read*/
+  ucvector_cleanup(&out);
+  
+  if(!error && !settings->ignoreAdler32 && stream->passes == 7) /*a preview stops before the end of the zlib data*/
+  {
+    BitReader_alignToByte(&reader);
+    if(!BitReader_readBytes(&reader, bytes, 4)) error = stream->error ? stream->error : 58;
+    else if(LodeZlib_read32bitInt(bytes) != stream->adler) error = 58;
+  }
+  
+  /*skip the rest of the IDAT chunks, e.g. bytes after the zlib data*/
+  while(!error && stream->read && !stream->idatend)
+  {
+    if(stream->idatleft == 0) error = PNGStream_nextIdat(stream);
+    else
+    {
+      size_t amount = stream->idatleft < stream->piece.size ? stream->idatleft : stream->piece.size;
+      if(!PNGStream_read(stream, stream->piece.data, amount)) error = 30;
+      else stream->idatcrc = Crc32_update_crc(stream->piece.data, stream->idatcrc, amount);
+      stream->idatleft -= amount;
+    }
+  }
+  
+  return error;
+}
+
+/*set up the conversion of the rows to the color type of infoRaw, if it differs from the PNG, return value is error*/
+static unsigned PNGStream_prepareConvert(PNGStream* stream)
+{
+  LodePNG_Decoder* decoder = stream->decoder;
+  unsigned bpp = LodePNG_InfoColor_getBpp(&decoder->infoRaw.color);
+  if(!decoder->settings.color_convert || LodePNG_InfoColor_equal(&decoder->infoRaw.color, &decoder->infoPng.color)) return 0;
+  /*same check as in LodePNG_decode*/
+  if(!(decoder->infoRaw.color.colorType == 2 || decoder->infoRaw.color.colorType == 6) && !(decoder->infoRaw.color.bitDepth == 8)) return 56;
+  if(stream->width > ((size_t)(-1) - 7) / bpp) return 77; /*error: integer overflow in the size of a row*/
+  if(!ucvector_resize(&stream->converted, ((size_t)stream->width * bpp + 7) / 8)) return 9961;
+  return 0;
+}
+
+/*read the chunks and decode the image data when the IDAT chunks come, the decoder has inspected the header*/
+static void PNGStream_decode(PNGStream* stream)
+{
+  LodePNG_Decoder* decoder = stream->decoder;
+  unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
+  ucvector chunk;
+  
+  ucvector_init(&chunk);
+  decoder->error = PNGStream_readHeader(stream);
+  while(!decoder->error)
+  {
+    size_t chunkLength = LodePNG_chunk_length(stream->header);
+    
+    if(LodePNG_chunk_type_equals(stream->header, "IDAT"))
+    {
+      if(critical_pos == 3) { decoder->error = 84; break; } /*error: the IDAT chunks are not consecutive*/
+      decoder->error = PNGStream_prepareConvert(stream); /*the PLTE chunk is known now*/
+      if(!decoder->error) decoder->error = PNGStream_decodeIdat(stream); /*the header of the next chunk is read*/
+      critical_pos = 3;
+      continue;
+    }
+    
+    /*read the whole chunk, with its header and CRC*/
+    if(!ucvector_resize(&chunk, chunkLength + 12)) { decoder->error = 9962; break; }
+    memcpy(chunk.data, stream->header, 8);
+    if(!PNGStream_read(stream, &chunk.data[8], chunkLength + 4)) { decoder->error = 35; break; } /*error: the data ends in the chunk*/
+    
+    if(LodePNG_chunk_type_equals(chunk.data, "IEND"))
+    {
+      if(!decoder->settings.ignoreCrc && LodePNG_chunk_check_crc(chunk.data)) decoder->error = 57;
+      else if(critical_pos != 3) decoder->error = 53; /*error: no image data, like the empty zlib data in LodePNG_decode*/
+      break;
+    }
+    decodeChunk(decoder, chunk.data, &critical_pos); /*checks the CRC too*/
+    if(!decoder->error) decoder->error = PNGStream_readHeader(stream);
+  }
+  
+  ucvector_cleanup(&chunk);
+}
+
+/*the decoder has inspected the header, return value is error. The piece is only needed with a read function.*/
+static unsigned PNGStream_init(PNGStream* stream, LodePNG_Decoder* decoder, LodePNG_RowFunc row, void* rowdata)
+{
+  unsigned bpp = LodePNG_InfoColor_getBpp(&decoder->infoPng.color);
+  size_t scanlinessize;
+  if(decoder->infoPng.width > ((size_t)(-1) - 7) / bpp) return 77; /*error: integer overflow in the size of a scanline*/
+  /*also for Adam7, whose passes are laid out before anything is inflated*/
+  if(getScanlinesSize(&scanlinessize, &decoder->infoPng)) return 77; /*error: integer overflow in the size of the scanlines*/
+  
+  if(!decoder->settings.color_convert)
+  {
+    /*the rows have the color type of the PNG, and infoRaw tells it, like in LodePNG_decode*/
+    unsigned error = LodePNG_InfoColor_copy(&decoder->infoRaw.color, &decoder->infoPng.color);
+    if(error) return error;
+  }
+  
+  stream->decoder = decoder;
+  stream->row = row;
+  stream->rowdata = rowdata;
+  stream->target = 0;
+  stream->targetstride = 0;
+  stream->idatleft = 0;
+  stream->idatcrc = 0;
+  stream->idatend = 0;
+  stream->error = 0;
+  stream->passes = getDecodedPasses(decoder);
+  LodePNG_getDecodedSize(decoder, &stream->width, &stream->height);
+  stream->rowbytes = ((size_t)stream->width * bpp + 7) / 8;
+  stream->y = 0;
+  stream->linebytes = ((size_t)decoder->infoPng.width * bpp + 7) / 8;
+  stream->adler = 1;
+  ucvector_init(&stream->piece);
+  ucvector_init(&stream->line);
+  ucvector_init(&stream->prevline);
+  ucvector_init(&stream->converted);
+  
+  if((stream->read && !ucvector_resize(&stream->piece, PNG_STREAM_PIECE)) || !ucvector_resizev(&stream->line, stream->linebytes, 0)
+  || !ucvector_resizev(&stream->prevline, stream->linebytes, 0)) return 9963;
+  return 0;
+}
+
+static void PNGStream_cleanup(PNGStream* stream)
+{
+  ucvector_cleanup(&stream->piece);
+  ucvector_cleanup(&stream->line);
+  ucvector_cleanup(&stream->prevline);
+  ucvector_cleanup(&stream->converted);
+}
+
+static void decodeStream(LodePNG_Decoder* decoder, LodePNG_ReadFunc read, void* readdata, LodePNG_RowFunc row, void* rowdata)
+{
+  unsigned char header[33]; /*signature and IHDR chunk*/
+  PNGStream stream;
+  
+  stream.read = read;
+  stream.readdata = readdata;
+  if(!PNGStream_read(&stream, header, 33)) { decoder->error = 27; return; } /*error: the data length is smaller than the length of the header*/
+  LodePNG_inspect(decoder, header, 33); /*reads header and resets other parameters in decoder->infoPng*/
+  if(decoder->error) return;
+  
+  decoder->error = PNGStream_init(&stream, decoder, row, rowdata);
+  if(!decoder->error) PNGStream_decode(&stream);
+  PNGStream_cleanup(&stream);
+}
+
+void LodePNG_decodeStream(LodePNG_Decoder* decoder, LodePNG_ReadFunc read, void* readdata, LodePNG_RowFunc row, void* rowdata)
+{
+  const LodePNG_Allocator* previous = LodePNG_useAllocator(decoder->settings.allocator);
+  decodeStream(decoder, read, readdata, row, rowdata);
+  LodePNG_useAllocator(previous);
+}
+
+/*decode the PNG in memory row by row, to the row function or into the target if it's not 0*/
+static void decodeRows(LodePNG_Decoder* decoder, const unsigned char* in, size_t insize, LodePNG_RowFunc row, void* rowdata,
+                       unsigned char* target, size_t targetstride)
+{
+  PNGStream stream;
+  
+  if(insize == 0 || in == 0) { decoder->error = 48; return; } /*the given data is empty*/
+  LodePNG_inspect(decoder, in, insize); /*reads header and resets other parameters in decoder->infoPng*/
+  if(decoder->error) return;
+  
+  /*all chunks are read first, like in LodePNG_decode, then the IDAT chunks are decompressed where they are*/
+  stream.read = 0;
+  stream.readdata = 0;
+  stream.idat.chunk = decodeChunks(decoder, in, insize);
+  stream.idat.used = 0;
+  if(decoder->error) return;
+  
+  decoder->error = PNGStream_init(&stream, decoder, row, rowdata);
+  stream.target = target;
+  stream.targetstride = targetstride;
+  if(!decoder->error) decoder->error = PNGStream_prepareConvert(&stream);
+  if(!decoder->error) decoder->error = PNGStream_decodeIdat(&stream);
+  PNGStream_cleanup(&stream);
+}
+
+void LodePNG_decodeRows(LodePNG_Decoder* decoder, const unsigned char* in, size_t insize, LodePNG_RowFunc row, void* rowdata)
+{
+  const LodePNG_Allocator* previous = LodePNG_useAllocator(decoder->settings.allocator);
+  decodeRows(decoder, in, insize, row, rowdata, 0, 0);
+  LodePNG_useAllocator(previous);
+}
+
+void LodePNG_decodeInto(LodePNG_Decoder* decoder, unsigned char* out, size_t rowstride, const unsigned char* in, size_t insize)
+{
+  const LodePNG_Allocator* previous;
+  const LodePNG_InfoColor* color;
+  unsigned w, h;
+  
+  if(insize == 0 || in == 0) { decoder->error = 48; return; } /*the given data is empty*/
+  LodePNG_inspect(decoder, in, insize); /*to know the size of the rows before anything is written*/
+  if(decoder->error) return;
+  color = decoder->settings.color_convert ? &decoder->infoRaw.color : &decoder->infoPng.color;
+  LodePNG_getDecodedSize(decoder, &w, &h);
+  if(rowstride < ((size_t)w * LodePNG_InfoColor_getBpp(color) + 7) / 8) { decoder->error = 85; return; } /*error: the rows overlap*/
+  
+  previous = LodePNG_useAllocator(decoder->settings.allocator);
+  decodeRows(decoder, in, insize, 0, 0, out, rowstride);
+  LodePNG_useAllocator(previous);
+}
+
+#ifdef LODEPNG_COMPILE_DISK
+static size_t readFile(void* data, unsigned char* buffer, size_t size)
+{
+  return fread(buffer, 1, size, (FILE*)data);
+}
+
+void LodePNG_decodeFileStream(LodePNG_Decoder* decoder, const char* filename, LodePNG_RowFunc row, void* rowdata)
+{
+  FILE* file = fopen(filename, "rb");
+  if(!file) { decoder->error = 78; return; }
+  LodePNG_decodeStream(decoder, readFile, file, row, rowdata);
+  fclose(file);
 }
 #endif /*LODEPNG_COMPILE_DISK*/
 
@@ -3174,6 +5378,8 @@ void LodePNG_DecodeSettings_init(LodePNG_DecodeSettings* settings)
 #ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
   settings->rememberUnknownChunks = 0;
 #endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
+  settings->adam7Passes = 7;
+  settings->allocator = 0;
   LodeZlib_DecompressSettings_init(&settings->zlibsettings);
 }
 
@@ -3209,7 +5415,7 @@ void LodePNG_Decoder_copy(LodePNG_Decoder* dest, const LodePNG_Decoder* source)
 /* / PNG Encoder                                                            / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-/*chunkName must be string of 4 characters*/
+/*chunkName must be string of 4 characters, out must be allocated with malloc (it's the PNG)*/
 static unsigned addChunk(ucvector* out, const char* chunkName, const unsigned char* data, size_t length)
 {
   unsigned error = LodePNG_create_chunk(&out->data, &out->size, (unsigned)length, chunkName, data);
@@ -3301,14 +5507,14 @@ static unsigned addChunk_tRNS(ucvector* out, const LodePNG_InfoColor* info)
   return error;
 }
 
-static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize, LodeZlib_DeflateSettings* zlibsettings)
+static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize, const LodePNG_EncodeSettings* settings, size_t linebytes)
 {
   ucvector zlibdata;
   unsigned error = 0;
   
-  /*compress with the Zlib compressor*/
+  /*compress with the Zlib compressor, on multiple threads if numThreads isn't 1*/
   ucvector_init(&zlibdata);
-  error = LodePNG_compress(&zlibdata.data, &zlibdata.size, data, datasize, zlibsettings);
+  error = LodePNG_compressParallel(&zlibdata.data, &zlibdata.size, data, datasize, &settings->zlibsettings, settings->numThreads, linebytes);
   if(!error) error = addChunk(out, "IDAT", zlibdata.data, zlibdata.size);
   ucvector_cleanup(&zlibdata);
   
@@ -3339,7 +5545,7 @@ static unsigned addChunk_tEXt(ucvector* out, const char* keyword, const char* te
   return error;
 }
 
-static unsigned addChunk_zTXt(ucvector* out, const char* keyword, const char* textstring, LodeZlib_DeflateSettings* zlibsettings)
+static unsigned addChunk_zTXt(ucvector* out, const char* keyword, const char* textstring, const LodeZlib_DeflateSettings* zlibsettings)
 {
   unsigned error = 0;
   ucvector data, compressed;
@@ -3363,7 +5569,7 @@ static unsigned addChunk_zTXt(ucvector* out, const char* keyword, const char* te
   return error;
 }
 
-static unsigned addChunk_iTXt(ucvector* out, unsigned compressed, const char* keyword, const char* langtag, const char* transkey, const char* textstring, LodeZlib_DeflateSettings* zlibsettings)
+static unsigned addChunk_iTXt(ucvector* out, unsigned compressed, const char* keyword, const char* langtag, const char* transkey, const char* textstring, const LodeZlib_DeflateSettings* zlibsettings)
 {
   unsigned error = 0;
   ucvector data, compressed_data;
@@ -3465,9 +5671,80 @@ static unsigned addChunk_pHYs(ucvector* out, const LodePNG_InfoPng* info)
 
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
+#ifdef LODEPNG_SIMD_X86
+/*SSE2 version of filterScanline for the filter types 1-4 with prevline not NULL. Unlike unfiltering, the left
+neighbours come from the unfiltered scanline, so all filters work on 16 bytes at once, for any bytewidth.*/
+LODEPNG_TARGET("sse2")
+static void filterScanlineSSE2(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline, size_t length, size_t bytewidth, unsigned char filterType)
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t i, first = bytewidth < length ? bytewidth : length;
+  
+  /*the first pixel has no left neighbours, a and c are 0*/
+  for(i = 0; i < first; i++)
+  {
+    if(filterType == 1) out[i] = scanline[i];
+    else if(filterType == 3) out[i] = scanline[i] - prevline[i] / 2;
+    else out[i] = scanline[i] - prevline[i]; /*Paeth predicts b here*/
+  }
+  
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+    __m128i a = _mm_loadu_si128((const __m128i*)&scanline[i - bytewidth]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&prevline[i]);
+    __m128i predicted;
+    if(filterType == 1) predicted = a;
+    else if(filterType == 2) predicted = b;
+    else if(filterType == 3) predicted = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+    else
+    {
+      __m128i c = _mm_loadu_si128((const __m128i*)&prevline[i - bytewidth]);
+      __m128i lo = paethPredictorSSE2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+      __m128i hi = paethPredictorSSE2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+      predicted = _mm_packus_epi16(lo, hi);
+    }
+    _mm_storeu_si128((__m128i*)&out[i], _mm_sub_epi8(x, predicted));
+  }
+  
+  for(; i < length; i++)
+  {
+    if(filterType == 1) out[i] = scanline[i] - scanline[i - bytewidth];
+    else if(filterType == 2) out[i] = scanline[i] - prevline[i];
+    else if(filterType == 3) out[i] = scanline[i] - ((scanline[i - bytewidth] + prevline[i]) / 2);
+    else out[i] = (unsigned char)(scanline[i] - paethPredictor(scanline[i - bytewidth], prevline[i], prevline[i - bytewidth]));
+  }
+}
+
+/*sum of the absolute values of the bytes as signed values, 16 bytes at once with psadbw*/
+LODEPNG_TARGET("sse2")
+static size_t filterSumSSE2(const unsigned char* data, size_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sums = zero;
+  size_t i, sum;
+  for(i = 0; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&data[i]);
+    x = _mm_min_epu8(x, _mm_sub_epi8(zero, x)); /*|x| of signed bytes, as unsigned bytes*/
+    sums = _mm_add_epi32(sums, _mm_sad_epu8(x, zero));
+  }
+  sum = (size_t)(unsigned)_mm_cvtsi128_si32(sums) + (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+  for(; i < length; i++) sum += data[i] < 128 ? data[i] : 256 - data[i];
+  return sum;
+}
+#endif /*LODEPNG_SIMD_X86*/
+
 static void filterScanline(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline, size_t length, size_t bytewidth, unsigned char filterType)
 {
   size_t i;
+#ifdef LODEPNG_SIMD_X86
+  if(prevline && filterType >= 1 && filterType <= 4 && (LodePNG_cpuFeatures() & CPU_SSE2))
+  {
+    filterScanlineSSE2(out, scanline, prevline, length, bytewidth, filterType);
+    return;
+  }
+#endif /*LODEPNG_SIMD_X86*/
   switch(filterType)
   {
     case 0:
@@ -3518,11 +5795,102 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
   }
 }
 
-static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, const LodePNG_InfoColor* info)
+/*the sum of the absolute values of the filtered bytes, as signed values. The smallest is often the best filter.*/
+static size_t filterSum(const unsigned char* data, size_t length)
+{
+  size_t i, sum = 0;
+#ifdef LODEPNG_SIMD_X86
+  if(LodePNG_cpuFeatures() & CPU_SSE2) return filterSumSSE2(data, length);
+#endif /*LODEPNG_SIMD_X86*/
+  for(i = 0; i < length; i++) sum += data[i] < 128 ? data[i] : 256 - data[i];
+  return sum;
+}
+
+/*the Shannon entropy of the filtered bytes times their count, the number of bits the scanline needs with ideal
+Huffman codes if each byte is coded on its own. This is slower than the sum, but gives smaller images more often.*/
+static double filterEntropy(const unsigned char* data, size_t length)
+{
+  unsigned count[4][256]; /*4 histograms so that equal bytes in a row don't wait for each other's increment*/
+  double bits = 0;
+  size_t i;
+  memset(count, 0, sizeof(count));
+  for(i = 0; i + 4 <= length; i += 4)
+  {
+    count[0][data[i]]++;
+    count[1][data[i + 1]]++;
+    count[2][data[i + 2]]++;
+    count[3][data[i + 3]]++;
+  }
+  for(; i < length; i++) count[0][data[i]]++;
+  for(i = 0; i < 256; i++)
+  {
+    unsigned c = count[0][i] + count[1][i] + count[2][i] + count[3][i];
+    if(c) bits += c * log((double)length / c);
+  }
+  return bits / log(2.0);
+}
+
+/*the scanlines from y0 to y1 of an image for the adaptive filtering of filter, which is done per band in parallel*/
+typedef struct FilterBand
+{
+  unsigned char* out;
+  const unsigned char* in;
+  const unsigned char* prevline; /*the scanline above the first one of in, NULL if it's the top of the image*/
+  size_t linebytes;
+  size_t bytewidth;
+  unsigned y0, y1;
+  unsigned strategy; /*filterStrategy of LodePNG_EncodeSettings*/
+  unsigned error;
+} FilterBand;
+
+/*tries the 5 filter types on each scanline of the band and keeps the one with the smallest sum or entropy*/
+static void filterBand(void* data, unsigned index)
+{
+  FilterBand* band = &((FilterBand*)data)[index];
+  size_t linebytes = band->linebytes;
+  ucvector attempt[5]; /*five filtering attempts, one for each filter type*/
+  unsigned type, y;
+  
+  for(type = 0; type < 5; type++) ucvector_init(&attempt[type]);
+  for(type = 0; type < 5; type++)
+  {
+    if(!ucvector_resize(&attempt[type], linebytes)) band->error = 9949;
+  }
+  
+  for(y = band->y0; y < band->y1 && !band->error; y++)
+  {
+    const unsigned char* scanline = &band->in[y * linebytes];
+    const unsigned char* prevline = y == 0 ? band->prevline : scanline - linebytes;
+    double score, smallest = 0;
+    unsigned bestType = 0;
+    
+    for(type = 0; type < 5; type++)
+    {
+      filterScanline(attempt[type].data, scanline, prevline, linebytes, band->bytewidth, type);
+      if(band->strategy == 1) score = filterEntropy(attempt[type].data, linebytes);
+      else score = (double)filterSum(attempt[type].data, linebytes);
+      
+      if(type == 0 || score < smallest)
+      {
+        bestType = type;
+        smallest = score;
+      }
+    }
+    
+    band->out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
+    if(linebytes) memcpy(&band->out[y * (linebytes + 1) + 1], attempt[bestType].data, linebytes);
+  }
+  
+  for(type = 0; type < 5; type++) ucvector_cleanup(&attempt[type]);
+}
+
+static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, const unsigned char* prevline,
+                       const LodePNG_InfoColor* info, const LodePNG_EncodeSettings* settings)
 {
   /*
   For PNG filter method 0
   out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are the scanlines with 1 extra byte per scanline
+  prevline is the scanline above the first one of in, or NULL if in starts at the top of the image or pass
   
   There is a nice heuristic described here: http://www.cs.toronto.edu/~cosmin/pngtech/optipng.html. It says:
    *  If the image type is Palette, or the bit depth is smaller than 8, then do not filter the image (i.e. use fixed filtering, with the filter None).
@@ -3534,8 +5902,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
   unsigned bpp = LodePNG_InfoColor_getBpp(info);
   size_t linebytes = (w * bpp + 7) / 8; /*the width of a scanline in bytes, not including the filter type*/
   size_t bytewidth = (bpp + 7) / 8; /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
-  const unsigned char* prevline = 0;
-  unsigned x, y;
+  unsigned y;
   unsigned heuristic;
   unsigned error = 0;
   
@@ -3557,49 +5924,30 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
       prevline = &in[inindex];
     }
   }
-  else if(heuristic == 1) /*adaptive filtering*/
+  else if(heuristic == 1) /*adaptive filtering, in bands of scanlines on multiple threads*/
   {
-    size_t sum[5];
-    ucvector attempt[5]; /*five filtering attempts, one for each filter type*/
-    size_t smallest = 0;
-    unsigned type, bestType = 0;
+    unsigned numBands = LodePNG_threadCount(settings->numThreads, h), band;
+    FilterBand* bands = (FilterBand*)LodePNG_malloc(numBands * sizeof(FilterBand));
+    if(!bands) return 9957;
     
-    for(type = 0; type < 5; type++) ucvector_init(&attempt[type]);
-    for(type = 0; type < 5; type++)
+    for(band = 0; band < numBands; band++)
     {
-      if(!ucvector_resize(&attempt[type], linebytes)) { error = 9949; break; }
+      bands[band].out = out;
+      bands[band].in = in;
+      bands[band].prevline = prevline;
+      bands[band].linebytes = linebytes;
+      bands[band].bytewidth = bytewidth;
+      bands[band].y0 = (unsigned)(((size_t)h * band) / numBands);
+      bands[band].y1 = (unsigned)(((size_t)h * (band + 1)) / numBands);
+      bands[band].strategy = settings->filterStrategy;
+      bands[band].error = 0;
     }
-    
-    if(!error)
+    LodePNG_parallelFor(filterBand, bands, numBands, numBands);
+    for(band = 0; band < numBands; band++)
     {
-      for(y = 0; y < h; y++)
-      {
-        /*try the 5 filter types*/
-        for(type = 0; type < 5; type++)
-        {
-          filterScanline(attempt[type].data, &in[y * linebytes], prevline, linebytes, bytewidth, type);
-          
-          /*calculate the sum of the result*/
-          sum[type] = 0;
-          for(x = 0; x < attempt[type].size; x+=3) sum[type] += attempt[type].data[x]; /*note that not all pixels are checked to speed this up while still having probably the best choice*/
-        
-          /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-          if(type == 0 || sum[type] < smallest)
-          {
-            bestType = type;
-            smallest = sum[type];
-          }
-        }
-        
-        prevline = &in[y * linebytes];
-    
-        /*now fill the out values*/
-        out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-        for(x = 0; x < linebytes; x++) out[y * (linebytes + 1) + 1 + x] = attempt[bestType].data[x];
-      }
+      if(bands[band].error) error = bands[band].error;
     }
-    
-    for(type = 0; type < 5; type++) ucvector_cleanup(&attempt[type]);
+    LodePNG_free(bands);
   }
   #if 0 /*deflate the scanline with a fixed tree after every filter attempt to see which one deflates best. This is slow, and _does not work as expected_: the heuristic gives smaller result!*/
   else if(heuristic == 2) /*adaptive filtering by using deflate*/
@@ -3660,7 +6008,7 @@ static void Adam7_interlace(unsigned char* out, const unsigned char* in, unsigne
   unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
   unsigned i;
 
-  Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+  if(Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp)) return; /*checked by the caller*/
   
   if(bpp >= 8)
   {
@@ -3704,7 +6052,7 @@ static void Adam7_interlace(unsigned char* out, const unsigned char* in, unsigne
 }
 
 /*out must be buffer big enough to contain uncompressed IDAT chunk data, and in must contain the full image*/
-static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const unsigned char* in, const LodePNG_InfoPng* infoPng) /*return value is error*/
+static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const unsigned char* in, const LodePNG_InfoPng* infoPng, const LodePNG_EncodeSettings* settings) /*return value is error*/
 {
   /*
   This function converts the pure 2D image with the PNG's colortype, into filtered-padded-interlaced data. Steps:
@@ -3719,7 +6067,7 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
   if(infoPng->interlaceMethod == 0)
   {
     *outsize = h + (h * ((w * bpp + 7) / 8)); /*image size plus an extra byte per scanline + possible padding bits*/
-    *out = (unsigned char*)malloc(*outsize);
+    *out = (unsigned char*)LodePNG_malloc(*outsize);
     if(!(*out) && (*outsize)) error = 9950;
 
     if(!error)
@@ -3732,16 +6080,16 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
         if(!error)
         {
           addPaddingBits(padded.data, in, ((w * bpp + 7) / 8) * 8, w * bpp, h);
-          error = filter(*out, padded.data, w, h, &infoPng->color);
+          error = filter(*out, padded.data, w, h, 0, &infoPng->color, settings);
         }
         ucvector_cleanup(&padded);
       }
-      else error = filter(*out, in, w, h, &infoPng->color); /*we can immediatly filter into the out buffer, no other steps needed*/
+      else error = filter(*out, in, w, h, 0, &infoPng->color, settings); /*we can immediatly filter into the out buffer, no other steps needed*/
     }
   }
   else /*interlaceMethod is 1 (Adam7)*/
   {
-    unsigned char* adam7 = (unsigned char*)malloc((h * w * bpp + 7) / 8);
+    unsigned char* adam7 = (unsigned char*)LodePNG_malloc((h * w * bpp + 7) / 8);
     if(!adam7 && ((h * w * bpp + 7) / 8)) error = 9952; /*malloc failed*/
     
     while(!error) /*not a real while loop, used to break out to cleanup to avoid a goto*/
@@ -3749,10 +6097,11 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
       unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
       unsigned i;
       
-      Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+      error = Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+      if(error) break;
       
       *outsize = filter_passstart[7]; /*image size plus an extra byte per scanline + possible padding bits*/
-      *out = (unsigned char*)malloc(*outsize);
+      *out = (unsigned char*)LodePNG_malloc(*outsize);
       if(!(*out) && (*outsize)) { error = 9953; break; }
       
       Adam7_interlace(adam7, in, w, h, bpp);
@@ -3767,21 +6116,21 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
           if(!error)
           {
             addPaddingBits(&padded.data[padded_passstart[i]], &adam7[passstart[i]], ((passw[i] * bpp + 7) / 8) * 8, passw[i] * bpp, passh[i]);
-            error = filter(&(*out)[filter_passstart[i]], &padded.data[padded_passstart[i]], passw[i], passh[i], &infoPng->color);
+            error = filter(&(*out)[filter_passstart[i]], &padded.data[padded_passstart[i]], passw[i], passh[i], 0, &infoPng->color, settings);
           }
           
           ucvector_cleanup(&padded);
         }
         else
         {
-          error = filter(&(*out)[filter_passstart[i]], &adam7[padded_passstart[i]], passw[i], passh[i], &infoPng->color);
+          error = filter(&(*out)[filter_passstart[i]], &adam7[padded_passstart[i]], passw[i], passh[i], 0, &infoPng->color, settings);
         }
       }
       
       break;
     }
 
-    free(adam7);
+    LodePNG_free(adam7);
   }
   
   return error;
@@ -3852,138 +6201,192 @@ static unsigned addUnknownChunks(ucvector* out, unsigned char* data, size_t data
 }
 #endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
 
-void LodePNG_encode(LodePNG_Encoder* encoder, unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h)
+/*check the settings and make the info of the PNG for the image: an UNSAFE copy of infoPng with the size and color type
+changed, it doesn't own the palette and texts and isn't cleaned up. return value is error*/
+static unsigned prepareEncode(LodePNG_InfoPng* info, const LodePNG_Encoder* encoder, const unsigned char* image, unsigned w, unsigned h)
 {
-  LodePNG_InfoPng info;
-  ucvector outv;
-  unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
-  size_t datasize = 0;
-  
-  /*provide some proper output values if error will happen*/
-  *out = 0;
-  *outsize = 0;
-  encoder->error = 0;
+  unsigned error;
   
-  info = encoder->infoPng; /*UNSAFE copy to avoid having to cleanup! but we will only change primitive parameters, and not invoke the cleanup function nor touch the palette's buffer so we use it safely*/
-  info.width = w;
-  info.height = h;
+  *info = encoder->infoPng; /*UNSAFE copy to avoid having to cleanup! but we will only change primitive parameters, and not invoke the cleanup function nor touch the palette's buffer so we use it safely*/
+  info->width = w;
+  info->height = h;
   
   if(encoder->settings.autoLeaveOutAlphaChannel && isFullyOpaque(image, w, h, &encoder->infoRaw.color))
   {
     /*go to a color type without alpha channel*/
-    if(info.color.colorType == 6) info.color.colorType = 2;
-    else if(info.color.colorType == 4) info.color.colorType = 0;
+    if(info->color.colorType == 6) info->color.colorType = 2;
+    else if(info->color.colorType == 4) info->color.colorType = 0;
   }
   
-  if(encoder->settings.zlibsettings.windowSize > 32768) { encoder->error = 60; return; } /*error: windowsize larger than allowed*/
-  if(encoder->settings.zlibsettings.btype > 2) { encoder->error = 61; return; } /*error: unexisting btype*/
-  if(encoder->infoPng.interlaceMethod > 1) { encoder->error = 71; return; } /*error: unexisting interlace mode*/
-  if((encoder->error = checkColorValidity(info.color.colorType, info.color.bitDepth))) return; /*error: unexisting color type given*/
-  if((encoder->error = checkColorValidity(encoder->infoRaw.color.colorType, encoder->infoRaw.color.bitDepth))) return; /*error: unexisting color type given*/
+  if(encoder->settings.zlibsettings.windowSize > 32768) return 60; /*error: windowsize larger than allowed*/
+  if(encoder->settings.zlibsettings.btype > 2) return 61; /*error: unexisting btype*/
+  if(encoder->infoPng.interlaceMethod > 1) return 71; /*error: unexisting interlace mode*/
+  if(encoder->settings.filterStrategy > 1) return 81; /*error: unexisting filter strategy*/
+  if((error = checkColorValidity(info->color.colorType, info->color.bitDepth))) return error; /*error: unexisting color type given*/
+  if((error = checkColorValidity(encoder->infoRaw.color.colorType, encoder->infoRaw.color.bitDepth))) return error; /*error: unexisting color type given*/
   
-  if(!LodePNG_InfoColor_equal(&encoder->infoRaw.color, &info.color))
+  if(!LodePNG_InfoColor_equal(&encoder->infoRaw.color, &info->color))
   {
-    unsigned char* converted;
-    size_t size = (w * h * LodePNG_InfoColor_getBpp(&info.color) + 7) / 8;
-    
-    if((info.color.colorType != 6 && info.color.colorType != 2) || (info.color.bitDepth != 8)) { encoder->error = 59; return; } /*for the output image, only these types are supported*/
-    converted = (unsigned char*)malloc(size);
-    if(!converted && size) encoder->error = 9955; /*error: malloc failed*/
-    if(!encoder->error) encoder->error = LodePNG_convert(converted, image, &info.color, &encoder->infoRaw.color, w, h);
-    if(!encoder->error) preProcessScanlines(&data, &datasize, converted, &info);/*filter(data.data, converted.data, w, h, LodePNG_InfoColor_getBpp(&info.color));*/
-    free(converted);
+    if((info->color.colorType != 6 && info->color.colorType != 2) || (info->color.bitDepth != 8)) return 59; /*for the output image, only these types are supported*/
   }
-  else preProcessScanlines(&data, &datasize, image, &info);/*filter(data.data, image, w, h, LodePNG_InfoColor_getBpp(&info.color));*/
   
-  ucvector_init(&outv);
-  while(!encoder->error) /*not really a while loop, this is only used to break out if an error happens to avoid goto's to do the ucvector cleanup*/
+  return 0;
+}
+
+/*the signature and the chunks that come before the IDAT chunks*/
+static unsigned addChunksBeforeIdat(ucvector* out, const LodePNG_InfoPng* info, const LodePNG_EncodeSettings* settings)
+{
+  unsigned error = 0;
+  
+  /*write signature and chunks*/
+  writeSignature(out);
+  /*IHDR*/
+  addChunk_IHDR(out, info->width, info->height, info->color.bitDepth, info->color.colorType, info->interlaceMethod);
+#ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
+  /*unknown chunks between IHDR and PLTE*/
+  if(info->unknown_chunks.data[0]) { error = addUnknownChunks(out, info->unknown_chunks.data[0], info->unknown_chunks.datasize[0]); if(error) return error; }
+#endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
+  /*PLTE*/
+  if(info->color.colorType == 3)
+  {
+    if(info->color.palettesize == 0 || info->color.palettesize > 256) return 68;
+    addChunk_PLTE(out, &info->color);
+  }
+  if(settings->force_palette && (info->color.colorType == 2 || info->color.colorType == 6))
   {
+    if(info->color.palettesize == 0 || info->color.palettesize > 256) return 68;
+    addChunk_PLTE(out, &info->color);
+  }
+  /*tRNS*/
+  if(info->color.colorType == 3 && !isPaletteFullyOpaque(info->color.palette, info->color.palettesize)) addChunk_tRNS(out, &info->color);
+  if((info->color.colorType == 0 || info->color.colorType == 2) && info->color.key_defined) addChunk_tRNS(out, &info->color);
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    size_t i;
+  /*bKGD (must come between PLTE and the IDAt chunks*/
+  if(info->background_defined) addChunk_bKGD(out, info);
+  /*pHYs (must come before the IDAT chunks)*/
+  if(info->phys_defined) addChunk_pHYs(out, info);
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    /*write signature and chunks*/
-    writeSignature(&outv);
-    /*IHDR*/
-    addChunk_IHDR(&outv, w, h, info.color.bitDepth, info.color.colorType, info.interlaceMethod);
 #ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
-    /*unknown chunks between IHDR and PLTE*/
-    if(info.unknown_chunks.data[0]) { encoder->error = addUnknownChunks(&outv, info.unknown_chunks.data[0], info.unknown_chunks.datasize[0]); if(encoder->error) break; }
+  /*unknown chunks between PLTE and IDAT*/
+  if(info->unknown_chunks.data[1]) { error = addUnknownChunks(out, info->unknown_chunks.data[1], info->unknown_chunks.datasize[1]); if(error) return error; }
 #endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
-    /*PLTE*/
-    if(info.color.colorType == 3)
-    {
-      if(info.color.palettesize == 0 || info.color.palettesize > 256) { encoder->error = 68; break; }
-      addChunk_PLTE(&outv, &info.color);
-    }
-    if(encoder->settings.force_palette && (info.color.colorType == 2 || info.color.colorType == 6))
-    {
-      if(info.color.palettesize == 0 || info.color.palettesize > 256) { encoder->error = 68; break; }
-      addChunk_PLTE(&outv, &info.color);
-    }
-    /*tRNS*/
-    if(info.color.colorType == 3 && !isPaletteFullyOpaque(info.color.palette, info.color.palettesize)) addChunk_tRNS(&outv, &info.color);
-    if((info.color.colorType == 0 || info.color.colorType == 2) && info.color.key_defined) addChunk_tRNS(&outv, &info.color);
+  
+  return error;
+}
+
+/*the chunks that come after the IDAT chunks, up to IEND*/
+static unsigned addChunksAfterIdat(ucvector* out, const LodePNG_InfoPng* info, const LodePNG_EncodeSettings* settings)
+{
+  unsigned error = 0;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*bKGD (must come between PLTE and the IDAt chunks*/
-    if(info.background_defined) addChunk_bKGD(&outv, &info);
-    /*pHYs (must come before the IDAT chunks)*/
-    if(info.phys_defined) addChunk_pHYs(&outv, &info);
+  size_t i;
+  
+  /*tIME*/
+  if(info->time_defined) addChunk_tIME(out, &info->time);
+  /*tEXt and/or zTXt*/
+  for(i = 0; i < info->text.num; i++)
+  {
+    if(strlen(info->text.keys[i]) > 79) return 66;
+    if(strlen(info->text.keys[i]) < 1) return 67;
+    if(settings->text_compression)
+      addChunk_zTXt(out, info->text.keys[i], info->text.strings[i], &settings->zlibsettings);
+    else
+      addChunk_tEXt(out, info->text.keys[i], info->text.strings[i]);
+  }
+  /*LodePNG version id in text chunk*/
+  if(settings->add_id)
+  {
+    unsigned alread_added_id_text = 0;
+    for(i = 0; i < info->text.num; i++)
+      if(!strcmp(info->text.keys[i], "LodePNG")) { alread_added_id_text = 1; break; }
+    if(alread_added_id_text == 0)
+      addChunk_tEXt(out, "LodePNG", VERSION_STRING); /*it's shorter as tEXt than as zTXt chunk*/
+  }
+  /*iTXt*/
+  for(i = 0; i < info->itext.num; i++)
+  {
+    if(strlen(info->itext.keys[i]) > 79) return 66;
+    if(strlen(info->itext.keys[i]) < 1) return 67;
+    addChunk_iTXt(out, settings->text_compression,
+                  info->itext.keys[i], info->itext.langtags[i], info->itext.transkeys[i], info->itext.strings[i], 
+                  &settings->zlibsettings);
+  }
+#else /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  (void)settings;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 #ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
-    /*unknown chunks between PLTE and IDAT*/
-    if(info.unknown_chunks.data[1]) { encoder->error = addUnknownChunks(&outv, info.unknown_chunks.data[1], info.unknown_chunks.datasize[1]); if(encoder->error) break; }
+  /*unknown chunks between IDAT and IEND*/
+  if(info->unknown_chunks.data[2]) { error = addUnknownChunks(out, info->unknown_chunks.data[2], info->unknown_chunks.datasize[2]); if(error) return error; }
 #endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
+  /*IEND*/
+  addChunk_IEND(out);
+  
+  return error;
+}
+
+/*the filtered scanlines of the whole image in *out, converted from the color type of raw to the one of the PNG first*/
+static unsigned preProcessImage(unsigned char** out, size_t* outsize, const unsigned char* image, const LodePNG_InfoPng* info,
+                                const LodePNG_InfoColor* raw, const LodePNG_EncodeSettings* settings)
+{
+  unsigned error = 0;
+  if(!LodePNG_InfoColor_equal(raw, &info->color))
+  {
+    unsigned char* converted;
+    size_t size = (info->width * info->height * LodePNG_InfoColor_getBpp(&info->color) + 7) / 8;
+    
+    converted = (unsigned char*)LodePNG_malloc(size);
+    if(!converted && size) error = 9955; /*error: malloc failed*/
+    if(!error) error = LodePNG_convert(converted, image, &info->color, raw, info->width, info->height);
+    if(!error) error = preProcessScanlines(out, outsize, converted, info, settings);/*filter(data.data, converted.data, w, h, LodePNG_InfoColor_getBpp(&info.color));*/
+    LodePNG_free(converted);
+  }
+  else error = preProcessScanlines(out, outsize, image, info, settings);/*filter(data.data, image, w, h, LodePNG_InfoColor_getBpp(&info.color));*/
+  return error;
+}
+
+static void encodeImage(LodePNG_Encoder* encoder, unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h)
+{
+  LodePNG_InfoPng info;
+  ucvector outv;
+  unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
+  size_t datasize = 0;
+  
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+  *outsize = 0;
+  
+  encoder->error = prepareEncode(&info, encoder, image, w, h);
+  if(encoder->error) return;
+  encoder->error = preProcessImage(&data, &datasize, image, &info, &encoder->infoRaw.color, &encoder->settings);
+  
+  ucvector_init_malloc(&outv);
+  while(!encoder->error) /*not really a while loop, this is only used to break out if an error happens to avoid goto's to do the ucvector cleanup*/
+  {
+    encoder->error = addChunksBeforeIdat(&outv, &info, &encoder->settings);
+    if(encoder->error) break;
     /*IDAT (multiple IDAT chunks must be consecutive)*/
-    encoder->error = addChunk_IDAT(&outv, data, datasize, &encoder->settings.zlibsettings);
+    /*the segments of the zlib stream start at a scanline, or anywhere for the passes of an interlaced image*/
+    encoder->error = addChunk_IDAT(&outv, data, datasize, &encoder->settings,
+                                   info.interlaceMethod == 0 ? (w * LodePNG_InfoColor_getBpp(&info.color) + 7) / 8 + 1 : 1);
     if(encoder->error) break;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*tIME*/
-    if(info.time_defined) addChunk_tIME(&outv, &info.time);
-    /*tEXt and/or zTXt*/
-    for(i = 0; i < info.text.num; i++)
-    {
-      if(strlen(info.text.keys[i]) > 79) { encoder->error = 66; break; }
-      if(strlen(info.text.keys[i]) < 1) { encoder->error = 67; break; }
-      if(encoder->settings.text_compression)
-        addChunk_zTXt(&outv, info.text.keys[i], info.text.strings[i], &encoder->settings.zlibsettings);
-      else
-        addChunk_tEXt(&outv, info.text.keys[i], info.text.strings[i]);
-    }
-    /*LodePNG version id in text chunk*/
-    if(encoder->settings.add_id)
-    {
-      unsigned alread_added_id_text = 0;
-      for(i = 0; i < info.text.num; i++)
-        if(!strcmp(info.text.keys[i], "LodePNG")) { alread_added_id_text = 1; break; }
-      if(alread_added_id_text == 0)
-        addChunk_tEXt(&outv, "LodePNG", VERSION_STRING); /*it's shorter as tEXt than as zTXt chunk*/
-    }
-    /*iTXt*/
-    for(i = 0; i < info.itext.num; i++)
-    {
-      if(strlen(info.itext.keys[i]) > 79) { encoder->error = 66; break; }
-      if(strlen(info.itext.keys[i]) < 1) { encoder->error = 67; break; }
-      addChunk_iTXt(&outv, encoder->settings.text_compression,
-                    info.itext.keys[i], info.itext.langtags[i], info.itext.transkeys[i], info.itext.strings[i], 
-                    &encoder->settings.zlibsettings);
-    }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-#ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
-    /*unknown chunks between IDAT and IEND*/
-    if(info.unknown_chunks.data[2]) { encoder->error = addUnknownChunks(&outv, info.unknown_chunks.data[2], info.unknown_chunks.datasize[2]); if(encoder->error) break; }
-#endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
-    /*IEND*/
-    addChunk_IEND(&outv);
+    encoder->error = addChunksAfterIdat(&outv, &info, &encoder->settings);
     
     break; /*this isn't really a while loop; no error happened so break out now!*/
   }
   
-  free(data);
+  LodePNG_free(data);
   /*instead of cleaning the vector up, give it to the output*/
   *out = outv.data;
   *outsize = outv.size;
 }
 
+void LodePNG_encode(LodePNG_Encoder* encoder, unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h)
+{
+  const LodePNG_Allocator* previous = LodePNG_useAllocator(encoder->settings.allocator);
+  encodeImage(encoder, out, outsize, image, w, h);
+  LodePNG_useAllocator(previous);
+}
+
 unsigned LodePNG_encode32(unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h)
 {
   unsigned error;
@@ -4007,15 +6410,257 @@ unsigned LodePNG_encode32f(const char* filename, const unsigned char* image, uns
 }
 #endif /*LODEPNG_COMPILE_DISK*/
 
+/*
+Streaming encoder: LodePNG_encodeStream gives the PNG to a write function chunk by chunk instead of making it in one
+buffer. The scanlines of an image that isn't interlaced are converted, filtered and deflated a group at a time, with
+a band of ENCODE_STREAM_BAND bytes for each thread, and each group is an IDAT chunk. The deflate data of a group uses
+the 32K before it as dictionary and ends with a sync flush, like the segments of numThreads. So besides the image,
+only a group, its dictionary and the deflate data of two groups are in memory: the IDAT chunk of a group is written
+on another thread while the next group is made, if numThreads isn't 1. The passes of an Adam7 interlaced image take
+their pixels from the whole image, so those are filtered at once like LodePNG_encode does, and only the compression
+and writing go a group at a time.
+*/
+#define ENCODE_STREAM_BAND 1048576 /*filtered bytes per band, the dictionary of each band is hashed again, so not smaller*/
+
+typedef struct IdatStream
+{
+  const unsigned char* image; /*the image of the user, with the color type of raw*/
+  const LodePNG_InfoPng* info;
+  const LodePNG_InfoColor* raw;
+  const LodePNG_EncodeSettings* settings;
+  unsigned numThreads;
+  size_t linebytes; /*bytes of a scanline of the PNG without the filter type*/
+  unsigned y, grouph; /*the first scanline of the next group and the scanlines per group, a multiple of 8*/
+  ucvector rows; /*the scanlines of a group converted or padded, if needed, after the last one of the previous group*/
+  ucvector window; /*the filtered scanlines of a group, after the last dictsize filtered bytes as dictionary*/
+  size_t dictsize;
+  unsigned char* data; /*Adam7: the filtered passes of the whole image, the groups are pieces of datasize bytes*/
+  size_t datasize, pos;
+  ucvector zlibdata; /*the zlib data of a group*/
+  unsigned adler;
+  unsigned done;
+} IdatStream;
+
+/*the vectors of the stream are made before anything can fail, so it must be cleaned up also after an error*/
+static unsigned IdatStream_init(IdatStream* stream, const unsigned char* image, const LodePNG_InfoPng* info,
+                                const LodePNG_InfoColor* raw, const LodePNG_EncodeSettings* settings)
+{
+  unsigned bpp = LodePNG_InfoColor_getBpp(&info->color);
+  unsigned bandh;
+  
+  stream->image = image;
+  stream->info = info;
+  stream->raw = raw;
+  stream->settings = settings;
+  stream->numThreads = LodePNG_threadCount(settings->numThreads, info->height);
+  stream->linebytes = ((size_t)info->width * bpp + 7) / 8;
+  stream->y = 0;
+  stream->dictsize = 0;
+  stream->data = 0;
+  stream->datasize = 0;
+  stream->pos = 0;
+  stream->adler = 1;
+  stream->done = 0;
+  ucvector_init(&stream->rows);
+  ucvector_init(&stream->window);
+  ucvector_init(&stream->zlibdata);
+  addZlibHeader(&stream->zlibdata);
+  
+  if(info->interlaceMethod != 0) return preProcessImage(&stream->data, &stream->datasize, image, info, raw, settings);
+  
+  /*the groups start at a multiple of 8 scanlines, where the pixels of less than 8 bits start at a byte*/
+  bandh = (unsigned)(ENCODE_STREAM_BAND / (stream->linebytes + 1));
+  bandh = bandh < 8 ? 8 : bandh - bandh % 8;
+  stream->grouph = bandh * stream->numThreads;
+  if(stream->grouph > info->height) stream->grouph = info->height;
+  
+  if(!LodePNG_InfoColor_equal(raw, &info->color) || (bpp < 8 && (size_t)info->width * bpp != stream->linebytes * 8))
+  {
+    if(!ucvector_resize(&stream->rows, (stream->grouph + 1) * stream->linebytes)) return 9965;
+  }
+  if(!ucvector_resize(&stream->window, 32768 + stream->grouph * (stream->linebytes + 1))) return 9966;
+  return 0;
+}
+
+static void IdatStream_cleanup(IdatStream* stream)
+{
+  ucvector_cleanup(&stream->rows);
+  ucvector_cleanup(&stream->window);
+  ucvector_cleanup(&stream->zlibdata);
+  LodePNG_free(stream->data);
+}
+
+/*filter and deflate the next group of scanlines*/
+static unsigned IdatStream_scanlines(IdatStream* stream)
+{
+  const LodePNG_InfoPng* info = stream->info;
+  size_t linebytes = stream->linebytes;
+  unsigned w = info->width, h = info->height;
+  unsigned n = h - stream->y < stream->grouph ? h - stream->y : stream->grouph;
+  const unsigned char* scanlines; /*the scanlines of the group with the color type of the PNG*/
+  const unsigned char* prevline; /*the scanline above them*/
+  size_t end, keep;
+  unsigned error = 0;
+  
+  if(stream->rows.size) /*converted or padded, behind the last scanline of the previous group*/
+  {
+    const unsigned char* in = &stream->image[(size_t)stream->y * w * LodePNG_InfoColor_getBpp(stream->raw) / 8];
+    unsigned char* out = &stream->rows.data[linebytes];
+    unsigned bpp = LodePNG_InfoColor_getBpp(&info->color);
+    if(!LodePNG_InfoColor_equal(stream->raw, &info->color)) error = LodePNG_convert(out, in, &info->color, stream->raw, w, n);
+    else addPaddingBits(out, in, linebytes * 8, (size_t)w * bpp, n);
+    scanlines = out;
+    prevline = stream->y == 0 ? 0 : stream->rows.data;
+  }
+  else
+  {
+    scanlines = &stream->image[stream->y * linebytes];
+    prevline = stream->y == 0 ? 0 : scanlines - linebytes;
+  }
+  
+  end = stream->dictsize + n * (linebytes + 1);
+  stream->y += n;
+  stream->done = stream->y == h;
+  if(!error) error = filter(&stream->window.data[stream->dictsize], scanlines, w, n, prevline, &info->color, stream->settings);
+  if(!error) error = deflateSegments(&stream->zlibdata, &stream->adler, stream->window.data, stream->dictsize, end, stream->done,
+                                     &stream->settings->zlibsettings, stream->numThreads, linebytes + 1);
+  if(error) return error;
+  
+  /*the last scanline and the last 32K of filtered data stay for the next group*/
+  if(stream->rows.size && n) memcpy(stream->rows.data, &stream->rows.data[n * linebytes], linebytes);
+  keep = end < 32768 ? end : 32768;
+  memmove(stream->window.data, &stream->window.data[end - keep], keep);
+  stream->dictsize = keep;
+  return 0;
+}
+
+/*deflate the next piece of the filtered passes*/
+static unsigned IdatStream_passes(IdatStream* stream)
+{
+  size_t start = stream->pos, groupsize = ENCODE_STREAM_BAND * stream->numThreads;
+  stream->pos = stream->datasize - start < groupsize ? stream->datasize : start + groupsize;
+  stream->done = stream->pos == stream->datasize;
+  return deflateSegments(&stream->zlibdata, &stream->adler, stream->data, start, stream->pos, stream->done,
+                         &stream->settings->zlibsettings, stream->numThreads, 1);
+}
+
+/*make the IDAT chunk of the next group and append it to chunks, the last one has the Adler-32 checksum*/
+static unsigned IdatStream_next(IdatStream* stream, ucvector* chunks)
+{
+  unsigned error;
+  if(stream->info->interlaceMethod == 0) error = IdatStream_scanlines(stream);
+  else error = IdatStream_passes(stream);
+  if(!error && stream->done) LodeZlib_add32bitInt(&stream->zlibdata, stream->adler);
+  if(!error) error = addChunk(chunks, "IDAT", stream->zlibdata.data, stream->zlibdata.size);
+  stream->zlibdata.size = 0;
+  return error;
+}
+
+/*the chunks made so far, made with malloc like the output of LodePNG_encode, and the write function they go to*/
+typedef struct PNGWriter
+{
+  LodePNG_WriteFunc write;
+  void* data;
+  ucvector chunks;
+  unsigned error;
+} PNGWriter;
+
+/*write the chunks and empty the buffer for the next ones*/
+static unsigned PNGWriter_flush(PNGWriter* writer)
+{
+  size_t size = writer->chunks.size;
+  writer->chunks.size = 0;
+  if(size && writer->write(writer->data, writer->chunks.data, size) != size) return 86; /*error: the write function failed*/
+  return 0;
+}
+
+/*for parallelFor: 0 makes the next group on the thread of the caller (with its allocator), 1 writes the previous one*/
+typedef struct IdatStreamStep
+{
+  IdatStream* stream;
+  PNGWriter* next;
+  PNGWriter* previous;
+} IdatStreamStep;
+
+static void IdatStream_step(void* data, unsigned index)
+{
+  IdatStreamStep* step = (IdatStreamStep*)data;
+  if(index == 0) step->next->error = IdatStream_next(step->stream, &step->next->chunks);
+  else step->previous->error = PNGWriter_flush(step->previous);
+}
+
+static void encodeStream(LodePNG_Encoder* encoder, LodePNG_WriteFunc write, void* writedata, const unsigned char* image, unsigned w, unsigned h)
+{
+  LodePNG_InfoPng info;
+  IdatStream stream;
+  IdatStreamStep step;
+  PNGWriter writers[2]; /*the IDAT chunks of two groups, one is written while the other is made*/
+  unsigned i, current = 0;
+  
+  encoder->error = prepareEncode(&info, encoder, image, w, h);
+  if(encoder->error) return;
+  
+  for(i = 0; i < 2; i++)
+  {
+    writers[i].write = write;
+    writers[i].data = writedata;
+    ucvector_init_malloc(&writers[i].chunks);
+    writers[i].error = 0;
+  }
+  
+  encoder->error = IdatStream_init(&stream, image, &info, &encoder->infoRaw.color, &encoder->settings);
+  if(!encoder->error) encoder->error = addChunksBeforeIdat(&writers[0].chunks, &info, &encoder->settings);
+  if(!encoder->error) encoder->error = IdatStream_next(&stream, &writers[0].chunks);
+  while(!encoder->error && !stream.done)
+  {
+    step.stream = &stream;
+    step.previous = &writers[current];
+    step.next = &writers[1 - current];
+    LodePNG_parallelFor(IdatStream_step, &step, 2, encoder->settings.numThreads == 1 ? 1 : 2);
+    encoder->error = step.previous->error ? step.previous->error : step.next->error;
+    current = 1 - current;
+  }
+  if(!encoder->error) encoder->error = addChunksAfterIdat(&writers[current].chunks, &info, &encoder->settings);
+  if(!encoder->error) encoder->error = PNGWriter_flush(&writers[current]);
+  
+  IdatStream_cleanup(&stream);
+  for(i = 0; i < 2; i++) ucvector_cleanup(&writers[i].chunks);
+}
+
+void LodePNG_encodeStream(LodePNG_Encoder* encoder, LodePNG_WriteFunc write, void* writedata, const unsigned char* image, unsigned w, unsigned h)
+{
+  const LodePNG_Allocator* previous = LodePNG_useAllocator(encoder->settings.allocator);
+  encodeStream(encoder, write, writedata, image, w, h);
+  LodePNG_useAllocator(previous);
+}
+
+#ifdef LODEPNG_COMPILE_DISK
+static size_t writeFile(void* data, const unsigned char* buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, (FILE*)data);
+}
+
+void LodePNG_encodeFileStream(LodePNG_Encoder* encoder, const char* filename, const unsigned char* image, unsigned w, unsigned h)
+{
+  FILE* file = fopen(filename, "wb");
+  if(!file) { encoder->error = 79; return; }
+  LodePNG_encodeStream(encoder, writeFile, file, image, w, h);
+  if(fclose(file) != 0 && !encoder->error) encoder->error = 86; /*the buffered data couldn't be written*/
+}
+#endif /*LODEPNG_COMPILE_DISK*/
+
 void LodePNG_EncodeSettings_init(LodePNG_EncodeSettings* settings)
 {
   LodeZlib_DeflateSettings_init(&settings->zlibsettings);
   settings->autoLeaveOutAlphaChannel = 1;
   settings->force_palette = 0;
+  settings->filterStrategy = 0;
+  settings->numThreads = 1;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   settings->add_id = 1;
   settings->text_compression = 0;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  settings->allocator = 0;
 }
 
 void LodePNG_Encoder_init(LodePNG_Encoder* encoder)
@@ -4136,6 +6781,7 @@ namespace LodePNG
 
   unsigned Decoder::getWidth() const { return infoPng.width; }
   unsigned Decoder::getHeight() const { return infoPng.height; }
+  void Decoder::getDecodedSize(unsigned& w, unsigned& h) const { LodePNG_getDecodedSize(this, &w, &h); }
   unsigned Decoder::getBpp() { return LodePNG_InfoColor_getBpp(&infoPng.color); }
   unsigned Decoder::getChannels() { return LodePNG_InfoColor_getChannels(&infoPng.color); }
   unsigned Decoder::isGreyscaleType() { return LodePNG_InfoColor_isGreyscaleType(&infoPng.color); }
@@ -4168,6 +6814,28 @@ namespace LodePNG
     inspect(in.empty() ? 0 : &in[0], in.size());
   }
   
+  void Decoder::decodeStream(LodePNG_ReadFunc read, void* readdata, LodePNG_RowFunc row, void* rowdata)
+  {
+    LodePNG_decodeStream(this, read, readdata, row, rowdata);
+  }
+  
+#ifdef LODEPNG_COMPILE_DISK
+  void Decoder::decodeStream(const std::string& filename, LodePNG_RowFunc row, void* rowdata)
+  {
+    LodePNG_decodeFileStream(this, filename.c_str(), row, rowdata);
+  }
+#endif //LODEPNG_COMPILE_DISK
+  
+  void Decoder::decodeRows(const unsigned char* in, size_t insize, LodePNG_RowFunc row, void* rowdata)
+  {
+    LodePNG_decodeRows(this, in, insize, row, rowdata);
+  }
+  
+  void Decoder::decodeInto(unsigned char* out, size_t rowstride, const unsigned char* in, size_t insize)
+  {
+    LodePNG_decodeInto(this, out, rowstride, in, insize);
+  }
+  
   const LodePNG_DecodeSettings& Decoder::getSettings() const { return settings; }
   LodePNG_DecodeSettings& Decoder::getSettings() { return settings; }
   void Decoder::setSettings(const LodePNG_DecodeSettings& settings) { this->settings = settings; }
@@ -4207,6 +6875,18 @@ namespace LodePNG
     encode(out, image.empty() ? 0 : &image[0], w, h);
   }
   
+  void Encoder::encodeStream(LodePNG_WriteFunc write, void* writedata, const unsigned char* image, unsigned w, unsigned h)
+  {
+    LodePNG_encodeStream(this, write, writedata, image, w, h);
+  }
+  
+#ifdef LODEPNG_COMPILE_DISK
+  void Encoder::encodeStream(const std::string& filename, const unsigned char* image, unsigned w, unsigned h)
+  {
+    LodePNG_encodeFileStream(this, filename.c_str(), image, w, h);
+  }
+#endif //LODEPNG_COMPILE_DISK
+  
   void Encoder::clearPalette() { LodePNG_InfoColor_clearPalette(&infoPng.color); }
   void Encoder::addPalette(unsigned char r, unsigned char g, unsigned char b, unsigned char a) { error = LodePNG_InfoColor_addPalette(&infoPng.color, r, g, b, a); }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
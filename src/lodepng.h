@@ -43,6 +43,50 @@ freely, subject to the following restrictions:
 #define LODEPNG_COMPILE_DISK             /*the optional built in harddisk file loading and saving functions*/
 #define LODEPNG_COMPILE_ANCILLARY_CHUNKS /*any code or struct datamember related to chunks other than IHDR, IDAT, PLTE, tRNS, IEND*/
 #define LODEPNG_COMPILE_UNKNOWN_CHUNKS   /*handling of unknown chunks*/
+#define LODEPNG_COMPILE_SIMD             /*x86 SIMD versions of some inner loops, chosen at runtime by the CPU features*/
+#define LODEPNG_COMPILE_THREADS          /*use threads (pthreads or Win32) in the encoder, see numThreads of LodePNG_EncodeSettings*/
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* Memory Allocation                                                          */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+/*
+allocator for the internal buffers of a decoder or encoder (see the allocator of LodePNG_DecodeSettings and
+LodePNG_EncodeSettings), the functions work like malloc, realloc and free. data is given to each call.
+*/
+typedef struct LodePNG_Allocator
+{
+  void* (*allocate)(void* data, size_t size);
+  void* (*reallocate)(void* data, void* ptr, size_t size); /*ptr can be NULL*/
+  void (*deallocate)(void* data, void* ptr); /*ptr can be NULL*/
+  void* data;
+} LodePNG_Allocator;
+
+/*
+arena (bump) allocator: allocations are taken one after another from large blocks, and freed all at once with
+LodePNG_Arena_reset, e.g. after each image of a batch. The last allocation grows in place when there is room. After
+the first image, the arena has one block as big as the most memory used so far, so the next images of that size need
+no malloc at all. Memory that is freed, or left behind by a reallocation that can't grow in place, is only reused
+after the reset, so an arena uses more memory than malloc for the same image. An arena must be used by one decoder
+or encoder at a time.
+*/
+typedef struct LodePNG_Arena
+{
+  LodePNG_Allocator allocator; /*give &arena.allocator to the settings of a decoder or encoder*/
+  void* blocks; /*the blocks gotten from malloc, the newest one first*/
+  size_t blockSize; /*the minimum size of a block*/
+  size_t used; /*bytes used in the newest block*/
+  size_t last; /*offset of the last allocation in the newest block*/
+  size_t total; /*bytes used in all blocks since the last reset*/
+  /*statistics since LodePNG_Arena_init*/
+  size_t allocations; /*calls of allocate and reallocate*/
+  size_t blockAllocations; /*mallocs of blocks*/
+  size_t peak; /*the largest total*/
+} LodePNG_Arena;
+
+void LodePNG_Arena_init(LodePNG_Arena* arena, size_t blockSize); /*blockSize 0 means 64KB*/
+void LodePNG_Arena_reset(LodePNG_Arena* arena); /*frees all allocations, and merges the blocks into one if there are several*/
+void LodePNG_Arena_cleanup(LodePNG_Arena* arena); /*frees the blocks*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
 /* LodeFlate & LodeZlib Setting structs                                       */
@@ -52,6 +96,7 @@ freely, subject to the following restrictions:
 typedef struct LodeZlib_DecompressSettings
 {
   unsigned ignoreAdler32;
+  unsigned huffmanTable; /*decode Huffman codes with lookup tables instead of walking the code tree bit by bit. Default: yes*/
 } LodeZlib_DecompressSettings;
 
 extern const LodeZlib_DecompressSettings LodeZlib_defaultDecompressSettings;
@@ -65,10 +110,15 @@ typedef struct LodeZlib_DeflateSettings /*deflate = compress*/
   unsigned btype; /*the block type for LZ*/
   unsigned useLZ77; /*whether or not to use LZ77*/
   unsigned windowSize; /*the maximum is 32768*/
+  unsigned chainLength; /*how many earlier positions with the same hash are tested for each match*/
+  unsigned niceMatch; /*stop searching once a match of this length is found (3 - 258)*/
+  unsigned lazyMatching; /*only use a match if the next byte doesn't start a longer one*/
 } LodeZlib_DeflateSettings;
 
 extern const LodeZlib_DeflateSettings LodeZlib_defaultDeflateSettings;
 void LodeZlib_DeflateSettings_init(LodeZlib_DeflateSettings* settings);
+/*sets the settings from a compression level: 0 = no compression, 1 = fastest, 9 = smallest, the default is 6*/
+void LodeZlib_DeflateSettings_setLevel(LodeZlib_DeflateSettings* settings, unsigned level);
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #ifdef LODEPNG_COMPILE_ZLIB
@@ -77,8 +127,9 @@ void LodeZlib_DeflateSettings_init(LodeZlib_DeflateSettings* settings);
 /* ////////////////////////////////////////////////////////////////////////// */
 
 #ifdef LODEPNG_COMPILE_DECODER
-/*This function reallocates the out buffer and appends the data.
-Either, *out must be NULL and *outsize must be 0, or, *out must be a valid buffer and *outsize its size in bytes.*/
+/*This function decompresses into the out buffer from its start, and reallocates it if the data doesn't fit.
+Either, *out must be NULL and *outsize must be 0, or, *out must be a valid buffer and *outsize its size in bytes.
+If the size of the data is known, a buffer of that size is never reallocated. *outsize is set to the size of the data.*/
 unsigned LodeZlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize, const LodeZlib_DecompressSettings* settings);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -271,10 +322,11 @@ void LodePNG_InfoRaw_cleanup(LodePNG_InfoRaw* info);
 unsigned LodePNG_InfoRaw_copy(LodePNG_InfoRaw* dest, const LodePNG_InfoRaw* source);
 
 /*
-LodePNG_convert: Converts from any color type to 24-bit or 32-bit (later maybe more supported). return value = LodePNG error code
+LodePNG_convert: Converts from any color type to 24-bit or 32-bit, from greyscale to 8-bit greyscale (with alpha) and
+from palette to 8-bit palette indices. return value = LodePNG error code
 The out buffer must have (w * h * bpp + 7) / 8, where bpp is the bits per pixel of the output color type (LodePNG_InfoColor_getBpp)
 */
-unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, LodePNG_InfoColor* infoOut, LodePNG_InfoColor* infoIn, unsigned w, unsigned h);
+unsigned LodePNG_convert(unsigned char* out, const unsigned char* in, const LodePNG_InfoColor* infoOut, const LodePNG_InfoColor* infoIn, unsigned w, unsigned h);
 
 #ifdef LODEPNG_COMPILE_DECODER
 
@@ -292,6 +344,10 @@ typedef struct LodePNG_DecodeSettings
 #ifdef LODEPNG_COMPILE_UNKNOWN_CHUNKS
   unsigned rememberUnknownChunks; /*store all bytes from unknown chunks in the InfoPng (off by default, useful for a png editor)*/
 #endif /*LODEPNG_COMPILE_UNKNOWN_CHUNKS*/
+
+  unsigned adam7Passes; /*decode only the first 1-7 passes of Adam7 interlaced images, into a preview of lower resolution (see LodePNG_getDecodedSize). Default: 7, the whole image*/
+  
+  const LodePNG_Allocator* allocator; /*allocator of the buffers used while decoding, NULL for malloc. The decoded image is always allocated with malloc. Default: NULL*/
 } LodePNG_DecodeSettings;
 
 void LodePNG_DecodeSettings_init(LodePNG_DecodeSettings* settings);
@@ -316,6 +372,34 @@ unsigned LodePNG_decode32(unsigned char** out, unsigned* w, unsigned* h, const u
 unsigned LodePNG_decode32f(unsigned char** out, unsigned* w, unsigned* h, const char* filename);
 #endif /*LODEPNG_COMPILE_DISK*/
 void LodePNG_inspect(LodePNG_Decoder* decoder, const unsigned char* in, size_t size); /*read the png header*/
+/*the size of the decoded image after inspect: the size of the PNG, or of the preview if only the first Adam7 passes are decoded*/
+void LodePNG_getDecodedSize(const LodePNG_Decoder* decoder, unsigned* w, unsigned* h);
+/*
+Streaming decoding: the PNG is read with the read function and the image is given row by row to the row function,
+without having the file or the whole image in memory (see the chapter about the Decoder).
+The read function reads at most size bytes into buffer and returns how many, 0 at the end of the data. The row
+function gets row y of the image (rowsize bytes, with the color type of infoRaw) and returns 0 to continue or any
+other value to stop the decoding with error 82.
+*/
+typedef size_t (*LodePNG_ReadFunc)(void* data, unsigned char* buffer, size_t size);
+typedef unsigned (*LodePNG_RowFunc)(void* data, const LodePNG_Decoder* decoder, unsigned y, const unsigned char* row, size_t rowsize);
+void LodePNG_decodeStream(LodePNG_Decoder* decoder, LodePNG_ReadFunc read, void* readdata, LodePNG_RowFunc row, void* rowdata);
+#ifdef LODEPNG_COMPILE_DISK
+void LodePNG_decodeFileStream(LodePNG_Decoder* decoder, const char* filename, LodePNG_RowFunc row, void* rowdata);
+#endif /*LODEPNG_COMPILE_DISK*/
+/*the same as LodePNG_decodeStream for a PNG in memory, the IDAT data is decompressed where it is in the input*/
+void LodePNG_decodeRows(LodePNG_Decoder* decoder, const unsigned char* in, size_t insize, LodePNG_RowFunc row, void* rowdata);
+/*
+Decodes into a buffer of the caller: row y of the image starts at out + y * rowstride. out must have at least
+rowstride * (h - 1) + (w * bpp + 7) / 8 bytes, with the bpp of infoRaw, use LodePNG_inspect to size it first.
+*/
+void LodePNG_decodeInto(LodePNG_Decoder* decoder, unsigned char* out, size_t rowstride, const unsigned char* in, size_t insize);
+/*
+LodePNG_unfilter: undoes the PNG filters of a non-interlaced image, or of a single Adam7 pass. return value = LodePNG error code
+in has the scanlines with the filter type byte in front of each, as they come out of the zlib decompression, out must
+have h * ((w * bpp + 7) / 8) bytes, bpp is the bits per pixel of the PNG color type. in and out may be the same address.
+*/
+unsigned LodePNG_unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp);
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -327,10 +411,13 @@ typedef struct LodePNG_EncodeSettings
   
   unsigned autoLeaveOutAlphaChannel; /*automatically use color type without alpha instead of given one, if given image is opaque*/
   unsigned force_palette; /*force creating a PLTE chunk if colortype is 2 or 6 (= a suggested palette). If colortype is 3, PLTE is _always_ created.*/
+  unsigned filterStrategy; /*how the filter type of each scanline is chosen: 0 = smallest sum of absolute values, 1 = smallest entropy. Default: 0*/
+  unsigned numThreads; /*number of threads the encoder uses for filtering and compression, 0 means one per CPU. Default: 1*/
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   unsigned add_id; /*add LodePNG version as text chunk*/
   unsigned text_compression; /*encode text chunks as zTXt chunks instead of tEXt chunks, and use compression in iTXt chunks*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  const LodePNG_Allocator* allocator; /*allocator of the buffers used while encoding, NULL for malloc. The PNG is always allocated with malloc, and the extra threads of numThreads use malloc. Default: NULL*/
 } LodePNG_EncodeSettings;
 
 void LodePNG_EncodeSettings_init(LodePNG_EncodeSettings* settings);
@@ -353,6 +440,17 @@ unsigned LodePNG_encode32(unsigned char** out, size_t* outsize, const unsigned c
 #ifdef LODEPNG_COMPILE_DISK
 unsigned LodePNG_encode32f(const char* filename, const unsigned char* image, unsigned w, unsigned h);
 #endif /*LODEPNG_COMPILE_DISK*/
+/*
+Streaming encoding: the PNG is given to the write function chunk by chunk while the image is encoded a band of
+scanlines at a time, without the whole PNG or filtered image in memory (see the chapter about the Encoder).
+The write function writes size bytes of buffer and returns how many it wrote, less than size stops the encoding with
+error 86. If numThreads isn't 1, it's called on another thread than the caller, one call at a time, in order.
+*/
+typedef size_t (*LodePNG_WriteFunc)(void* data, const unsigned char* buffer, size_t size);
+void LodePNG_encodeStream(LodePNG_Encoder* encoder, LodePNG_WriteFunc write, void* writedata, const unsigned char* image, unsigned w, unsigned h);
+#ifdef LODEPNG_COMPILE_DISK
+void LodePNG_encodeFileStream(LodePNG_Encoder* encoder, const char* filename, const unsigned char* image, unsigned w, unsigned h);
+#endif /*LODEPNG_COMPILE_DISK*/
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_PNG*/
 
@@ -403,6 +501,14 @@ namespace LodePNG
     void inspect(const unsigned char* in, size_t size);
     void inspect(const std::vector<unsigned char>& in);
     
+    //streaming decoding, row by row (see LodePNG_decodeStream)
+    void decodeStream(LodePNG_ReadFunc read, void* readdata, LodePNG_RowFunc row, void* rowdata);
+#ifdef LODEPNG_COMPILE_DISK
+    void decodeStream(const std::string& filename, LodePNG_RowFunc row, void* rowdata);
+#endif //LODEPNG_COMPILE_DISK
+    void decodeRows(const unsigned char* in, size_t insize, LodePNG_RowFunc row, void* rowdata);
+    void decodeInto(unsigned char* out, size_t rowstride, const unsigned char* in, size_t insize);
+    
     //error checking after decoding
     bool hasError() const;
     unsigned getError() const;
@@ -410,6 +516,7 @@ namespace LodePNG
     //convenient access to some InfoPng parameters after decoding
     unsigned getWidth() const;
     unsigned getHeight() const;
+    void getDecodedSize(unsigned& w, unsigned& h) const; //smaller than the PNG for a preview (adam7Passes)
     unsigned getBpp(); //bits per pixel
     unsigned getChannels(); //amount of channels
     unsigned isGreyscaleType(); //is it a greyscale type? (colorType 0 or 4)
@@ -448,6 +555,11 @@ namespace LodePNG
     
     void encode(std::vector<unsigned char>& out, const unsigned char* image, unsigned w, unsigned h);
     void encode(std::vector<unsigned char>& out, const std::vector<unsigned char>& image, unsigned w, unsigned h);
+    //streaming encoding with a write function, or into a file
+    void encodeStream(LodePNG_WriteFunc write, void* writedata, const unsigned char* image, unsigned w, unsigned h);
+#ifdef LODEPNG_COMPILE_DISK
+    void encodeStream(const std::string& filename, const unsigned char* image, unsigned w, unsigned h);
+#endif //LODEPNG_COMPILE_DISK
     
     //error checking after decoding
     bool hasError() const;
@@ -791,6 +903,37 @@ image, and store the information from it in the LodePNG_InfoPng (see below).
 This allows knowing information about the image without decoding it. Only the
 header (IHDR) information is read by this, not text chunks, not the palette, ...
 
+To decode a large image without having the PNG file and the whole raw image in
+memory, use LodePNG_decodeStream (decodeStream in C++). It reads the PNG with a
+read function you give, e.g. from a file or a socket, and calls a row function
+with each row of the raw image as soon as it is decompressed, e.g. to upload the
+image in strips or to scale it down on the fly. The row has the color type of
+LodePNG_InfoRaw, like the result of decode, and the info of the PNG is in the
+decoder when the first row comes. Besides the chunks other than IDAT, only a
+piece of the input, the 32K window of the decompression and a few rows are in
+memory. Adam7 interlaced images are an exception: their rows are only complete
+after the last pass, so their image data is decompressed as a whole first.
+LodePNG_decodeFileStream reads the PNG from a file, and LodePNG_decodeRows does
+the same for a PNG that is in memory already.
+
+To decode into memory you manage yourself, e.g. a mapped pixel buffer of OpenGL
+or rows with a pitch for alignment, use LodePNG_decodeInto (decodeInto in C++).
+Row y of the image is written at out + y * rowstride; call inspect first to know
+the size of the image and allocate the buffer. Each scanline is unfiltered and
+converted into its row of out as soon as it's decompressed, so besides out only
+the 32K window and a few rows are in memory. LodePNG_decode does the same for
+images that are not interlaced and have rows of whole bytes, so the image is in
+memory once instead of as the decompressed, unfiltered and converted copies.
+
+For a quick preview of an Adam7 interlaced image, set adam7Passes of the
+settings to less than 7: only the first passes are decompressed and the result
+is the image in the resolution of the last pass, e.g. 1/8 of the width and
+height after pass 1, and the full width with 1/2 of the height after pass 6. The
+decoding stops as soon as the scanlines of these passes are inflated, so the
+rest of the IDAT data isn't read. LodePNG_getDecodedSize gives the size of the
+preview, which is also the size of the rows that LodePNG_decodeInto writes.
+Images that are not interlaced are always decoded whole.
+
 During the decoding it's possible that an error can happen, for example if the
 PNG image was corrupted. To check if an error happened during the last decoding,
 check the value error, which is a member of the decoder struct.
@@ -827,6 +970,8 @@ PNG, then the decoder will automatically convert the result to your LodePNG_Info
 settings. Currently the following options are supported to convert to:
 -colorType 6, bitDepth 8: 32-bit RGBA
 -colorType 2, bitDepth 8: 24-bit RGB
+-colorType 0 or 4, bitDepth 8: 8-bit greyscale (with alpha), from greyscale PNGs only
+-colorType 3, bitDepth 8: one byte per palette index, from palette PNGs only
 -other color types if it's exactly the same as that in the PNG image
 
 Palette of LodePNG_InfoRaw isn't used by the Decoder, when converting from palette color
@@ -847,6 +992,18 @@ is done, the resulting data will be as it was in the PNG (after decompression)
 and you'll have to puzzle the colors of the pixels together yourself using the
 color type information in the LodePNG_InfoPng.
 
+The setting allocator gives the memory of the buffers the decoder uses while
+decoding, instead of malloc. The decoded image of LodePNG_decode is still
+allocated with malloc, so you free it as usual. To decode a batch of images
+without allocating memory for each one, give it a LodePNG_Arena and call
+LodePNG_Arena_reset after each image:
+
+LodePNG_Arena arena;
+LodePNG_Arena_init(&arena, 0);
+decoder.settings.allocator = &arena.allocator;
+for each image: LodePNG_decodeInto(&decoder, ...); LodePNG_Arena_reset(&arena);
+LodePNG_Arena_cleanup(&arena);
+
 
 6. Encoder
 ----------
@@ -892,6 +1049,19 @@ In the C version, you need to use the LodePNG_Encoder_init function before using
 and the LodePNG_Encoder_cleanup function after using it.
 In the C++ version, you don't need to do this since RAII takes care of it.
 
+To write a large image without the whole PNG in memory, use LodePNG_encodeStream
+(encodeStream in C++) with a write function, or LodePNG_encodeFileStream to
+write a file. The chunks are given to the write function as soon as they're
+made, and the scanlines are converted, filtered and compressed in groups of
+about 1 MB per thread, each of which becomes an IDAT chunk. Besides the image,
+only a group, the 32K dictionary before it and the compressed data of two groups
+are in memory. If numThreads isn't 1, a group is written on another thread while
+the next one is made, so the encoding goes on while the data goes to the disk.
+Each group ends with a sync flush and has its own Huffman codes, like the
+segments of numThreads, so the size of the PNG differs a little from the one of
+LodePNG_encode. Adam7 interlaced images are filtered as a whole, only their
+compression goes group by group.
+
 The encoder generates some errors but not for everything, because, unlike when
 decoding a PNG, when encoding one there aren't so much parameters of the input
 that can be corrupted. It's the responsibility of the user to make sure that all
@@ -957,6 +1127,25 @@ channel, resulting in a smaller PNG image.
 *) btype: the block type for LZ77. 0 = uncompressed, 1 = fixed huffman tree, 2 = dynamic huffman tree (best compression)
 *) useLZ77: whether or not to use LZ77 for compressed block types
 *) windowSize: the window size used by the LZ77 encoder (1 - 32768)
+*) chainLength: how many earlier positions with the same hash the LZ77 encoder
+   tests for each match. Larger gives a smaller result but is slower.
+*) niceMatch: the LZ77 encoder stops searching once it found a match this long
+*) lazyMatching: the LZ77 encoder only uses a match if the next byte doesn't
+   start a longer one, which gives a smaller result but is slower
+LodeZlib_DeflateSettings_setLevel sets btype and the LZ77 settings from a
+compression level from 0 (no compression) and 1 (fastest) to 9 (smallest).
+*) filterStrategy: how the filter type of each scanline is chosen, if the image
+   isn't palettized and has a bit depth of at least 8: 0 = the smallest sum of
+   the absolute values of the filtered bytes (as signed values), 1 = the
+   smallest entropy of the filtered bytes, which is slower but often smaller.
+*) numThreads: the number of threads that filter the scanlines in bands and
+   compress them, 0 means one per CPU. It needs LODEPNG_COMPILE_THREADS. The
+   filtering is the same for any number of threads. Images of at least 256 KB
+   of scanlines are compressed in segments of whole scanlines, one per thread,
+   like pigz does: each segment ends with a sync flush (an empty stored block)
+   and uses the 32768 bytes before it as dictionary, and the Adler-32 checksums
+   of the segments are combined. The result is a valid zlib stream that any
+   decoder reads, but its size and bytes depend on the number of threads.
 *) force_palette: if colorType is 2 or 6, you can make the encoder write a PLTE
    chunk if force_palette is true. This can used as suggested palette to convert
    to by viewers that don't support more than 256 colors (if those still exist)
@@ -965,6 +1154,9 @@ channel, resulting in a smaller PNG image.
   zTXt chunks use zlib compression on the text. This gives a smaller result on
   large texts but a larger result on small texts (such as a single program name).
   It's all tEXt or all zTXt though, there's no separate setting per text yet.
+*) allocator: gives the memory of the buffers the encoder uses while encoding,
+  like the allocator of the decoder. The PNG is still allocated with malloc,
+  and the extra threads of numThreads use malloc.
 
 
 7. color conversions
@@ -1028,6 +1220,7 @@ any type of PNG image and can convert it to certain types of raw image, while th
 encoder supports any type of raw data but only certain color types for the output PNG.
 -The converter can convert from _any_ input color type, to 24-bit RGB or 32-bit RGBA
 -The converter can convert from greyscale input color type, to 8-bit greyscale or greyscale with alpha
+-The converter can convert from palette input color type, to 8-bit palette indices
 -If both color types are the same, conversion from anything to anything is possible
 -Color types that are invalid according to the PNG specification are not allowed
 -When converting from a type with alpha channel to one without, the alpha channel information is discarded
@@ -1205,7 +1398,8 @@ The meanings of the LodePNG error values:
 *) 0: no error, everything went ok
 *) 1: the Encoder/Decoder has done nothing yet, so error checking makes no sense yet
 *) 10: while huffman decoding: end of input memory reached without endcode
-*) 11: while huffman decoding: error in code tree made it jump outside of tree
+*) 11: while huffman decoding: error in code tree made it jump outside of tree, or the
+       bits in the stream aren't a code of the tree
 *) 13: problem while processing dynamic deflate block
 *) 14: problem while processing dynamic deflate block
 *) 15: problem while processing dynamic deflate block
@@ -1279,6 +1473,12 @@ The meanings of the LodePNG error values:
 *) 78: file doesn't exist or couldn't be opened for reading
 *) 79: file couldn't be opened for writing
 *) 80: tried creating a tree for 0 symbols
+*) 81: invalid filterStrategy given in the settings of the encoder (only 0 and 1 are allowed)
+*) 82: the row function of the streaming decoder returned nonzero to stop the decoding
+*) 83: the decompressed image data is smaller than the image (streaming decoder)
+*) 84: the IDAT chunks are not consecutive, the streaming decoder can't join them
+*) 85: the rowstride given to LodePNG_decodeInto is smaller than a row of the image
+*) 86: the write function of the streaming encoder wrote less than it was given
 *) 9900-9999: out of memory while allocating chunk of memory somewhere
 
 
@@ -1428,6 +1628,10 @@ std::vectors and std::strings in C++ can be incompatible resulting in bad things
 
 CHAR_BITS must be 8 or higher, because LodePNG uses unsigned chars for octets.
 
+With LODEPNG_COMPILE_SIMD defined, some inner loops (CRC32, Adler-32,
+unfiltering, color conversion) have SSE/AVX versions on x86 for gcc, clang and Visual Studio,
+which are used only if the CPU supports them. Comment out the define to compile plain ISO C90 code.
+
 *) gcc and g++
 
 LodePNG is developed in gcc so this compiler is natively supported. It gives no
@@ -1611,6 +1815,51 @@ yyyymmdd.
 Some changes aren't backwards compatible. Those are indicated with a (!)
 symbol.
 
+*) 31 mar 2023: Huffman codes are decoded with multi-level lookup tables instead
+    of walking the tree bit by bit. The setting huffmanTable of
+    LodeZlib_DecompressSettings selects the old tree walker.
+    Inflate reads the bits with a 64-bit buffer that is refilled 8 bytes at a time.
+    CRC32 uses slicing-by-8 tables and, on x86 CPUs with PCLMULQDQ, carry-less
+    multiplication (see LODEPNG_COMPILE_SIMD). Adler-32 sums 32 (SSSE3) or 64
+    (AVX2) bytes per step on x86. The filters Sub, Up, Average and Paeth of 24-bit
+    and 32-bit images are undone with SSE2, and LodePNG_unfilter is public.
+    The LZ77 encoder uses hash chains within a 32768 byte window, with the new
+    settings chainLength, niceMatch and lazyMatching, and compression levels
+    (LodeZlib_DeflateSettings_setLevel). The default window is now 32768.
+    The encoder scores the filter types with the sum of the absolute values of
+    all bytes (SSE2 on x86), or with their entropy (filterStrategy), and can
+    filter bands of scanlines on multiple threads (numThreads,
+    LODEPNG_COMPILE_THREADS). With numThreads, the zlib stream of the IDAT
+    chunks is also compressed on multiple threads, in segments that end with a
+    sync flush, and the Adler-32 checksums of the segments are combined.
+    The CRC32 tables and the CPU features are made once with pthread_once (or
+    InitOnceExecuteOnce), so decoders and encoders can run on several threads.
+    LodePNG_decodeStream decodes from a read function and gives the image row by
+    row to a row function, with bounded memory. The inflator reads its input in
+    pieces and can give its output to a sink while it inflates.
+    The decoder inflates the IDAT chunks where they are in the input, instead
+    of copying their data together first. LodePNG_decodeRows and
+    LodePNG_decodeInto give the rows of a PNG in memory to a row function or
+    write them with a row stride into a buffer of the caller.
+    LodePNG_convert unpacks palette indices of 1, 2 or 4 bits to one byte each,
+    and the color key of 16-bit greyscale is compared with the right bytes.
+    The decoder inflates into a buffer of the exact size of the scanlines, which
+    it knows from the header, and the inflator copies the bytes of a match 8 at
+    a time. The vectors reserve twice the size they grow to, not 8 times.
+    The internal buffers of the decoder and encoder can come from an allocator
+    of the settings, such as the arena of LodePNG_Arena, which is reset between
+    the images of a batch so that they reuse one block of memory.
+    LodePNG_decode and LodePNG_decodeInto unfilter and convert each scanline
+    into the output as soon as it's inflated, if the image isn't interlaced.
+    LodePNG_convert converts 8-bit greyscale, RGB and greyscale with alpha, and
+    the 16-bit color types without a color key, to RGBA 4 pixels at a time with
+    SSSE3 shuffles, and gathers the colors of 8 palette indices at once (AVX2).
+    Adam7 passes are unfiltered and scattered into the image one scanline at
+    a time, with whole pixels copied at once, and adam7Passes decodes only the
+    first passes of an interlaced image as a preview of lower resolution.
+    LodePNG_encodeStream filters and compresses groups of scanlines and writes
+    each as an IDAT chunk with a write function, so the memory it uses doesn't
+    grow with the image, and LodePNG_encodeFileStream writes a file with it.
 *) 02 sep 2008: fixed bug where it could create empty tree that linux apps could
     read by ignoring the problem but windows apps couldn't.
 *) 06 jun 2008: added more error checks for out of memory cases.
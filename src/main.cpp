@@ -19,14 +19,28 @@
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "glExtension.h"
 #include "Png.h"
 #include "Torus.h"
+#include "FrameProfiler.h"
+#include "Timer.h"
+#include "TextOverlay.h"
+#include "LightingShader.h"
+#include "PngBenchmark.h"
+#include "TextureLoader.h"
 
 
 // GLUT CALLBACK functions
 void displayCB();
 void reshapeCB(int w, int h);
 void timerCB(int millisec);
+void idleCB();
 void keyboardCB(unsigned char key, int x, int y);
 void mouseCB(int button, int stat, int x, int y);
 void mouseMotionCB(int x, int y);
@@ -39,9 +53,24 @@ void initLights();
 void setCamera(float posX, float posY, float posZ, float targetX, float targetY, float targetZ);
 void drawString(const char *str, int x, int y, float color[4], void *font);
 void drawString3D(const char *str, float pos[3], float color[4], void *font);
+void drawInfoString(const char *str, int x, int y, float color[4]);
 void toOrtho();
 void toPerspective();
+void showInfo();
+void drawFrameHistogram(int x, int y, int width, int height);
+void setRedrawMode(int mode);
+bool readFrame(std::vector<unsigned char>& flipped);
+void captureFrame(const char* fileName);
+void benchmarkFrame();
+void updateCameraMatrix();
+void drawScene(GLuint cameraList);
+void recordScene();
+void drawSceneShader();
+void drawGrid();
+void getGridPosition(int index, float pos[3]);
 GLuint loadTexture(const char* fileName, bool wrap=true);
+void loadTextures();
+void updateTextures();
 
 
 // constants
@@ -50,6 +79,18 @@ const int   SCREEN_HEIGHT   = 500;
 const float CAMERA_DISTANCE = 5.0f;
 const int   TEXT_WIDTH      = 8;
 const int   TEXT_HEIGHT     = 13;
+const int   HISTOGRAM_BINS  = 40;
+const int   CPU_SAMPLE_INTERVAL = 1000;     // millisec
+
+// redraw modes
+const int   REDRAW_ON_DEMAND = 0;           // redraw only if input or mesh is changed
+const int   REDRAW_VSYNC     = 1;           // redraw continuously, paced by vsync
+const int   REDRAW_UNCAPPED  = 2;           // redraw continuously as fast as possible
+const char* REDRAW_MODE_NAMES[] = {"on-demand", "vsync", "uncapped"};
+
+// texture files, the grid tori use them in turn
+const char* TEXTURE_FILES[] = {"grid512.png", "gl_torus05.png"};
+const int   TEXTURE_FILE_COUNT = 2;
 
 
 // global variables
@@ -68,6 +109,56 @@ GLuint texId;
 int imageWidth;
 int imageHeight;
 
+// frame profiler and the ids of displayCB phases
+FrameProfiler profiler;
+int phaseClear;
+int phaseScene;
+int phaseOverlay;
+int phaseSwap;
+std::string csvFileName;        // save frame times to CSV on exit if not empty
+
+// overlay text with glyph atlas, or glutBitmapCharacter() if false
+TextOverlay textOverlay;
+bool textAtlasUsed;
+int infoLineCount;              // # of lines drawn by showInfo()
+
+// recorded scene with display lists
+// sceneList calls cameraList, so only cameraList is re-recorded every frame
+bool sceneListUsed;
+GLuint sceneList;
+GLuint cameraList;
+float cameraMatrix[16];         // rotation of objects by camera angles
+unsigned int torus1Revision;    // revisions of the recorded geometry
+unsigned int torus2Revision;
+GLuint recordedTexId;
+int recordCount;
+
+// optional GLSL pipeline, and a grid of extra tori to stress per-object cost
+LightingShader lightingShader;
+bool shaderUsed;
+int gridSize;                   // # of extra tori = gridSize x gridSize
+
+// redraw scheduler
+int redrawMode;
+float cpuUsage;                 // CPU usage of this process in %
+double prevCpuTime;             // for CPU usage, in usec
+double prevWallTime;
+
+// the rendered frame is saved to PNG ('p' key), or encoded with all levels ('b' key)
+bool frameCaptureRequested;
+bool frameBenchRequested;
+
+// textures are decoded on worker threads and uploaded in displayCB, or loaded
+// one by one before the first frame if asyncLoadUsed is false
+TextureLoader textureLoader;
+bool asyncLoadUsed;
+int textureCount;               // # of textures to load, the first one is texId
+std::vector<int> textureHandles;
+std::vector<GLuint> texIds;
+double textureLoadTime;         // ms to load all textures
+Timer startTimer;               // from the start of main() to the first frame
+bool firstFrameDrawn;
+
 // torus: min sector = 3, min sides = 2
 Torus torus1(1.0f, 0.5f, 36, 18, false, 3); // R, r, sectors, sides, flat, Z-up
 Torus torus2(1.0f, 0.5f, 36, 18);           // R, r, sectors, sides, smooth(default), Z-up(default)
@@ -80,12 +171,73 @@ int main(int argc, char **argv)
     // init global vars
     initSharedMem();
 
+    // check command-line options
+    // "--csv frames.csv": save frame times on exit
+    // "--grid 32": draw extra 32x32 tori
+    // "--redraw uncapped": initial redraw mode (on-demand, vsync or uncapped)
+    // "--bench-png grid512.png": print decode/encode benchmark of the PNG file and exit
+    // "--textures 32": load 32 textures for the grid tori
+    // "--load serial": load textures before the first frame (serial or async)
+    std::string benchFileName;
+    for(int i = 1; i < argc - 1; ++i)
+    {
+        std::string option = argv[i];
+        if(option == "--csv")
+        {
+            csvFileName = argv[i + 1];
+            profiler.setLogEnabled(true);
+        }
+        else if(option == "--grid")
+        {
+            gridSize = atoi(argv[i + 1]);
+            if(gridSize < 0)
+                gridSize = 0;
+        }
+        else if(option == "--redraw")
+        {
+            std::string mode = argv[i + 1];
+            if(mode == "vsync")
+                redrawMode = REDRAW_VSYNC;
+            else if(mode == "uncapped")
+                redrawMode = REDRAW_UNCAPPED;
+            else
+                redrawMode = REDRAW_ON_DEMAND;
+        }
+        else if(option == "--bench-png")
+        {
+            benchFileName = argv[i + 1];
+        }
+        else if(option == "--textures")
+        {
+            textureCount = atoi(argv[i + 1]);
+            if(textureCount < 1)
+                textureCount = 1;
+        }
+        else if(option == "--load")
+        {
+            asyncLoadUsed = std::string(argv[i + 1]) != "serial";
+        }
+    }
+
+    // run PNG benchmark without creating window
+    if(!benchFileName.empty())
+    {
+        PngBenchmark bench;
+        if(!bench.load(benchFileName.c_str()))
+            return 1;
+        bench.run();
+        return 0;
+    }
+
     // init GLUT and GL
     initGLUT(argc, argv);
     initGL();
 
-    // load PNG image
-    texId = loadTexture("grid512.png", true);
+    // load PNG images, or queue them to the decode threads
+    loadTextures();
+
+    // register idle callback and set swap interval
+    setRedrawMode(redrawMode);
 
     // the last GLUT call (LOOP)
     // window will be shown and display callback is triggered by events
@@ -120,7 +272,7 @@ int initGLUT(int argc, char **argv)
 
     // register GLUT callback functions
     glutDisplayFunc(displayCB);
-    glutTimerFunc(33, timerCB, 33);             // redraw only every given millisec
+    glutTimerFunc(CPU_SAMPLE_INTERVAL, timerCB, CPU_SAMPLE_INTERVAL); // sample CPU usage
     glutReshapeFunc(reshapeCB);
     glutKeyboardFunc(keyboardCB);
     glutMouseFunc(mouseCB);
@@ -159,6 +311,24 @@ void initGL()
     glDepthFunc(GL_LEQUAL);
 
     initLights();
+
+    // GLSL pipeline is optional, use the same values as fixed-function lighting
+    if(lightingShader.init())
+    {
+        float lightPos[] = {0, 0, 1, 0};            // directional light in eye space
+        float lightKa[] = {.3f, .3f, .3f, 1.0f};
+        float lightKd[] = {.7f, .7f, .7f, 1.0f};
+        float lightKs[] = {1, 1, 1, 1};
+        float ambient[] = {0.5f, 0.5f, 0.5f, 1};
+        float specular[] = {1.0f, 1.0f, 1.0f, 1};
+        lightingShader.setLight(lightPos, lightKa, lightKd, lightKs);
+        lightingShader.setMaterial(ambient, specular, 128);
+    }
+
+    // GPU timer is optional, only CPU times are measured if not supported
+    glExtension::getInstance().printSelf();
+    if(!profiler.initGpuTimer())
+        std::cout << "[WARNING] GL_TIME_ELAPSED timer query is not supported." << std::endl;
 }
 
 
@@ -216,6 +386,22 @@ void drawString3D(const char *str, float pos[3], float color[4], void *font)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// draw a line of the info overlay
+// With the glyph atlas, it only updates the cached line, and all lines are
+// drawn at once at the end of showInfo().
+///////////////////////////////////////////////////////////////////////////////
+void drawInfoString(const char *str, int x, int y, float color[4])
+{
+    if(textAtlasUsed)
+        textOverlay.setLine(infoLineCount, str, x, y, color);
+    else
+        drawString(str, x, y, color, font);
+    ++infoLineCount;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // initialize global variables
 ///////////////////////////////////////////////////////////////////////////////
@@ -232,6 +418,38 @@ bool initSharedMem()
 
     drawMode = 0; // 0:fill, 1: wireframe, 2:points
 
+    textAtlasUsed = true;
+    infoLineCount = 0;
+
+    sceneListUsed = true;
+    sceneList = cameraList = 0;
+    torus1Revision = torus2Revision = 0;
+    recordedTexId = 0;
+    recordCount = 0;
+
+    shaderUsed = false;
+    gridSize = 0;
+
+    redrawMode = REDRAW_ON_DEMAND;
+    cpuUsage = 0;
+    prevCpuTime = Timer::getCpuTimeInMicroSec();
+    prevWallTime = Timer::getTimeInMicroSec();
+
+    frameCaptureRequested = false;
+    frameBenchRequested = false;
+
+    asyncLoadUsed = true;
+    textureCount = 1;
+    textureLoadTime = 0;
+    startTimer.start();
+    firstFrameDrawn = false;
+
+    // phases of displayCB to be profiled
+    phaseClear = profiler.addPhase("clear");
+    phaseScene = profiler.addPhase("scene");
+    phaseOverlay = profiler.addPhase("overlay");
+    phaseSwap = profiler.addPhase("swap");
+
     // change up axis to +Y
     //torus1.setUpAxis(2);
     //torus2.setUpAxis(2);
@@ -249,6 +467,20 @@ bool initSharedMem()
 ///////////////////////////////////////////////////////////////////////////////
 void clearSharedMem()
 {
+    profiler.printSelf();
+    if(!csvFileName.empty())
+        profiler.saveCsv(csvFileName.c_str());
+    profiler.releaseGpuTimer();
+    textOverlay.release();
+    if(asyncLoadUsed)
+        textureLoader.release();
+    else if(!texIds.empty())
+        glDeleteTextures((GLsizei)texIds.size(), &texIds[0]);
+    if(sceneList)
+        glDeleteLists(sceneList, 1);
+    if(cameraList)
+        glDeleteLists(cameraList, 1);
+    lightingShader.release();
 }
 
 
@@ -292,69 +524,58 @@ void setCamera(float posX, float posY, float posZ, float targetX, float targetY,
 ///////////////////////////////////////////////////////////////////////////////
 GLuint loadTexture(const char* fileName, bool wrap)
 {
-    Image::Png png;
-    if(!png.read(fileName))
-        return 0;     // exit if failed load image
-
-    // get bitmap info
-    int width = png.getWidth();
-    int height = png.getHeight();
-    const unsigned char* data = png.getData();
-    GLenum type = GL_UNSIGNED_BYTE;    // only allow BMP with 8-bit per channel
-
-    // We assume the image is 8-bit, 24-bit or 32-bit
-    GLenum format;
-    int bpp = png.getBitCount();
-    if(bpp == 8)
-        format = GL_LUMINANCE;
-    else if(bpp == 24)
-        format = GL_RGB;
-    else if(bpp == 32)
-        format = GL_RGBA;
-    else
-        return 0;               // NOT supported, exit
+    return TextureLoader::loadTexture(fileName, wrap);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load all textures of the scene
+// serial: decode and upload one by one on this thread before the first frame
+// async: queue them to the decode threads, displayCB uploads the decoded ones
+///////////////////////////////////////////////////////////////////////////////
+void loadTextures()
+{
+    texIds.assign(textureCount, 0);
+    if(asyncLoadUsed)
+    {
+        for(int i = 0; i < textureCount; ++i)
+            textureHandles.push_back(textureLoader.add(TEXTURE_FILES[i % TEXTURE_FILE_COUNT], true));
+        return;
+    }
 
-    // gen texture ID
-    GLuint texture;
-    glGenTextures(1, &texture);
+    Timer timer;
+    timer.start();
+    for(int i = 0; i < textureCount; ++i)
+        texIds[i] = loadTexture(TEXTURE_FILES[i % TEXTURE_FILE_COUNT], true);
+    texId = texIds[0];
+    textureLoadTime = timer.getElapsedTimeInMilliSec();
+    std::cout << "Loaded " << textureCount << " textures (serial): " << textureLoadTime << " ms" << std::endl;
+}
 
-    // set active texture and configure it
-    glBindTexture(GL_TEXTURE_2D, texture);
 
-    // select modulate to mix texture with color for shading
-    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    //glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+///////////////////////////////////////////////////////////////////////////////
+// upload the textures decoded since the last frame
+///////////////////////////////////////////////////////////////////////////////
+void updateTextures()
+{
+    if(!asyncLoadUsed || textureLoader.getPendingCount() == 0)
+        return;
 
-    // if wrap is true, the texture wraps over at the edges (repeat)
-    //       ... false, the texture ends at the edges (clamp)
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap ? GL_REPEAT : GL_CLAMP);
-    //glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    //glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if(textureLoader.update() == 0)
+        return;
 
-    // copy texture data
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, data);
-    //glGenerateMipmap(GL_TEXTURE_2D);
+    for(int i = 0; i < textureCount; ++i)
+        texIds[i] = textureLoader.getTexture(textureHandles[i]);
+    texId = texIds[0];
 
-    // build our texture mipmaps
-    switch(bpp)
+    if(textureLoader.getPendingCount() == 0)
     {
-    case 8:
-        gluBuild2DMipmaps(GL_TEXTURE_2D, 1, width, height, GL_LUMINANCE, type, data);
-        break;
-    case 24:
-        gluBuild2DMipmaps(GL_TEXTURE_2D, 3, width, height, GL_RGB, type, data);
-        break;
-    case 32:
-        gluBuild2DMipmaps(GL_TEXTURE_2D, 4, width, height, GL_RGBA, type, data);
-        break;
+        textureLoadTime = textureLoader.getLoadTime();
+        std::cout << "Loaded " << textureCount << " textures (async, " << textureLoader.getThreadCount()
+                  << " threads): " << textureLoadTime << " ms" << std::endl;
     }
-
-    png.printSelf();
-    return texture;
 }
 
 
@@ -376,34 +597,106 @@ void showInfo()
     glOrtho(0, screenWidth, 0, screenHeight, -1, 1); // set to orthogonal projection
 
     float color[4] = {1, 1, 1, 1};
+    infoLineCount = 0;
 
     std::stringstream ss;
     ss << std::fixed << std::setprecision(3);
 
     ss << "Major Radius: " << torus2.getMajorRadius() << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight-TEXT_HEIGHT, color, font);
+    drawInfoString(ss.str().c_str(), 1, screenHeight-TEXT_HEIGHT, color);
     ss.str("");
 
     ss << "Minor Radius: " << torus2.getMinorRadius() << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight-(2*TEXT_HEIGHT), color, font);
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(2*TEXT_HEIGHT), color);
     ss.str("");
 
     ss << "Sector Count: " << torus2.getSectorCount() << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight-(3*TEXT_HEIGHT), color, font);
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(3*TEXT_HEIGHT), color);
     ss.str("");
 
     ss << "Side Count: " << torus2.getSideCount() << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight-(4*TEXT_HEIGHT), color, font);
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(4*TEXT_HEIGHT), color);
     ss.str("");
 
     ss << "Vertex Count: " << torus2.getVertexCount() << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight-(5*TEXT_HEIGHT), color, font);
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(5*TEXT_HEIGHT), color);
     ss.str("");
 
     ss << "Index Count: " << torus2.getIndexCount() << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight-(6*TEXT_HEIGHT), color, font);
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(6*TEXT_HEIGHT), color);
+    ss.str("");
+
+    // frame stats from the previous frames
+    ss << "Redraw: " << REDRAW_MODE_NAMES[redrawMode] << " (press 'r'), CPU: "
+       << std::setprecision(1) << cpuUsage << "%" << std::setprecision(3) << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(7*TEXT_HEIGHT), color);
+    ss.str("");
+
+    ss << "Text: " << (textAtlasUsed ? "glyph atlas" : "glutBitmapCharacter") << " (press 't'), "
+       << textOverlay.getRebuildCount() << " line rebuilds" << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(8*TEXT_HEIGHT), color);
+    ss.str("");
+
+    ss << "Scene: " << (sceneListUsed ? "display list" : "immediate") << " (press 'l'), "
+       << recordCount << " records" << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(9*TEXT_HEIGHT), color);
+    ss.str("");
+
+    if(!lightingShader.isReady())
+        ss << "Shader: N/A" << std::ends;
+    else if(shaderUsed)
+        ss << "Shader: GLSL (press 's'), " << lightingShader.getUniformUploadCount() << " UBO uploads, "
+           << lightingShader.getMeshUploadCount() << " mesh uploads" << std::ends;
+    else
+        ss << "Shader: fixed-function (press 's')" << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(10*TEXT_HEIGHT), color);
+    ss.str("");
+
+    ss << "Textures: " << (asyncLoadUsed ? textureLoader.getLoadedCount() : textureCount) << "/" << textureCount;
+    if(asyncLoadUsed)
+        ss << " (async, " << textureLoader.getThreadCount() << " threads)";
+    else
+        ss << " (serial)";
+    if(!asyncLoadUsed || textureLoader.getPendingCount() == 0)
+        ss << ", " << textureLoadTime << " ms";
+    ss << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(11*TEXT_HEIGHT), color);
+    ss.str("");
+
+    ss << "FPS: " << profiler.getFps() << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(12*TEXT_HEIGHT), color);
+    ss.str("");
+
+    ss << "Frame (p50/p95/p99): " << profiler.getFrameTimePercentile(50) << " / "
+       << profiler.getFrameTimePercentile(95) << " / "
+       << profiler.getFrameTimePercentile(99) << " ms" << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-(13*TEXT_HEIGHT), color);
+    ss.str("");
+
+    for(int i = 0; i < profiler.getPhaseCount(); ++i)
+    {
+        ss << "CPU " << profiler.getPhaseName(i) << ": " << profiler.getAveragePhaseTime(i) << " ms" << std::ends;
+        drawInfoString(ss.str().c_str(), 1, screenHeight-((14+i)*TEXT_HEIGHT), color);
+        ss.str("");
+    }
+
+    if(profiler.isGpuTimerEnabled())
+        ss << "GPU: " << profiler.getGpuTime() << " ms" << std::ends;
+    else
+        ss << "GPU: N/A" << std::ends;
+    drawInfoString(ss.str().c_str(), 1, screenHeight-((14+profiler.getPhaseCount())*TEXT_HEIGHT), color);
     ss.str("");
 
+    // frame time histogram at the bottom-left corner
+    drawFrameHistogram(1, 1, HISTOGRAM_BINS * 4, 4 * TEXT_HEIGHT);
+
+    // draw all cached lines at once
+    if(textAtlasUsed)
+    {
+        textOverlay.setLineCount(infoLineCount);
+        textOverlay.draw();
+    }
+
     // unset floating format
     ss << std::resetiosflags(std::ios_base::fixed | std::ios_base::floatfield);
 
@@ -418,66 +711,181 @@ void showInfo()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// set projection matrix as orthogonal
+// draw the histogram of frame times in the history
+// The range is from 0 to 2x of p99, and the bars are scaled by the max count.
+// The projection matrix must be set to orthogonal before call this function.
 ///////////////////////////////////////////////////////////////////////////////
-void toOrtho()
+void drawFrameHistogram(int x, int y, int width, int height)
 {
-    // set viewport to be the entire window
-    glViewport(0, 0, (GLsizei)screenWidth, (GLsizei)screenHeight);
+    float maxTime = profiler.getFrameTimePercentile(99) * 2;
+    if(maxTime < 1.0f)
+        maxTime = 1.0f;
+
+    std::vector<int> counts(HISTOGRAM_BINS);
+    profiler.getHistogram(counts, maxTime);
+    int maxCount = 1;
+    for(int i = 0; i < HISTOGRAM_BINS; ++i)
+        maxCount = std::max(maxCount, counts[i]);
+
+    glPushAttrib(GL_LIGHTING_BIT | GL_CURRENT_BIT | GL_POLYGON_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    int barWidth = width / HISTOGRAM_BINS;
+    int y0 = y + TEXT_HEIGHT;       // leave space for the label
+    int barHeight = height - TEXT_HEIGHT;
+    glColor3f(0.3f, 0.8f, 0.3f);
+    glBegin(GL_QUADS);
+    for(int i = 0; i < HISTOGRAM_BINS; ++i)
+    {
+        int x0 = x + i * barWidth;
+        int y1 = y0 + barHeight * counts[i] / maxCount;
+        glVertex2i(x0, y0);
+        glVertex2i(x0 + barWidth - 1, y0);
+        glVertex2i(x0 + barWidth - 1, y1);
+        glVertex2i(x0, y1);
+    }
+    glEnd();
 
-    // set orthographic viewing frustum
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, screenWidth, 0, screenHeight, -1, 1);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_LIGHTING);
+    glPopAttrib();
 
-    // switch to modelview matrix in order to set scene
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    // range of the histogram
+    float color[4] = {1, 1, 1, 1};
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "0 ~ " << maxTime << " ms" << std::ends;
+    drawInfoString(ss.str().c_str(), x, y, color);
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// set the projection matrix as perspective
+// switch the redraw scheduler
+// on-demand: no idle callback, input callbacks post redisplay
+// vsync: idle callback posts redisplay, swap interval 1
+// uncapped: idle callback posts redisplay, swap interval 0
 ///////////////////////////////////////////////////////////////////////////////
-void toPerspective()
+void setRedrawMode(int mode)
 {
-    // set viewport to be the entire window
-    glViewport(0, 0, (GLsizei)screenWidth, (GLsizei)screenHeight);
+    redrawMode = mode;
 
-    // set perspective viewing frustum
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(40.0f, (float)(screenWidth)/screenHeight, 1.0f, 1000.0f); // FOV, AspectRatio, NearClip, FarClip
+    if(redrawMode == REDRAW_ON_DEMAND)
+        glutIdleFunc(0);
+    else
+        glutIdleFunc(idleCB);
 
-    // switch to modelview matrix in order to set scene
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if(!glExtension::getInstance().setSwapInterval(redrawMode == REDRAW_UNCAPPED ? 0 : 1))
+        std::cout << "[WARNING] Failed to change swap interval, the driver setting is used." << std::endl;
+
+    std::cout << "Redraw mode: " << REDRAW_MODE_NAMES[redrawMode] << std::endl;
+    glutPostRedisplay();
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// read the pixels of the back buffer as opaque RGBA, from the top row down
+///////////////////////////////////////////////////////////////////////////////
+bool readFrame(std::vector<unsigned char>& flipped)
+{
+    std::vector<unsigned char> pixels((size_t)screenWidth * screenHeight * 4);
+    flipped.resize(pixels.size());
+    if(pixels.empty())
+        return false;
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, screenWidth, screenHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    glPopClientAttrib();
+
+    // OpenGL starts from the bottom row, PNG from the top row
+    // The alpha of the cleared background is 0, so make all pixels opaque.
+    size_t rowSize = (size_t)screenWidth * 4;
+    for(int y = 0; y < screenHeight; ++y)
+        memcpy(&flipped[y * rowSize], &pixels[(screenHeight - 1 - y) * rowSize], rowSize);
+    for(size_t i = 3; i < flipped.size(); i += 4)
+        flipped[i] = 255;
+    return true;
+}
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// read the pixels of the back buffer and save them as PNG
+///////////////////////////////////////////////////////////////////////////////
+void captureFrame(const char* fileName)
+{
+    std::vector<unsigned char> flipped;
+    if(!readFrame(flipped))
+        return;
 
+    Image::Png png;
+    if(png.save(fileName, screenWidth, screenHeight, 4, &flipped[0]))
+        std::cout << "Saved the frame to " << fileName << std::endl;
+    else
+        std::cout << "[ERROR] " << png.getError() << std::endl;
+}
 
 
-//=============================================================================
-// CALLBACKS
-//=============================================================================
 
-void displayCB()
+///////////////////////////////////////////////////////////////////////////////
+// print the size, ratio and encode time of each compression level for the
+// back buffer, since a rendered frame compresses differently from a texture
+// image. It takes a few seconds, and the window doesn't respond meanwhile.
+///////////////////////////////////////////////////////////////////////////////
+void benchmarkFrame()
 {
-    // clear buffer
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    std::vector<unsigned char> flipped;
+    if(!readFrame(flipped))
+        return;
 
-    // save the initial ModelView matrix before modifying ModelView matrix
-    glPushMatrix();
+    PngBenchmark bench(5);
+    bench.runEncode(&flipped[0], screenWidth, screenHeight, "rendered frame");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compute the rotation matrix of objects from camera angles
+// same as glRotatef(cameraAngleX, 1,0,0) followed by glRotatef(cameraAngleY, 0,1,0)
+///////////////////////////////////////////////////////////////////////////////
+void updateCameraMatrix()
+{
+    const float DEG2RAD = 3.141593f / 180;
+    float sx = sinf(cameraAngleX * DEG2RAD);
+    float cx = cosf(cameraAngleX * DEG2RAD);
+    float sy = sinf(cameraAngleY * DEG2RAD);
+    float cy = cosf(cameraAngleY * DEG2RAD);
+
+    // Rx * Ry in column-major order
+    float* m = cameraMatrix;
+    m[0] = cy;      m[4] = 0;   m[8]  = sy;       m[12] = 0;
+    m[1] = sx*sy;   m[5] = cx;  m[9]  = -sx*cy;   m[13] = 0;
+    m[2] = -cx*sy;  m[6] = sx;  m[10] = cx*cy;    m[14] = 0;
+    m[3] = 0;       m[7] = 0;   m[11] = 0;        m[15] = 1;
+
+    // the scene list refers to this list, so the scene is not re-recorded
+    if(cameraList)
+    {
+        glNewList(cameraList, GL_COMPILE);
+        glMultMatrixf(cameraMatrix);
+        glEndList();
+    }
+}
 
-    // tramsform modelview matrix
-    glTranslatef(0, 0, -cameraDistance);
 
+
+///////////////////////////////////////////////////////////////////////////////
+// draw the static part of scene: materials and 3 tori
+// The camera rotation is applied by calling cameraList if it is not 0, or by
+// multiplying cameraMatrix directly.
+///////////////////////////////////////////////////////////////////////////////
+void drawScene(GLuint cameraList)
+{
     // set material
     float ambient[]  = {0.5f, 0.5f, 0.5f, 1};
     float diffuse[]  = {0.7f, 0.7f, 0.7f, 1};
@@ -494,8 +902,10 @@ void displayCB()
     // draw left flat torus with lines
     glPushMatrix();
     glTranslatef(-3.5f, 0, 0);
-    glRotatef(cameraAngleX, 1, 0, 0);   // pitch
-    glRotatef(cameraAngleY, 0, 1, 0);   // heading
+    if(cameraList)
+        glCallList(cameraList);
+    else
+        glMultMatrixf(cameraMatrix);
     glBindTexture(GL_TEXTURE_2D, 0);
     torus1.drawWithLines(lineColor);
     //torus1.drawLines(lineColor);
@@ -504,8 +914,10 @@ void displayCB()
     // draw centre smooth sphere with line
     glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse); // reset diffuse
     glPushMatrix();
-    glRotatef(cameraAngleX, 1, 0, 0);
-    glRotatef(cameraAngleY, 0, 1, 0);
+    if(cameraList)
+        glCallList(cameraList);
+    else
+        glMultMatrixf(cameraMatrix);
     glBindTexture(GL_TEXTURE_2D, 0);
     torus2.drawWithLines(lineColor);
     glPopMatrix();
@@ -514,19 +926,276 @@ void displayCB()
     glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse); // reset diffuse
     glPushMatrix();
     glTranslatef(3.5f, 0, 0);
-    glRotatef(cameraAngleX, 1, 0, 0);
-    glRotatef(cameraAngleY, 0, 1, 0);
+    if(cameraList)
+        glCallList(cameraList);
+    else
+        glMultMatrixf(cameraMatrix);
     glBindTexture(GL_TEXTURE_2D, texId);
     torus2.draw();
     glPopMatrix();
 
     glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// record the scene into a display list if it is not recorded yet, or any of
+// the tori or the texture is changed since the last recording
+///////////////////////////////////////////////////////////////////////////////
+void recordScene()
+{
+    if(sceneList && torus1.getRevision() == torus1Revision &&
+       torus2.getRevision() == torus2Revision && texId == recordedTexId)
+        return;     // up to date
+
+    if(!sceneList)
+    {
+        sceneList = glGenLists(1);
+        cameraList = glGenLists(1);
+        updateCameraMatrix();
+    }
+
+    // the vertex arrays are copied into the list at compile time
+    glNewList(sceneList, GL_COMPILE);
+    drawScene(cameraList);
+    glEndList();
+
+    torus1Revision = torus1.getRevision();
+    torus2Revision = torus2.getRevision();
+    recordedTexId = texId;
+    ++recordCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// draw the scene with GLSL pipeline
+// The objects sharing the same mesh and texture are drawn with an instanced
+// draw call, and the lines are drawn with fixed-function pipeline on top.
+///////////////////////////////////////////////////////////////////////////////
+void drawSceneShader()
+{
+    float diffuse[]  = {0.7f, 0.7f, 0.7f, 1};
+    float lineColor[] = {0.2f, 0.2f, 0.2f, 1};
+    float matrix[16];
+    memcpy(matrix, cameraMatrix, sizeof(matrix));
+
+    // move polygon backward for lines
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0, 1.0f);
+
+    // left flat torus
+    matrix[12] = -3.5f;
+    lightingShader.addObject(matrix, diffuse, 0);
+    lightingShader.draw(torus1, 0);
+
+    // centre and right torus share the mesh, only right one is textured
+    matrix[12] = 0;
+    lightingShader.addObject(matrix, diffuse, 0);
+    matrix[12] = 3.5f;
+    lightingShader.addObject(matrix, diffuse, 1);
+
+    // grid tori with texture
+    float pos[3];
+    for(int i = 0; i < gridSize * gridSize; ++i)
+    {
+        getGridPosition(i, pos);
+        matrix[12] = pos[0];
+        matrix[13] = pos[1];
+        matrix[14] = pos[2];
+        lightingShader.addObject(matrix, diffuse, 1);
+    }
+    lightingShader.draw(torus2, texId);
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+
+    // lines
+    glPushMatrix();
+    glTranslatef(-3.5f, 0, 0);
+    glMultMatrixf(cameraMatrix);
+    torus1.drawLines(lineColor);
+    glPopMatrix();
+
+    glPushMatrix();
+    glMultMatrixf(cameraMatrix);
+    torus2.drawLines(lineColor);
+    glPopMatrix();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// draw the grid of extra tori with fixed-function pipeline, one by one
+///////////////////////////////////////////////////////////////////////////////
+void drawGrid()
+{
+    if(gridSize <= 0)
+        return;
+
+    float diffuse[]  = {0.7f, 0.7f, 0.7f, 1};
+    glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
 
+    // each torus uses the next texture in turn
+    float pos[3];
+    for(int i = 0; i < gridSize * gridSize; ++i)
+    {
+        getGridPosition(i, pos);
+        glBindTexture(GL_TEXTURE_2D, texIds.empty() ? texId : texIds[i % texIds.size()]);
+        glPushMatrix();
+        glTranslatef(pos[0], pos[1], pos[2]);
+        glMultMatrixf(cameraMatrix);
+        torus2.draw();
+        glPopMatrix();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// position of a torus in the grid, on the plane below the main tori
+///////////////////////////////////////////////////////////////////////////////
+void getGridPosition(int index, float pos[3])
+{
+    const float SPACING = 3.0f;
+    int row = index / gridSize;
+    int col = index % gridSize;
+    pos[0] = (col - (gridSize - 1) * 0.5f) * SPACING;
+    pos[1] = -3.0f;
+    pos[2] = -SPACING * (row + 1);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// set projection matrix as orthogonal
+///////////////////////////////////////////////////////////////////////////////
+void toOrtho()
+{
+    // set viewport to be the entire window
+    glViewport(0, 0, (GLsizei)screenWidth, (GLsizei)screenHeight);
+
+    // set orthographic viewing frustum
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, screenWidth, 0, screenHeight, -1, 1);
+
+    // switch to modelview matrix in order to set scene
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// set the projection matrix as perspective
+///////////////////////////////////////////////////////////////////////////////
+void toPerspective()
+{
+    // set viewport to be the entire window
+    glViewport(0, 0, (GLsizei)screenWidth, (GLsizei)screenHeight);
+
+    // set perspective viewing frustum
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(40.0f, (float)(screenWidth)/screenHeight, 1.0f, 1000.0f); // FOV, AspectRatio, NearClip, FarClip
+
+    // switch to modelview matrix in order to set scene
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+
+
+
+
+
+
+
+
+//=============================================================================
+// CALLBACKS
+//=============================================================================
+
+void displayCB()
+{
+    profiler.beginFrame();
+
+    // rasterize glyph atlas once, it needs the window to be shown
+    if(textAtlasUsed && !textOverlay.isReady())
+        textAtlasUsed = textOverlay.init(font, TEXT_HEIGHT);
+
+    // upload decoded textures, and keep redrawing until all are loaded
+    updateTextures();
+    if(asyncLoadUsed && textureLoader.getPendingCount() > 0)
+        glutPostRedisplay();
+
+    // clear buffer
+    profiler.beginPhase(phaseClear);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    profiler.endPhase(phaseClear);
+
+    profiler.beginPhase(phaseScene);
+
+    // save the initial ModelView matrix before modifying ModelView matrix
+    glPushMatrix();
+
+    // tramsform modelview matrix
+    glTranslatef(0, 0, -cameraDistance);
+
+    // only the camera rotation is updated per frame
+    updateCameraMatrix();
+    if(shaderUsed && lightingShader.isReady())
+    {
+        drawSceneShader();
+    }
+    else
+    {
+        if(sceneListUsed)
+        {
+            recordScene();
+            glCallList(sceneList);
+        }
+        else
+        {
+            drawScene(0);
+        }
+        drawGrid();
+    }
+    profiler.endPhase(phaseScene);
+
+    profiler.beginPhase(phaseOverlay);
     showInfo();     // print max range of glDrawRangeElements
+    profiler.endPhase(phaseOverlay);
 
     glPopMatrix();
 
+    // read back the frame before swap, the back buffer is undefined after it
+    if(frameCaptureRequested)
+    {
+        captureFrame("frame.png");
+        frameCaptureRequested = false;
+    }
+    if(frameBenchRequested)
+    {
+        benchmarkFrame();
+        frameBenchRequested = false;
+    }
+
+    profiler.beginPhase(phaseSwap);
     glutSwapBuffers();
+    profiler.endPhase(phaseSwap);
+
+    profiler.endFrame();
+
+    if(!firstFrameDrawn)
+    {
+        firstFrameDrawn = true;
+        std::cout << "Time to first frame: " << startTimer.getElapsedTimeInMilliSec() << " ms ("
+                  << (asyncLoadUsed ? "async" : "serial") << " texture load)" << std::endl;
+    }
 }
 
 
@@ -553,6 +1222,20 @@ void reshapeCB(int w, int h)
 void timerCB(int millisec)
 {
     glutTimerFunc(millisec, timerCB, millisec);
+
+    // CPU usage of this process since the previous sample
+    double cpuTime = Timer::getCpuTimeInMicroSec();
+    double wallTime = Timer::getTimeInMicroSec();
+    if(wallTime > prevWallTime)
+        cpuUsage = (float)((cpuTime - prevCpuTime) / (wallTime - prevWallTime) * 100);
+    prevCpuTime = cpuTime;
+    prevWallTime = wallTime;
+    // not redrawn here; in on-demand mode, the overlay shows it on the next redraw
+}
+
+
+void idleCB()
+{
     glutPostRedisplay();
 }
 
@@ -595,9 +1278,42 @@ void keyboardCB(unsigned char key, int x, int y)
         torus2.reverseNormals();
         break;
 
+    case 's': // switch between GLSL and fixed-function pipeline
+    case 'S':
+        shaderUsed = !shaderUsed;
+        break;
+
+    case 'l': // switch scene between display list and immediate submission
+    case 'L':
+        sceneListUsed = !sceneListUsed;
+        break;
+
+    case 't': // switch overlay text between glyph atlas and glutBitmapCharacter
+    case 'T':
+        textAtlasUsed = !textAtlasUsed;
+        break;
+
+    case 'r': // switch redraw modes (on-demand -> vsync -> uncapped)
+    case 'R':
+        setRedrawMode((redrawMode + 1) % 3);
+        break;
+
+    case 'p': // save the next frame to PNG
+    case 'P':
+        frameCaptureRequested = true;
+        break;
+
+    case 'b': // print encode table of all levels for the next frame
+    case 'B':
+        frameBenchRequested = true;
+        break;
+
     default:
         ;
     }
+
+    // mesh or states may be changed
+    glutPostRedisplay();
 }
 
 
@@ -652,4 +1368,7 @@ void mouseMotionCB(int x, int y)
         cameraDistance -= (y - mouseY) * 0.2f;
         mouseY = y;
     }
+
+    if(mouseLeftDown || mouseRightDown)
+        glutPostRedisplay();
 }